@@ -34,6 +34,7 @@
 #define _ApiIF_hpp_
 
 #include <string>
+#include <curl/curl.h>
 
 #include <common.h>
 #include <Channel.hpp>
@@ -46,12 +47,43 @@ namespace vz {
 		ApiIF(Channel::Ptr ch) : _ch(ch){}
 		virtual ~ApiIF(){};
 
+/**
+ * @brief create the api configured for the channel
+ * volkszaehler is used if no or an unknown api is given.
+ **/
+		static Ptr create(Channel::Ptr ch);
+
 /** 
  * @brief send measurement values to middleware
  * to be implemented specific API.
+ * @return true if the middleware answered, false if no request was made
  **/
-		virtual void send() = 0;
+		virtual bool send() = 0;
 		virtual	void register_device()  = 0;
+
+/**
+ * @brief url of the middleware, channels of the same host share its health
+ * send() throws a vz::ConnectionException if the host did not answer.
+ **/
+		virtual const std::string middleware() const { return ""; }
+
+/**
+ * @brief send() split in two, for many requests in flight in one thread
+ * APIs which return true here implement prepare() and complete().
+ **/
+		virtual bool asynchronous() const { return false; }
+
+/**
+ * @brief build the request for the pending readings
+ * @return handle to perform, NULL if there is nothing to send
+ **/
+		virtual CURL *prepare() { return NULL; }
+
+/**
+ * @brief evaluate the answer, acknowledge the sent readings
+ * Throws like send() if the host did not answer.
+ **/
+		virtual void complete(CURLcode code) {}
 		
 	protected:
 		Channel::Ptr channel() { return _ch; }
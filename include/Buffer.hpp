@@ -1,8 +1,16 @@
 /**
- * Circular buffer (double linked, threadsafe)
+ * Circular buffer (bounded, contiguous, threadsafe)
  *
  * Used to store recent readings and buffer in case of net inconnectivity
  *
+ * Readings are kept in a ring of preallocated slots which grows on demand
+ * up to a hard capacity. Once the ring is full the overflow policy decides
+ * whether the oldest or the newest reading is discarded.
+ *
+ * If an aggregation mode is set, readings are folded into running
+ * accumulators as they are pushed and only the aggregate of each window
+ * is stored.
+ *
  * @author Steffen Vogel <info@steffenvogel.de>
  * @copyright Copyright (c) 2011, The volkszaehler.org project
  * @package vzlogger
@@ -30,32 +38,107 @@
 
 #include <pthread.h>
 #include <sys/time.h>
-#include <list>
+#include <vector>
+#include <iterator>
+#include <cstddef>
 
 #include <Reading.hpp>
 
+#define BUFFER_DEFAULT_CAPACITY 8192	/* hard limit of readings per channel */
+#define BUFFER_INITIAL_SLOTS 32			/* slots allocated up front */
+
 class Buffer {
 
 	public:
 	typedef vz::shared_ptr<Buffer> Ptr;
-	typedef std::list<Reading>::iterator iterator;
-	typedef std::list<Reading>::const_iterator const_iterator;
 
-	enum aggmode { NONE, MAX, AVG, SUM };
-
-	Buffer();
+	/**
+	 * Iterates the ring from the oldest to the newest reading
+	 */
+	class iterator {
+		public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef Reading value_type;
+		typedef ptrdiff_t difference_type;
+		typedef Reading *pointer;
+		typedef Reading &reference;
+
+		iterator() : _buf(NULL), _pos(0) {}
+		iterator(Buffer *buf, size_t pos) : _buf(buf), _pos(pos) {}
+
+		Reading &operator*() const  { return _buf->at(_pos); }
+		Reading *operator->() const { return &_buf->at(_pos); }
+
+		iterator &operator++()   { _pos++; return *this; }
+		iterator operator++(int) { iterator tmp(*this); _pos++; return tmp; }
+
+		bool operator==(const iterator &rhs) const { return _pos == rhs._pos && _buf == rhs._buf; }
+		bool operator!=(const iterator &rhs) const { return !(*this == rhs); }
+
+		private:
+		Buffer *_buf;
+		size_t _pos;	/**< logical position, 0 is the oldest reading */
+	};
+	typedef iterator const_iterator;
+
+	/**
+	 * TWAVG:    time-weighted average (trapezoidal), for irregularly sampled power
+	 * DELTA:    difference of a counter to the end of the previous window
+	 * INTEGRAL: trapezoidal integral over time in value*h (e.g. W -> Wh)
+	 */
+	enum aggmode { NONE, MAX, AVG, SUM, MIN, LAST, TWAVG, DELTA, INTEGRAL };
+	/**
+	 * DOWNSAMPLE: merge pairs of the older half of readings instead of
+	 *             dropping, older readings get coarser with each overflow
+	 */
+	enum overflow { DROP_OLDEST, DROP_NEWEST, DOWNSAMPLE };
+
+	Buffer(size_t capacity = BUFFER_DEFAULT_CAPACITY);
 	virtual ~Buffer();
 
 	void aggregate(int aggtime, bool aggFixedInterval);
 	void push(const Reading &rd);
-	void clean();
-	void undelete();
-	void shrink(/*size_t keep = 0*/);
+	void acknowledge(size_t n);
+	void shrink();
 	char *dump(char *dump, size_t len);
 
-	inline iterator begin() { return _sent.begin(); }
-	inline iterator end()   { return _sent.end(); }
-	inline size_t size() { return _sent.size(); }
+	inline iterator begin() { return iterator(this, 0); }
+	inline iterator end()   { return iterator(this, _size); }
+	inline size_t size() const { return _size; }
+
+	inline size_t capacity() const { return _capacity; }
+	void capacity(const size_t capacity);
+
+	inline Buffer::overflow overflow_policy() const { return _overflow; }
+	inline void overflow_policy(Buffer::overflow p) { _overflow = p; }
+
+	/**
+	 * Number of readings discarded due to overflow so far
+	 */
+	inline unsigned long dropped() const { return _dropped; }
+
+	/**
+	 * Number of readings merged into others due to overflow so far
+	 */
+	inline unsigned long downsampled() const { return _downsampled; }
+
+	/**
+	 * Global limit in bytes for the readings held by all buffers and
+	 * logging queues, 0 means unlimited. Buffers which would exceed it
+	 * stop growing and apply their overflow policy.
+	 */
+	static void budget(size_t bytes) { _budget = bytes; }
+	static size_t budget() { return _budget; }
+	static size_t reserved() { return _reserved; }
+
+	/**
+	 * Account memory against the global budget
+	 *
+	 * @param force reserve even if the budget is exceeded
+	 * @return false if the budget would be exceeded
+	 */
+	static bool reserve(size_t bytes, bool force = false);
+	static void release(size_t bytes);
 
 	inline bool newValues() const { return _newValues; }
 	inline void clear_newValues() { _newValues = false; }
@@ -72,11 +155,43 @@ class Buffer {
 	inline void set_aggmode(Buffer::aggmode m) {_aggmode=m;}
 
 	private:
-	std::list<Reading> _sent;
+	inline Reading &at(size_t pos) { return _ring[(_head + pos) % _ring.size()]; }
+	void append(const Reading &rd);
+	void accumulate(const Reading &rd);
+	int64_t fixed_interval(const Reading &rd, int aggtime) const;
+	bool relocate(size_t slots);
+	void drop_front(size_t n);
+	void downsample();
+	Reading merge(const Reading &older, const Reading &newer) const;
+
+	std::vector<Reading> _ring;	/**< slot storage, grows up to _capacity */
+	size_t _head;				/**< slot of the oldest reading */
+	size_t _size;				/**< number of readings in the ring */
+	size_t _capacity;			/**< hard limit for _size */
+
+	Buffer::overflow _overflow;
+	unsigned long _dropped;
+	unsigned long _downsampled;
+
+	static size_t _budget;
+	static volatile size_t _reserved;
+
 	bool _newValues;
 
 	Buffer::aggmode _aggmode;
 
+	/* accumulators of the current aggregation window */
+	size_t _agg_count;
+	double _agg_sum;
+	double _agg_max;
+	double _agg_min;
+	double _agg_area;		/**< integral of value over time in value*microseconds */
+	int64_t _agg_span;		/**< microseconds covered by _agg_area */
+	double _agg_ref;		/**< counter value at start of window (DELTA) */
+	Reading _agg_latest;	/**< reading with the latest timestamp */
+	Reading _agg_prev;		/**< latest reading so far, kept across windows */
+	bool _agg_have_prev;
+
 	size_t _keep;	/**< number of readings to cache for local interface */
 
 	pthread_mutex_t _mutex;
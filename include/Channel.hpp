@@ -31,46 +31,75 @@
 
 #include "Reading.hpp"
 #include "Buffer.hpp"
-#include <threads.h>
+#include "SpscQueue.hpp"
+#include "Spool.hpp"
+#include "Filter.hpp"
+#include "EventNotifier.hpp"
 #include <Options.hpp>
 #include <VZException.hpp>
 
+#define CHANNEL_MIN_QUEUE 16	/* min. slots of the logging queue */
+
+class Uploader;
+
 class Channel {
 
 	public:
 	typedef vz::shared_ptr<Channel> Ptr;
+	typedef SpscQueue<Reading> Queue;
 
 	Channel(const std::list<Option> &pOptions, const std::string api, const std::string pUuid, ReadingIdentifier::Ptr pIdentifier);
 	virtual ~Channel();
 
-	void start() {
-		pthread_create(&_thread, NULL, &logging_thread, (void *) this);
-		_thread_running = true;
-	}
-
-	void join() {
-		pthread_join(_thread, NULL);
-		_thread_running = false;
-	}
-
-	void cancel() { if (running()) pthread_cancel(_thread); }
-
-	bool running() const { return _thread_running; }
-
 	const char* name()                  { return _name.c_str(); }
 	std::list<Option> &options()        { return _options; }
 
 	ReadingIdentifier::Ptr identifier() {
 		if (_identifier.use_count() < 1) throw vz::VZException("Not identifier defined.") ; return _identifier; }
-	double tvtod() const          { return _last == NULL ? 0 : _last->tvtod(); }
+	/* interned when the routes are built */
+	reading_id_t identifier_id() const  { return IdentifierTable::intern(_identifier); }
+	double tvtod() const          { return _last / 1e6; }
+	int64_t time_us() const       { return _last; }
 
 	const char* uuid()                  { return _uuid.c_str(); }
 	const std::string apiProtocol()     { return _apiProtocol; }
 
-	void last(Reading *rd)              { _last = rd;}
-	void push(const Reading &rd)        { _buffer->push(rd); }
+	void last(const Reading &rd)        { _last = rd.time_us(); }
+	void push(const Reading &rd);
 	char *dump(char *dump, size_t len)  { return _buffer->dump(dump, len); }
 	Buffer::Ptr buffer()                { return _buffer; }
+	Queue &queue()                      { return *_queue; }
+
+	/* readings are sent by this uploader once they are published */
+	void attach(Uploader *uploader, size_t job) { _uploader = uploader; _job = job; }
+	Uploader *uploader() const          { return _uploader; }
+	size_t job() const                  { return _job; }
+
+	/* configuration the channel was created from, compared on reload */
+	void config(const std::string &config)  { _config = config; }
+	const std::string &config() const       { return _config; }
+
+	size_t publish();
+	void open_spool();
+	void persist();
+
+	/* consumer side of the uploader, reads from the spool if there is one */
+	Reading *peek(size_t offset)        { return _spool ? _spool->peek(offset) : _queue->peek(offset); }
+	void acknowledge(size_t n);
+	size_t pending() const;
+
+	/* held while peeking: the sender of a batch reads other channels, which persist() meanwhile */
+	void lock_consumer()                { pthread_mutex_lock(&_consumer); }
+	void unlock_consumer()              { pthread_mutex_unlock(&_consumer); }
+
+	/* seconds the reading thread may stall while the logging queue is full */
+	int backpressure() const            { return _backpressure; }
+	/* used by reading thread, returns as soon as the uploader made room */
+	bool wait_drained(int timeout)      { return _drained.wait(timeout); }
+
+	unsigned long dropped() const       { return _buffer->dropped(); }
+	unsigned long downsampled() const   { return _buffer->downsampled(); }
+	unsigned long suppressed() const    { return _filter.suppressed(); }
 
 	size_t size() const { return _buffer->size(); }
 	size_t keep() const { return _buffer->keep(); }
@@ -80,6 +109,7 @@ class Channel {
 		pthread_cond_broadcast(&condition);
 		_buffer->unlock();
 	}
+	/* used by local webserver (comet) */
 	inline void wait() {
 		_buffer->lock();
 		while(!_buffer->newValues() ) {
@@ -91,19 +121,27 @@ class Channel {
 
 	private:
 	static int instances;
-	bool _thread_running;   	// flag if thread is started
 
 	int id;		 				// only for internal usage & debugging
 	std::string _name;    		// name of the channel
 	std::list<Option> _options;
+	std::string _config;		// serialized json of the channel
 
+	Filter _filter;				// dead-band filter in front of the buffer
 	Buffer::Ptr _buffer;		// circular queue to buffer readings
+	vz::shared_ptr<Queue> _queue;	// lock-free hand-over to the uploader
+	Uploader *_uploader;		// sends published readings, NULL if not logging
+	size_t _job;				// our job in the uploader's run queue
+	EventNotifier _drained;		// wakes up reading thread under backpressure
+	int _backpressure;			// max. seconds to hold the reading thread
+	std::string _spool_dir;		// directory of the spool, empty if none
+	Spool::Ptr _spool;			// optional on-disk backlog, owned by the uploader
+	mutable pthread_mutex_t _consumer;	// serializes the consumer side
 
 	ReadingIdentifier::Ptr _identifier;	// channel identifier (OBIS, string)
-	Reading *_last;			 	// most recent reading
+	int64_t _last;			 	// time of the most recent reading in us, 0 if none
 
-	pthread_cond_t condition;	// pthread syncronization to notify logging thread and local webserver
-	pthread_t _thread;			// pthread for asynchronus logging
+	pthread_cond_t condition;	// pthread syncronization to notify local webserver
 
 	std::string _uuid;			// unique identifier for middleware
 	std::string _apiProtocol;	// protocol of api to use for logging
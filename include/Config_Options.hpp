@@ -67,6 +67,11 @@ public:
 	const int &comet_timeout() const { return _comet_timeout; }
 	const int &buffer_length() const { return _buffer_length; }
 	int retry_pause() const { return _retry_pause; }
+	int retry_max() const { return _retry_max; }
+	int uploaders() const { return _uploaders; }
+	int parallel() const { return _parallel; }
+	int reactor() const { return _reactor; }
+	int memory() const { return _memory; }
 
 	bool channel_index() const { return _channel_index; }
 	bool daemon()    const { return _daemon; }
@@ -97,7 +102,12 @@ private:
 	int _verbosity;			// verbosity level
 	int _comet_timeout;		// in seconds; 
 	int _buffer_length;		// in seconds; how long to buffer readings for local interfalce
-	int _retry_pause;		// in seconds; how long to pause after an unsuccessful HTTP request
+	int _retry_pause;		// in seconds; backoff after an unsuccessful HTTP request, doubled for each failed retry
+	int _retry_max;			// in seconds; upper limit of the backoff
+	int _uploaders;			// number of threads sending to the middleware
+	int _parallel;			// max. requests in flight of one curl_multi thread, 0 = use the uploader threads
+	int _reactor;			// number of threads reading meters via epoll, 0 = one thread per meter
+	int _memory;			// in bytes; budget for buffered readings of all channels, 0 = unlimited
 
 	// boolean bitfields, padding at the end of struct
 	int _channel_index:1;	// give a index of all available channels via local interface
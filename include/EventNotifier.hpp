@@ -0,0 +1,96 @@
+/**
+ * Wake-up primitive based on eventfd
+ *
+ * The producer signals, the consumer blocks until at least one signal
+ * has arrived. Signals are coalesced, so the consumer has to drain its
+ * queue completely after waking up.
+ *
+ * @package vzlogger
+ * @license http://opensource.org/licenses/gpl-license.php GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _EVENT_NOTIFIER_H_
+#define _EVENT_NOTIFIER_H_
+
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+
+#include <VZException.hpp>
+
+class EventNotifier {
+
+	public:
+	EventNotifier() {
+		_fd = eventfd(0, 0);
+		if (_fd < 0) {
+			throw vz::VZException("Cannot create eventfd.");
+		}
+	}
+
+	~EventNotifier() { close(_fd); }
+
+	/**
+	 * Wake up the waiting thread (never blocks)
+	 */
+	void notify() {
+		uint64_t one = 1;
+		ssize_t ret;
+		do {
+			ret = write(_fd, &one, sizeof(one));
+		} while (ret < 0 && errno == EINTR);
+	}
+
+	/**
+	 * Block until notified
+	 *
+	 * @param timeout in milliseconds, -1 waits forever
+	 * @return false on timeout
+	 */
+	bool wait(int timeout = -1) {
+		struct pollfd pfd;
+		pfd.fd = _fd;
+		pfd.events = POLLIN;
+
+		int ret;
+		do {
+			ret = poll(&pfd, 1, timeout);
+		} while (ret < 0 && errno == EINTR);
+
+		if (ret <= 0) return false;
+
+		uint64_t count;
+		if (read(_fd, &count, sizeof(count)) != sizeof(count)) {
+			return false;
+		}
+		return true;
+	}
+
+	int fd() const { return _fd; }
+
+	private:
+	EventNotifier(const EventNotifier &);
+	EventNotifier &operator=(const EventNotifier &);
+
+	int _fd;
+};
+
+#endif /* _EVENT_NOTIFIER_H_ */
@@ -0,0 +1,97 @@
+/**
+ * Dead-band filter and swinging door compression for readings of a channel
+ *
+ * Forwards a reading only if it differs enough from the last forwarded
+ * one, or if it is needed to reconstruct the curve within a given error,
+ * or if nothing has been forwarded for a while (heartbeat).
+ *
+ * @package vzlogger
+ * @license http://opensource.org/licenses/gpl-license.php GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FILTER_H_
+#define _FILTER_H_
+
+#include <Reading.hpp>
+
+/**
+ * A reading passes if it is the first one, if it differs from the last
+ * forwarded value by more than max(absolute, relative * |last|), or if
+ * the last forwarded reading is at least heartbeat seconds old.
+ * With both bands 0 every change passes (change-only forwarding).
+ * The heartbeat only limits a dead-band or compression: on its own the
+ * filter stays disabled and every reading passes.
+ *
+ * When a change passes after readings have been suppressed, the last
+ * suppressed reading is forwarded first, so the step is not drawn as a ramp.
+ * The filter runs before aggregation, so it does not suit additive
+ * aggregation modes (sum, integral) of the channel.
+ *
+ * With compression enabled the dead-band is replaced by swinging door
+ * trending: a reading is dropped if the straight line between the last
+ * forwarded reading and a later one stays within the deviation of it.
+ * Each reading is held back until the next one shows whether it ends a
+ * segment, so forwarding lags one reading behind.
+ */
+class Filter {
+
+	public:
+	Filter();
+
+	void deadband(double absolute, double relative);
+	void heartbeat(int seconds);
+	void compression(double deviation);
+
+	bool enabled() const { return _enabled; }
+
+	/**
+	 * @param rd incoming reading
+	 * @param out readings to forward, oldest first
+	 * @return number of readings in out (0, 1 or 2)
+	 */
+	size_t apply(const Reading &rd, Reading out[2]);
+
+	/**
+	 * Number of readings held back so far
+	 */
+	unsigned long suppressed() const { return _suppressed; }
+
+	private:
+	size_t apply_deadband(const Reading &rd, Reading out[2]);
+	size_t apply_swinging_door(const Reading &rd, Reading out[2]);
+
+	bool _enabled;
+	double _absolute;
+	double _relative;
+	int64_t _heartbeat;		/**< microseconds, 0 disables the heartbeat */
+
+	bool _compress;
+	double _deviation;		/**< max. error of the reconstructed curve */
+	double _slope_upper;	/**< doors of the current segment, per second */
+	double _slope_lower;
+
+	Reading _last;			/**< last forwarded reading */
+	Reading _held;			/**< last suppressed reading */
+	bool _have_last;
+	bool _have_held;
+
+	unsigned long _suppressed;
+};
+
+#endif /* _FILTER_H_ */
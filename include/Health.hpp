@@ -0,0 +1,107 @@
+/**
+ * Health of a middleware host
+ *
+ * All channels sending to the same host share one circuit breaker. After a
+ * failed request the breaker opens and the channels of the host wait for
+ * an exponentially growing, jittered backoff. Then a single probe request
+ * is let through, its outcome decides whether all channels resume or the
+ * host stays closed for the next, longer backoff.
+ *
+ * @package vzlogger
+ * @license http://opensource.org/licenses/gpl-license.php GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HEALTH_H_
+#define _HEALTH_H_
+
+#include <stdint.h>
+#include <string>
+
+#define HEALTH_DEFAULT_BACKOFF 15		/* first backoff after a failure in s */
+#define HEALTH_DEFAULT_MAX_BACKOFF 600	/* upper limit of the backoff in s */
+
+/**
+ * Circuit breaker of one host, not thread safe
+ *
+ * Times are in us of CLOCK_MONOTONIC and passed in by the caller.
+ */
+class Health {
+
+	public:
+	enum state_t {
+		CLOSED,		/**< host works, requests pass */
+		OPEN,		/**< host failed, requests wait for the backoff */
+		PROBING		/**< backoff passed, one probe request is running */
+	};
+
+	Health(const std::string &host, unsigned int seed = 0);
+
+	/**
+	 * Extract scheme, host and port of a middleware url
+	 *
+	 * @return e.g. "http://localhost:8080", "" for an empty url
+	 */
+	static std::string host_of(const std::string &url);
+
+	/**
+	 * May a request be sent now?
+	 *
+	 * In state OPEN the first request after the backoff becomes the
+	 * probe and moves the breaker to PROBING.
+	 */
+	bool admit(int64_t now);
+
+	/**
+	 * Host answered, close the breaker
+	 *
+	 * @return true if the breaker was not closed before
+	 */
+	bool success();
+
+	/**
+	 * Request failed, open the breaker for the next backoff
+	 *
+	 * A failed probe doubles the backoff up to max_backoff, failures of
+	 * requests which were sent before the breaker opened are ignored.
+	 *
+	 * @param backoff first backoff in s
+	 * @param max_backoff upper limit in s
+	 * @return true if the breaker has been opened again
+	 */
+	bool failure(int64_t now, int backoff, int max_backoff);
+
+	/**
+	 * The probe was not sent, e.g. the channel has been removed
+	 */
+	void cancel();
+
+	const std::string &host() const { return _host; }
+	state_t state() const { return _state; }
+	int64_t retry_at() const { return _retry_at; }
+	unsigned int failures() const { return _failures; }
+
+	private:
+	std::string _host;
+	state_t _state;
+	unsigned int _failures;		/**< consecutive failed probes */
+	int64_t _retry_at;			/**< end of the backoff */
+	unsigned int _seed;			/**< for rand_r() */
+};
+
+#endif /* _HEALTH_H_ */
@@ -0,0 +1,136 @@
+/**
+ * Asynchronous backend of print()
+ *
+ * Each thread formats its messages into a ring of its own, a writer
+ * thread drains all rings and writes the messages in batches. A thread
+ * logging therefore neither waits for the console or the logfile nor
+ * for other threads.
+ *
+ * @package vzlogger
+ * @license http://opensource.org/licenses/gpl-license.php GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LOGGER_H_
+#define _LOGGER_H_
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <list>
+
+#include <common.h>
+#include <SpscQueue.hpp>
+
+#define LOGGER_RING_SIZE 256		/* messages buffered per thread */
+#define LOGGER_MSG_LEN 216			/* longer messages are allocated */
+#define LOGGER_FLUSH_INTERVAL 50	/* ms between two batches of the writer */
+
+class Logger {
+
+	public:
+	Logger(size_t records = LOGGER_RING_SIZE);
+	~Logger();
+
+	/**
+	 * Start the writer thread, messages are written synchronously before
+	 */
+	void start();
+
+	/**
+	 * Stop the writer thread and write the remaining messages
+	 */
+	void stop();
+
+	/**
+	 * Format a message and queue it for the writer
+	 *
+	 * If the ring of the calling thread is full, the message is dropped
+	 * and counted. The writer reports the number of dropped messages.
+	 */
+	void log(log_level_t level, const char *id, const char *format, va_list args);
+
+	/**
+	 * Write to stdout/stderr unless running as daemon
+	 */
+	void console(bool enabled) { _console = enabled; }
+
+	/**
+	 * Append to this logfile as well, NULL to disable
+	 */
+	void logfile(FILE *file);
+
+	/**
+	 * Write the queued messages now (writer thread only, or if not running)
+	 */
+	void flush();
+
+	bool running() const { return _running; }
+	unsigned long dropped() const { return _dropped; }
+
+	private:
+	Logger(const Logger &);
+	Logger &operator=(const Logger &);
+
+	struct record {
+		unsigned long seq;			/**< order of the messages of all threads */
+		time_t time;
+		log_level_t level;
+		char id[8];					/**< section, truncated like the prefix */
+		char *text;					/**< NULL or allocated, if msg is too short */
+		char msg[LOGGER_MSG_LEN];
+	};
+
+	struct ring {
+		ring(size_t records) : queue(records), orphaned(false) {}
+		SpscQueue<record> queue;
+		volatile bool orphaned;		/**< thread has exited */
+	};
+
+	static void *worker(void *arg);
+	static void release(void *ring);
+	void run();
+
+	ring *local();
+	void format(record &rd, log_level_t level, const char *id, const char *format, va_list args);
+	void write(const record &rd);
+	const char *stamp(time_t time);
+
+	size_t _records;
+	std::list<ring *> _rings;
+	pthread_key_t _key;				/**< ring of the calling thread */
+
+	volatile unsigned long _seq;
+	volatile unsigned long _dropped;
+	unsigned long _reported;		/**< dropped messages already reported */
+
+	bool _console;
+	bool _daemon;					/**< parent is init, checked once per batch */
+	FILE *_file;
+
+	time_t _second;					/**< second of the cached prefix */
+	char _stamp[24];
+
+	pthread_t _thread;
+	volatile bool _running;
+	pthread_mutex_t _mutex;			/**< list of rings and the outputs */
+};
+
+#endif /* _LOGGER_H_ */
@@ -46,7 +46,10 @@ public:
 
 	void open();
 	int close();
-	size_t read(std::vector<Reading> &rds, size_t n);
+	/**
+	 * @param tick timestamp in us of all readings of a synchronized meter, < 0 keeps their own
+	 */
+	size_t read(std::vector<Reading> &rds, size_t n, int64_t tick = -1);
 
 	// setter
 	void interval(const int i) { _interval = i; }
@@ -57,6 +60,7 @@ public:
 
 	meter_protocol_t protocolId() const { return _protocol_id; }
 	vz::protocol::Protocol::Ptr protocol() const { return _protocol; }
+	int fd() const { return _protocol->fd(); }
 
 	ReadingIdentifier::Ptr identifier() const { return _identifier; }
 
@@ -66,6 +70,9 @@ public:
 	int aggtime() const { return _aggtime; }
 	bool aggFixedInterval() const { return _aggFixedInterval; }
 
+	// period of the shared tick in seconds, readings get the tick as timestamp. 0 if not synchronized
+	int sync() const { return _sync; }
+
 private:
 	static int instances;                   // meter instance id (increasing counter)
 	// bool _thread_running;   				// flag if thread is started
@@ -84,6 +91,7 @@ private:
 
 	int _aggtime;
 	bool _aggFixedInterval;
+	int _sync;
 
 	std::vector<Channel> channels;          // channel for logging
 };
@@ -37,12 +37,21 @@
 #ifndef _MeterMap_hpp_
 #define _MeterMap_hpp_
 #include <pthread.h>
+#include <signal.h>
 #include <vector>
+#include <list>
+#include <string>
 
 #include <common.h>
 #include <Options.hpp>
 #include <Meter.hpp>
 #include <Channel.hpp>
+#include <Uploader.hpp>
+#include <Reactor.hpp>
+#include <Scheduler.hpp>
+#include <EventNotifier.hpp>
+
+class MapContainer;
 
 /**
 	 The MeterMap is intend to keep the list of all configured channel for a given meter.
@@ -52,28 +61,49 @@ public:
 	typedef vz::shared_ptr<MeterMap> Ptr;
 	typedef std::vector<Channel::Ptr>::iterator iterator;
 	typedef std::vector<Channel::Ptr>::const_iterator const_iterator;
+	typedef std::vector<Channel::Ptr> route_t;
 
-	MeterMap(std::list<Option> options) : _meter(new Meter(options)){
+	MeterMap(std::list<Option> options) : _meter(new Meter(options)), _open(false), _exited(false),
+			_notify(NULL), _uploader(NULL), _scheduler(NULL), _timer(0), _reactor(NULL) {
 		_thread_running = false;
 	}
 	~MeterMap() {};
 	Meter::Ptr meter() { return _meter; }
 
 /**
-	 If the meter is enabled, start the meter and all its channels.
+	 If the meter is enabled, start the meter and hand its channels to the uploader.
+	 Meters with an interval are woken up by the scheduler, meters which send
+	 by themselves are read by the reactor if it is enabled.
+*/
+	void start(MapContainer &container);
+
+/**
+	 Stop reading, close the meter and unregister its channels from the uploader.
+	 Reactor threads have to be stopped.
 */
-	void start();
+	void stop();
 
 /**
-	 check if meter-thread is joinable
+	 Take over the channels of other, which has the same meter configuration.
+	 Unchanged channels keep their buffers and the meter stays open.
+*/
+	void reconfigure(MapContainer &container, MeterMap &other);
+
+/**
+	 check if meter-thread has terminated (or the reactor gave up), never blocks
 */
 	bool stopped();
 
 /**
- * cancel all channels for this meter.
+ * cancel the reading thread of this meter.
  */
 	void cancel();
 
+/**
+ * called by the reading thread when it terminates
+ */
+	void exited();
+
 /**
  * send device-registration for each channel
  */
@@ -87,37 +117,154 @@ public:
 	inline iterator end()    { return _channels.end(); }
 	inline size_t size()     { return _channels.size(); }
 
+/**
+ * Channels which take readings with the given identifier
+ *
+ * @return NULL if no channel is configured for this identifier
+ */
+	inline const route_t *route(reading_id_t id) const {
+		return (id < _routes.size() && !_routes[id].empty()) ? &_routes[id] : NULL;
+	}
+
+/**
+ * Build routing table from the configured channels
+ */
+	void build_routes();
+
 	bool running() const { return _thread_running; }
 
+/**
+ * Wait for the next reading of a meter with an interval
+ *
+ * @return wall clock time of the deadline in us, -1 if the meter is not scheduled
+ */
+	int64_t wait_tick() { return (_scheduler != NULL) ? _scheduler->wait(_timer) : -1; }
+
+/**
+ * Deadlines at which the meter was still busy, and the ticks it missed
+ */
+	unsigned long overruns() const { return (_scheduler != NULL) ? _scheduler->overruns(_timer) : 0; }
+	unsigned long skipped() const  { return (_scheduler != NULL) ? _scheduler->skipped(_timer) : 0; }
+
+/**
+ * Configuration of the meter without its channels, compared on reload
+ */
+	void config(const std::string &config) { _config = config; }
+	const std::string &config() const { return _config; }
+	bool same_channels(const MeterMap &other) const;
+
 private:
+	void attach(Channel::Ptr ch);
+	void detach(Channel::Ptr ch);
+	void resume(MapContainer &container);
+	void pause();
+
 	Meter::Ptr _meter;
 	std::vector<Channel::Ptr> _channels;
+	std::vector<route_t> _routes;	// indexed by interned identifier
+	std::string _config;    // serialized json of the meter
 
+	bool _open;             // meter has been opened by start()
 	bool _thread_running;   // flag if thread is started
 	pthread_t _thread;      // Thread data for meter (reading)
+	volatile bool _exited;  // _thread terminated by itself
+	EventNotifier *_notify; // wakes up the main loop when _thread terminates
+
+	Uploader *_uploader;    // sends the readings of our channels, NULL if not logging
+	Scheduler *_scheduler;  // wakes up _thread at each interval, NULL if not used
+	size_t _timer;          // index of the timer at _scheduler
+
+	Reactor *_reactor;      // reads the meter instead of _thread, NULL if not used
+	vz::shared_ptr<Reactor::Handler> _handler;	// registered with _reactor
 };
 
 /**
 	 This container is intend to keep the list of all configured meters.
+	 It is a list, so running meters keep their address when meters are added
+	 or removed by a reload.
 */
 class MapContainer {
 public:
 	typedef vz::shared_ptr<MapContainer> Ptr;
-	typedef std::vector<MeterMap>::iterator iterator;
-	typedef std::vector<MeterMap>::const_iterator const_iterator;
+	typedef std::list<MeterMap>::iterator iterator;
+	typedef std::list<MeterMap>::const_iterator const_iterator;
 
-	MapContainer() {};
-	~MapContainer() {};
+	MapContainer() : _signal(0), _reload(0) {
+		pthread_rwlock_init(&_lock, NULL);
+	}
+	~MapContainer() {
+		pthread_rwlock_destroy(&_lock);
+	}
+
+/**
+ *  Called by the signal handler, only wakes up the main loop
+ */
+	void signal(int sig) {
+		if (sig == SIGHUP) {
+			_reload = 1;
+		} else {
+			_signal = sig;
+		}
+		_event.notify();
+	}
+
+/**
+ *  Main loop: block until a signal arrived or a meter terminated
+ *
+ *  @param timeout in milliseconds, the reactor is checked after it
+ */
+	void wait(int timeout) { _event.wait(timeout); }
+	int pending_signal() const { return _signal; }
+	bool pending_reload() {
+		bool reload = _reload;
+		_reload = 0;
+		return reload;
+	}
 
 	void quit(int sig) {
-        print(log_debug, "terminating on signal %d.", (char*)0, sig);
+        PRINT(log_debug, "terminating on signal %d.", (char*)0, sig);
 		print(log_info, "Closing connections to terminate", (char*)0);
 
 		for (iterator it = _mappings.begin(); it!=_mappings.end(); it++) {
 			it->cancel();
 		}
+		_reactor.shutdown();
 	}
 
+/**
+ *  Apply a configuration which has been parsed into fresh
+ *
+ *  Meters and channels with the same configuration keep running, changed
+ *  and removed ones are stopped, new ones are started.
+ */
+	void reload(MapContainer &fresh);
+
+/**
+ *  Taken by readers which run concurrently to a reload, e.g. the local interface
+ */
+	void read_lock() { pthread_rwlock_rdlock(&_lock); }
+	void unlock()    { pthread_rwlock_unlock(&_lock); }
+
+/**
+ *  Pool sending the readings of all channels
+ */
+	inline Uploader &uploader() { return _uploader; }
+
+/**
+ *  Timer wheel waking up periodic meters
+ */
+	inline Scheduler &scheduler() { return _scheduler; }
+
+/**
+ *  Event loop reading meters which send by themselves
+ */
+	inline Reactor &reactor() { return _reactor; }
+
+/**
+ *  Wakes up the main loop
+ */
+	inline EventNotifier &event() { return _event; }
+
 /**
  *  Accessor to the MeterMap (meter and its channels) list
  */
@@ -127,7 +274,17 @@ public:
 	inline size_t size() const { return _mappings.size(); }
 
 private:
-	std::vector<MeterMap> _mappings;
+	MapContainer(const MapContainer &);
+	MapContainer &operator=(const MapContainer &);
+
+	std::list<MeterMap> _mappings;
+	Uploader _uploader;
+	Scheduler _scheduler;
+	Reactor _reactor;
 
+	EventNotifier _event;
+	volatile sig_atomic_t _signal;	// SIGINT or SIGTERM received
+	volatile sig_atomic_t _reload;	// SIGHUP received
+	pthread_rwlock_t _lock;			// write locked during a reload
 };
 #endif /* _MeterMap_hpp_ */
@@ -44,6 +44,7 @@ class Obis {
 	const std::string toString()  ;
 
 	bool operator==(const Obis &rhs) const;
+	size_t hash() const;
 
 	bool isManufacturerSpecific() const;
 	bool isAllNotGiven() const; // check whether all are not given (=DC/255)
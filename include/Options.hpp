@@ -77,8 +77,8 @@ public:
 	typedef std::list<Option>::iterator iterator;
 	typedef std::list<Option>::const_iterator const_iterator;
 
-	const Option& lookup(std::list<Option> options, const std::string &key) const;
-	const char  *lookup_string(std::list<Option> options, const char *key);
+	const Option& lookup(const std::list<Option> &options, const std::string &key) const;
+	const char  *lookup_string(const std::list<Option> &options, const char *key);
 	int    lookup_int(std::list<Option> options, const char *key) const;
 	bool   lookup_bool(std::list<Option> options, const char *key) const;
 	double lookup_double(std::list<Option> options, const char *key) const;
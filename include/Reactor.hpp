@@ -0,0 +1,112 @@
+/**
+ * Event loop for meters which send data by themselves
+ *
+ * Instead of one blocking reading thread per meter, the descriptors of
+ * all serial, socket and fifo meters are registered with one epoll
+ * instance. A small number of threads waits on it and reads from a
+ * meter as soon as it has data.
+ *
+ * @package vzlogger
+ * @license http://opensource.org/licenses/gpl-license.php GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _REACTOR_H_
+#define _REACTOR_H_
+
+#include <pthread.h>
+#include <vector>
+
+#include "EventNotifier.hpp"
+
+class Reactor {
+
+	public:
+	/**
+	 * Source of events, e.g. a meter
+	 */
+	class Handler {
+		public:
+		virtual ~Handler() {}
+
+		/* descriptor to wait for, must stay open while registered */
+		virtual int fd() const = 0;
+
+		/**
+		 * Descriptor is readable, called by one thread at a time
+		 *
+		 * @return false to unregister the handler
+		 */
+		virtual bool ready() = 0;
+	};
+
+	Reactor();
+	~Reactor();
+
+	/**
+	 * Register a handler, may be called before and after start()
+	 */
+	void add(Handler *handler);
+
+	/**
+	 * Unregister a handler, the threads have to be stopped
+	 * (they are only cancelled between two handlers)
+	 */
+	void remove(Handler *handler);
+
+	void start(int threads);
+
+	/**
+	 * Stop and join the threads
+	 */
+	void stop();
+
+	/**
+	 * Wake up wait(), e.g. from the signal handler
+	 */
+	void shutdown();
+
+	/**
+	 * Block until a handler failed, all handlers are gone or shutdown() was called
+	 */
+	void wait();
+
+	bool finished() const { return _finished; }
+	size_t size() const { return _handlers; }
+	size_t threads() const { return _threads.size(); }
+
+	private:
+	Reactor(const Reactor &);
+	Reactor &operator=(const Reactor &);
+
+	static void *worker(void *arg);
+	void run();
+	void drop(Handler *handler);
+
+	int _epfd;
+	volatile size_t _handlers;		/**< registered handlers */
+	volatile bool _finished;		/**< wait() returns */
+	EventNotifier _done;			/**< wakes up wait() */
+
+	std::vector<Handler *> _registry;	/**< registered handlers */
+	pthread_mutex_t _mutex;			/**< protects _registry */
+
+	std::vector<pthread_t> _threads;
+};
+
+#endif /* _REACTOR_H_ */
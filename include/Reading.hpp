@@ -31,6 +31,11 @@
 
 #include <sys/time.h>
 #include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <vector>
+#include <list>
+#include <tr1/unordered_map>
 
 #include "Obis.hpp"
 #include <shared_ptr.hpp>
@@ -50,6 +55,11 @@ public:
 
 	virtual const std::string toString()  = 0;
 
+	/* heap copy of the concrete identifier, used when interning */
+	virtual ReadingIdentifier *clone() const = 0;
+	/* equal identifiers have to return equal hashes */
+	virtual size_t hash() const = 0;
+
 protected:
 	explicit ReadingIdentifier() {};
 
@@ -77,6 +87,9 @@ public:
 
 	const Obis &obis() const { return _obis; }
 
+	ReadingIdentifier *clone() const { return new ObisIdentifier(*this); }
+	size_t hash() const;
+
 private:
 	//ObisIdentifier (const ObisIdentifier& original);
 	//ObisIdentifier& operator= (const ObisIdentifier& rhs);
@@ -98,6 +111,9 @@ public:
 		oss << "StringItentifier:";
 		return oss.str();
 	};
+
+	ReadingIdentifier *clone() const { return new StringIdentifier(*this); }
+	size_t hash() const;
 protected:
 	std::string _string;
 };
@@ -118,6 +134,9 @@ public:
 		return oss.str();
 	};
 
+	ReadingIdentifier *clone() const { return new ChannelIdentifier(*this); }
+	size_t hash() const;
+
 protected:
 	int _channel;
 };
@@ -132,9 +151,62 @@ public:
 		oss << "NilIdentifier";
 		return oss.str();
 	};
+
+	ReadingIdentifier *clone() const { return new NilIdentifier(*this); }
+	size_t hash() const { return 0; }
+private:
+};
+
+/**
+ * Intern table for identifiers
+ *
+ * Readings refer to their identifier by a small integer. The identifiers
+ * of the configured channels are interned while the configuration is
+ * parsed and the routes are built, which takes a mutex. freeze() then
+ * publishes a read-only copy of the table; lookup() and get() on the read
+ * path use this copy without any locking. Parsers skip readings whose
+ * identifier is not in the table, so it does not grow at runtime.
+ * Entries are never removed, id 0 is the NilIdentifier.
+ */
+typedef uint32_t reading_id_t;
+
+class IdentifierTable {
+
+public:
+	static reading_id_t intern(const ReadingIdentifier &rid);
+	static reading_id_t intern(ReadingIdentifier::Ptr rid);
+	static void freeze();
+
+	/* lock-free, 0 if the identifier has not been interned and frozen */
+	static reading_id_t lookup(const ReadingIdentifier &rid);
+	static ReadingIdentifier::Ptr get(reading_id_t id);
+	static size_t size();
+
 private:
+	typedef std::tr1::unordered_multimap<size_t, reading_id_t> index_t;
+
+	struct Frozen {
+		std::vector<ReadingIdentifier::Ptr> ids;
+		index_t index;
+	};
+
+	static void init();
+	static reading_id_t find(const std::vector<ReadingIdentifier::Ptr> &ids,
+							 const index_t &index, const ReadingIdentifier &rid);
+
+	static pthread_mutex_t _mutex;
+	static std::vector<ReadingIdentifier::Ptr> _ids;
+	static index_t _index;
+	static std::list<Frozen> _tables;	// all published copies, readers may still use old ones
+	static Frozen * volatile _frozen;	// newest of _tables
 };
 
+/**
+ * A single reading
+ *
+ * Trivially copyable, so it can be moved around in buffers and queues
+ * without touching reference counts or the heap.
+ */
 class Reading {
 
 public:
@@ -142,23 +214,27 @@ public:
 	Reading();
 	Reading(ReadingIdentifier::Ptr pIndentifier);
 	Reading(double pValue, struct timeval pTime, ReadingIdentifier::Ptr pIndentifier);
-	Reading(const Reading &orig);
-
-	bool deleted() const { return _deleted; }
-	void  mark_delete()        { _deleted = true; }
-	void  reset()              { _deleted = false; }
 
 	void value(const double &v) { _value = v; }
 	double value() const  { return _value; }
 
+	/* integer timestamps, no floating point involved */
+	int64_t time_us() const    { return _time; }
+	void time_us(int64_t us)   { _time = us; }
+	int64_t time_ms() const    { return (_time + 500) / 1000; } // rounded
+	time_t time_s() const      { return _time / 1000000; }      // truncated
+
 	double tvtod() const;
 	double tvtod(struct timeval const &tv) const;
-	void time() { gettimeofday(&_time, NULL); }
-	void time(struct timeval const &v) { _time = v; }
+	void time();
+	void time(struct timeval const &v) { _time = (int64_t)v.tv_sec * 1000000 + v.tv_usec; }
 	struct timeval dtotv(double const &ts) const; // doesn't set the time, just returns a timeval!
 
-	void identifier(ReadingIdentifier *rid)  { _identifier.reset(rid); }
-	const ReadingIdentifier::Ptr identifier() { return _identifier; }
+	void identifier(const ReadingIdentifier &rid)  { _id = IdentifierTable::intern(rid); }
+	const ReadingIdentifier::Ptr identifier() const { return IdentifierTable::get(_id); }
+
+	void id(reading_id_t id) { _id = id; }
+	reading_id_t id() const  { return _id; }
 
 /**
  * Print identifier to buffer for debugging/dump
@@ -168,10 +244,9 @@ public:
     size_t unparse(/*meter_protocol_t protocol,*/ char *buffer, size_t n);
 
 protected:
-	bool   _deleted;
+	int64_t _time;		/**< microseconds since epoch */
 	double _value;
-	struct timeval _time;
-	ReadingIdentifier::Ptr _identifier;
+	reading_id_t _id;	/**< index into IdentifierTable */
 };
 
 /**
@@ -0,0 +1,148 @@
+/**
+ * Drift-free scheduler for periodic meters
+ *
+ * Instead of sleeping for the interval after each reading, the reading
+ * threads of periodic meters wait for ticks of one central timer wheel.
+ * Deadlines are absolute CLOCK_MONOTONIC times which are aligned to
+ * multiples of the interval on the wall clock, so the time needed to read
+ * the meter does not add up over time.
+ *
+ * @package vzlogger
+ * @license http://opensource.org/licenses/gpl-license.php GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+#include <stdint.h>
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include <list>
+
+#define SCHEDULER_RESOLUTION 100000	/* length of a tick in us, must divide one second */
+#define SCHEDULER_SLOTS 256			/* slots of the timer wheel */
+
+/**
+ * Hashed timer wheel with a fixed tick length
+ *
+ * Tick 0 starts at a full second of the wall clock, so deadlines which are
+ * multiples of the interval fall exactly on a tick. A timer is fired when
+ * the wheel reaches its slot and the deadline has passed.
+ *
+ * If the meter is still busy with the last reading when its deadline is
+ * reached, the tick is skipped and the meter waits for the next one. The
+ * phase is kept, there is no burst of readings to catch up.
+ *
+ * The scheduler thread sleeps until the next deadline, but at most one turn
+ * of the wheel, so a changed system time is noticed in time.
+ */
+class Scheduler {
+
+	public:
+	Scheduler(int64_t resolution = SCHEDULER_RESOLUTION);
+	~Scheduler();
+
+	/**
+	 * Register a periodic timer, may be called before and after start()
+	 *
+	 * @param name used for log messages, e.g. the meter name
+	 * @param interval in us, rounded to whole ticks
+	 * @return index of the timer, indexes of removed timers are reused
+	 */
+	size_t add(const char *name, int64_t interval);
+
+	/**
+	 * Unregister a timer, nobody may wait for it any more
+	 */
+	void remove(size_t timer);
+
+	void start();
+
+	/**
+	 * Stop and join the scheduler thread
+	 */
+	void stop();
+
+	/**
+	 * Block until the next deadline of the timer (cancellation point)
+	 *
+	 * @return wall clock time of the deadline in us since epoch
+	 */
+	int64_t wait(size_t timer);
+
+	/* times the meter was still busy at a deadline */
+	unsigned long overruns(size_t timer);
+
+	/* deadlines which passed without waking up the meter */
+	unsigned long skipped(size_t timer);
+
+	size_t size() const { return _timers.size(); }
+	bool running() const { return _running; }
+
+	private:
+	Scheduler(const Scheduler &);
+	Scheduler &operator=(const Scheduler &);
+
+	struct timer {
+		std::string name;
+		uint64_t interval;		/**< in ticks */
+		uint64_t due;			/**< tick of the next deadline */
+		uint64_t tick;			/**< last deadline handed to the waiter */
+		bool waiting;			/**< meter thread blocks in wait() */
+		bool fired;				/**< deadline reached while waiting */
+		bool late;				/**< deadline missed since the last wait() */
+		bool active;			/**< false once removed */
+		unsigned long overruns;
+		unsigned long skipped;
+	};
+
+	struct waiter {
+		Scheduler *scheduler;
+		size_t timer;
+	};
+
+	static void *worker(void *arg);
+	static void cleanup(void *arg);
+	void run();
+
+	static int64_t now(clockid_t clock);
+	void anchor();
+	uint64_t current();
+	void schedule(size_t timer);
+	uint64_t next();
+	void expire(size_t slot, uint64_t last);
+
+	int64_t _resolution;
+	int64_t _origin_mono;			/**< CLOCK_MONOTONIC at tick 0 */
+	int64_t _origin_wall;			/**< CLOCK_REALTIME at tick 0 */
+	uint64_t _tick;					/**< last tick processed */
+
+	std::vector<timer> _timers;
+	std::vector<std::list<size_t> > _wheel;
+
+	pthread_t _thread;
+	bool _running;
+
+	pthread_mutex_t _mutex;
+	pthread_cond_t _cond;			/**< signals fired timers to the meters */
+	pthread_cond_t _wakeup;			/**< signals added timers to the scheduler thread */
+};
+
+#endif /* _SCHEDULER_H_ */
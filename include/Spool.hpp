@@ -0,0 +1,134 @@
+/**
+ * Persistent spool for unsent readings
+ *
+ * Append-only segment files which are memory mapped. Readings are written
+ * once by the logging thread, uploaded from the mapping and the segment
+ * file is removed as soon as all its readings have been acknowledged.
+ *
+ * @package vzlogger
+ * @license http://opensource.org/licenses/gpl-license.php GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SPOOL_H_
+#define _SPOOL_H_
+
+#include <stdint.h>
+#include <string>
+#include <deque>
+
+#include <Reading.hpp>
+
+#define SPOOL_SEGMENT_RECORDS 4096	/* readings per segment file */
+#define SPOOL_MAGIC "VZSPOOL"
+#define SPOOL_VERSION 1
+
+/**
+ * Disk backed FIFO of readings
+ *
+ * Not thread safe, it is owned by the logging thread of a channel.
+ * Only the oldest (head) and the newest (tail) segment are mapped, so
+ * memory use does not depend on the length of the backlog.
+ *
+ * append() does not touch the disk, commit() syncs everything appended
+ * since the last commit at once (group commit) together with the ack pointer.
+ * After a crash readings acknowledged since the last commit are sent again.
+ */
+class Spool {
+
+	public:
+	typedef vz::shared_ptr<Spool> Ptr;
+
+	/**
+	 * Open or create the spool, existing segments are recovered
+	 *
+	 * @param dir directory holding the segment files
+	 * @param name prefix of the segment files, e.g. the channel uuid
+	 */
+	Spool(const std::string &dir, const std::string &name, size_t records = SPOOL_SEGMENT_RECORDS);
+	~Spool();
+
+	void append(const Reading &rd);
+	void commit();
+
+	/**
+	 * Reading at offset from the oldest unacknowledged one
+	 *
+	 * Only the head segment is mapped, so NULL is returned at its end
+	 * even if more readings are spooled. The pointer stays valid until
+	 * the reading is acknowledged.
+	 */
+	Reading *peek(size_t offset);
+
+	/**
+	 * Release the n oldest readings, fully acknowledged segments are removed
+	 */
+	void acknowledge(size_t n);
+
+	size_t size() const { return _size; }
+	bool empty() const { return _size == 0; }
+	size_t segments() const { return _segments.size(); }
+
+	private:
+	Spool(const Spool &);
+	Spool &operator=(const Spool &);
+
+	/* on-disk layout, followed by _records readings */
+	struct header {
+		char magic[8];
+		uint32_t version;
+		uint32_t record_size;
+		uint64_t records;		/**< capacity of the segment */
+		uint64_t count;			/**< committed readings */
+		uint64_t acked;			/**< acknowledged readings */
+		char reserved[24];
+	};
+
+	struct segment {
+		unsigned long seq;
+		uint64_t count;			/**< appended readings, committed or not */
+		uint64_t acked;
+		uint64_t synced;		/**< readings already synced to disk */
+		int fd;
+		header *hdr;			/**< NULL if not mapped */
+	};
+
+	std::string path(unsigned long seq) const;
+	size_t mapping_size() const;
+
+	void recover();
+	void create();
+	void map(segment &seg);
+	void unmap(segment &seg);
+	void remove_head();
+	void sync(segment &seg);
+
+	Reading *records(const segment &seg) const {
+		return reinterpret_cast<Reading *>(seg.hdr + 1);
+	}
+
+	std::string _dir;
+	std::string _name;
+	size_t _records;			/**< readings per segment */
+	size_t _size;				/**< unacknowledged readings of all segments */
+	unsigned long _next_seq;	/**< sequence number of the next segment file */
+
+	std::deque<segment> _segments;	/**< oldest first */
+};
+
+#endif /* _SPOOL_H_ */
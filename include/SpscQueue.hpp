@@ -0,0 +1,124 @@
+/**
+ * Lock-free single producer / single consumer queue
+ *
+ * Used to hand readings from the reading thread (producer) to the
+ * logging thread (consumer) of a channel without taking a mutex.
+ *
+ * The consumer reads items in place with peek() and releases them with
+ * acknowledge() once they have been processed, e.g. after a successful
+ * upload. Until then they stay in the queue and can be read again.
+ *
+ * @package vzlogger
+ * @license http://opensource.org/licenses/gpl-license.php GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SPSC_QUEUE_H_
+#define _SPSC_QUEUE_H_
+
+#include <vector>
+#include <cstddef>
+
+/**
+ * Bounded ring with free running head/tail counters
+ *
+ * Only the producer writes _tail, only the consumer writes _head.
+ * The capacity is rounded up to the next power of two.
+ * Barriers use the gcc __sync builtins, which are available on all
+ * toolchains we build with (including OpenWRT).
+ */
+template <typename T>
+class SpscQueue {
+
+	public:
+	explicit SpscQueue(size_t capacity)
+			: _head(0)
+			, _tail(0)
+	{
+		size_t n = 1;
+		while (n < capacity) n <<= 1;
+		_slots.resize(n);
+		_mask = n - 1;
+	}
+
+	/**
+	 * Append an item (producer only)
+	 *
+	 * @return false if the queue is full
+	 */
+	bool push(const T &item) {
+		size_t tail = _tail;
+		if (tail - _head > _mask) return false;
+
+		_slots[tail & _mask] = item;
+		__sync_synchronize(); /* publish slot before tail */
+		_tail = tail + 1;
+		return true;
+	}
+
+	/**
+	 * Item at offset from the oldest one, NULL if there is none (consumer only)
+	 * The pointer stays valid until the item is acknowledged.
+	 */
+	T *peek(size_t offset) {
+		size_t head = _head;
+		if (offset >= _tail - head) return NULL;
+
+		__sync_synchronize(); /* read tail before slot */
+		return &_slots[(head + offset) & _mask];
+	}
+
+	/**
+	 * Release the n oldest items (consumer only)
+	 */
+	void acknowledge(size_t n) {
+		if (n > size()) n = size();
+
+		__sync_synchronize(); /* finish reading slots before releasing them */
+		_head = _head + n;
+	}
+
+	T *front() { return peek(0); }
+	void pop()  { acknowledge(1); }
+
+	bool pop(T &item) {
+		T *p = front();
+		if (p == NULL) return false;
+
+		item = *p;
+		pop();
+		return true;
+	}
+
+	size_t size() const { return _tail - _head; }
+	bool empty() const { return _tail == _head; }
+	size_t capacity() const { return _mask + 1; }
+
+	private:
+	SpscQueue(const SpscQueue &);
+	SpscQueue &operator=(const SpscQueue &);
+
+	std::vector<T> _slots;
+	size_t _mask;
+
+	volatile size_t _head;		/**< next slot to read, consumer side */
+	char _pad[64];				/**< keep head and tail on separate cache lines */
+	volatile size_t _tail;		/**< next slot to write, producer side */
+};
+
+#endif /* _SPSC_QUEUE_H_ */
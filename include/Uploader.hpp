@@ -0,0 +1,206 @@
+/**
+ * Pool of uploader threads
+ *
+ * A fixed number of threads sends the readings of all channels to the
+ * middleware. Channels with published readings are put on a run queue,
+ * an idle worker takes the next one from it. A slow middleware therefore
+ * occupies at most the workers which are currently talking to it.
+ *
+ * Channels are grouped by the host of their middleware. If a host fails,
+ * its channels are parked instead of sleeping in a worker, see Health.
+ * The worker waiting for the next job also waits for the end of the
+ * backoff and queues one parked channel as probe.
+ *
+ * Instead of the workers, a single thread can drive the curl multi
+ * interface. It keeps requests of many channels in flight at once and
+ * acknowledges the readings of a channel when its request completes.
+ *
+ * @package vzlogger
+ * @license http://opensource.org/licenses/gpl-license.php GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _UPLOADER_H_
+#define _UPLOADER_H_
+
+#include <pthread.h>
+#include <vector>
+#include <deque>
+#include <map>
+#include <curl/curl.h>
+
+#include <Channel.hpp>
+#include <ApiIF.hpp>
+#include <Health.hpp>
+
+#define UPLOADER_DEFAULT_WORKERS 4	/* threads sending to the middleware */
+
+class Uploader {
+
+	public:
+	Uploader();
+	~Uploader();
+
+	/**
+	 * Backoff after a failed request to a middleware host
+	 *
+	 * @param backoff first backoff in s, doubled for each failed probe
+	 * @param max_backoff upper limit in s
+	 */
+	void backoff(int backoff, int max_backoff);
+
+	/**
+	 * Register a channel, may be called before and after start()
+	 *
+	 * @return index of the job of this channel
+	 */
+	size_t add(Channel::Ptr ch, vz::ApiIF::Ptr api);
+
+	/**
+	 * Unregister a channel, e.g. on a reload of the configuration
+	 *
+	 * Waits until a worker sending the channel is done with it.
+	 * Readings which have not been sent are dropped with the channel.
+	 * Its job is reused by the next channel added.
+	 */
+	void remove(size_t job);
+
+	/**
+	 * Start the workers, at most one per channel is started
+	 *
+	 * @param parallel if > 0, start one thread instead which keeps up to
+	 *        parallel requests in flight with the curl multi interface
+	 */
+	void start(int workers = UPLOADER_DEFAULT_WORKERS, int parallel = 0);
+
+	/**
+	 * Stop and join the workers, readings which have not been sent stay queued
+	 *
+	 * Workers finish the request they are sending, so this waits up to
+	 * the timeout of the api.
+	 */
+	void stop();
+
+	/**
+	 * Channel has published new readings (called by the reading thread)
+	 *
+	 * A channel is queued only once. If it is being sent right now,
+	 * it is queued again when the worker is done with it. If its host
+	 * is down, it is parked until the host recovers.
+	 */
+	void ready(size_t job);
+
+	/**
+	 * Next channel to send, blocks until there is one
+	 *
+	 * Parked channels of a host are released here when its backoff ends.
+	 *
+	 * @param block wait for a job, else return -1 if there is none
+	 * @return index of the job or -1 if the pool is stopping
+	 */
+	long next(bool block = true);
+
+	/**
+	 * Worker finished a job
+	 *
+	 * @param again queue the job again, e.g. while a backlog shrinks
+	 */
+	void done(size_t job, bool again);
+
+	/**
+	 * Send readings of a channel once, returns true if there are more to send
+	 *
+	 * The outcome of the request is recorded for the host of the channel.
+	 */
+	bool process(size_t job);
+
+	size_t size() const { return _jobs.size(); }
+	size_t workers() const { return _threads.size(); }
+	size_t queued();
+	size_t parked();
+
+	/**
+	 * State of the middleware host of a channel, CLOSED without a host
+	 */
+	Health::state_t health(size_t job);
+
+	private:
+	Uploader(const Uploader &);
+	Uploader &operator=(const Uploader &);
+
+	static void *worker(void *arg);
+	static void *event_loop(void *arg);
+	void run();
+	void run_multi();
+
+	CURL *begin(size_t job, size_t &pending);
+	bool complete(size_t job, size_t pending, CURLcode code);
+	void wakeup();
+
+	static int64_t now();
+	bool admit(size_t job);
+	void park(size_t job);
+	void release(int64_t now);
+	int64_t deadline();
+	void report(size_t job, bool ok);
+
+	enum task_state {
+		IDLE,		/**< nothing to send */
+		QUEUED,		/**< waiting for a worker */
+		RUNNING,	/**< being sent by a worker */
+		PARKED,		/**< waiting for its host to recover */
+		REMOVED		/**< channel has been unregistered */
+	};
+
+	struct task {
+		Channel::Ptr channel;
+		vz::ApiIF::Ptr api;
+		task_state state;
+		bool again;			/**< readings published while running */
+		long host;			/**< index in _hosts, -1 without middleware */
+	};
+
+	struct request {
+		size_t job;
+		size_t pending;		/**< readings of the channel when the request started */
+	};
+
+	struct host {
+		Health health;
+		std::deque<size_t> parked;	/**< jobs in state PARKED, oldest first */
+		long probe;					/**< job sending the probe request, -1 if none */
+	};
+
+	std::vector<task> _jobs;
+	std::vector<host> _hosts;
+	std::deque<size_t> _runq;		/**< jobs in state QUEUED, oldest first */
+	std::vector<pthread_t> _threads;
+	bool _stopping;
+
+	CURLM *_multi;					/**< multi handle of the event loop, NULL with workers */
+	size_t _parallel;				/**< max. requests in flight of the event loop */
+
+	int _backoff;					/**< first backoff in s */
+	int _max_backoff;				/**< upper limit of the backoff in s */
+
+	pthread_mutex_t _mutex;
+	pthread_cond_t _cond;			/**< signaled when a job is queued or parked, CLOCK_MONOTONIC */
+	pthread_cond_t _done;			/**< signaled when a worker finished a job */
+};
+
+#endif /* _UPLOADER_H_ */
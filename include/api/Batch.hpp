@@ -0,0 +1,137 @@
+/**
+ * Channels of a middleware uploading in one request
+ *
+ * @package vzlogger
+ * @license http://opensource.org/licenses/gpl-license.php GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _Batch_hpp_
+#define _Batch_hpp_
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include <map>
+
+#include <shared_ptr.hpp>
+#include <Channel.hpp>
+
+#define BATCH_DEFAULT_TUPLES 1000	/* max. tuples per request */
+#define BATCH_DEFAULT_BYTES 65536	/* max. size of the request body */
+
+namespace vz {
+	namespace api {
+
+		class Volkszaehler;
+
+		/**
+		 * Channels sharing a bulk endpoint
+		 *
+		 * The first channel of the batch whose upload is due collects the
+		 * pending tuples of all channels into a single request:
+		 *
+		 *   [{"uuid": "<uuid>", "tuples": [[<ms>, <value>], ...]}, ...]
+		 *
+		 * Only one request of a batch is in flight. Channels becoming ready
+		 * meanwhile are sent with the next request, which their uploader jobs
+		 * start once the current one has completed.
+		 */
+		class Batch {
+		public:
+			typedef vz::shared_ptr<Batch> Ptr;
+
+			/**
+			 * Batch of a bulk endpoint, created on first use
+			 *
+			 * The limits of the channel creating the batch apply to all.
+			 */
+			static Ptr get(const std::string &url, size_t tuples, size_t bytes);
+
+			~Batch();
+
+			void join(Volkszaehler *member);
+
+			/**
+			 * Does not wait for the request in flight: if it carries tuples of
+			 * the member, its channel and cursor are handed to the sender
+			 */
+			void leave(Volkszaehler *member);
+
+			/**
+			 * Become the sender of the next request
+			 *
+			 * @return false if a request of the batch is in flight
+			 */
+			bool acquire();
+			void release();
+
+			/**
+			 * Guards the members and the request in flight. The sender holds it
+			 * while it reads or acknowledges other members, so they cannot leave.
+			 */
+			void lock()   { pthread_mutex_lock(&_lock); }
+			void unlock() { pthread_mutex_unlock(&_lock); }
+
+			/**
+			 * Members of the next request, starting with first and continuing in
+			 * the order of joining, called with the lock held
+			 */
+			std::vector<Volkszaehler *> &begin(Volkszaehler *first);
+
+			/**
+			 * Members of the request in flight, NULL for those which left meanwhile,
+			 * called with the lock held
+			 */
+			std::vector<Volkszaehler *> &sent() { return _sent; }
+
+			/**
+			 * Channels which left with tuples in flight and their cursors,
+			 * called with the lock held
+			 */
+			std::vector<std::pair<Channel::Ptr, size_t> > &handed() { return _handed; }
+
+			const std::string &url() const { return _url; }
+			size_t tuples() const { return _tuples; }
+			size_t bytes() const { return _bytes; }
+
+			/* number of bulk endpoints in use */
+			static size_t batches();
+
+		private:
+			Batch(const std::string &url, size_t tuples, size_t bytes);
+			Batch(const Batch &);
+			Batch &operator=(const Batch &);
+
+			std::string _url;
+			size_t _tuples;
+			size_t _bytes;
+
+			std::vector<Volkszaehler *> _members;
+			std::vector<Volkszaehler *> _sent;	/**< members of the request in flight */
+			std::vector<std::pair<Channel::Ptr, size_t> > _handed;	/**< left with tuples in flight */
+			bool _busy;				/**< a request is in flight */
+			pthread_mutex_t _lock;
+
+			static pthread_mutex_t _mutex;
+			static std::map<std::string, vz::weak_ptr<Batch> > _batches;
+		}; // class Batch
+
+	} // namespace api
+} // namespace vz
+#endif /* _Batch_hpp_ */
@@ -30,6 +30,8 @@
 
 #include <curl/curl.h>
 
+#include <api/CurlShare.hpp>
+
 namespace vz {
 	namespace api {
 
@@ -43,10 +45,16 @@ namespace vz {
 			void addHeader(const std::string value);
 			void clearHeader();
 			void commitHeader();
+
+			/**
+			 * Share caches and connections with other handles of the host of url
+			 */
+			void share(const std::string &url);
       
 			CURLcode perform() { return curl_easy_perform(handle()); }
       
 		private:
+			CurlShare::Ptr _share;
 			CURL *_curl;
 			struct curl_slist *_headers;
 		}; // class CurlIF
@@ -0,0 +1,87 @@
+/**
+ * Caches shared by all CURL handles of a middleware host
+ *
+ * @package vzlogger
+ * @license http://opensource.org/licenses/gpl-license.php GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CurlShare_hpp_
+#define _CurlShare_hpp_
+
+#include <pthread.h>
+#include <string>
+#include <map>
+
+#include <curl/curl.h>
+
+#include <shared_ptr.hpp>
+
+namespace vz {
+	namespace api {
+
+		/**
+		 * CURLSH handle of one host
+		 *
+		 * Channels sending to the same middleware share the DNS cache, the
+		 * TLS sessions and the keep-alive connections. Instead of one
+		 * connection per channel, the uploader workers reuse a few warm
+		 * connections to the host.
+		 */
+		class CurlShare {
+		public:
+			typedef vz::shared_ptr<CurlShare> Ptr;
+
+			/**
+			 * Share of the host of a middleware url, created on first use
+			 *
+			 * It is released with the last handle using it.
+			 */
+			static Ptr get(const std::string &url);
+
+			~CurlShare();
+
+			/**
+			 * Let an easy handle use the caches of the host
+			 */
+			void attach(CURL *curl);
+
+			const std::string &host() const { return _host; }
+
+			/* number of hosts with a share */
+			static size_t hosts();
+
+		private:
+			CurlShare(const std::string &host);
+			CurlShare(const CurlShare &);
+			CurlShare &operator=(const CurlShare &);
+
+			static void lock(CURL *curl, curl_lock_data data, curl_lock_access access, void *arg);
+			static void unlock(CURL *curl, curl_lock_data data, void *arg);
+
+			CURLSH *_share;
+			std::string _host;
+			pthread_mutex_t _locks[CURL_LOCK_DATA_LAST]; /**< one per shared cache */
+
+			static pthread_mutex_t _mutex;
+			static std::map<std::string, vz::weak_ptr<CurlShare> > _shares;
+		}; // class CurlShare
+
+	} // namespace api
+} // namespace vz
+#endif /* _CurlShare_hpp_ */
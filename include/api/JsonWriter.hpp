@@ -0,0 +1,109 @@
+/**
+ * Streaming JSON serializer for request bodies
+ *
+ * Writes the JSON text directly into a buffer which grows as needed and is
+ * kept between two requests. Uploading a backlog of tuples therefore needs
+ * neither an object per value nor a formatted copy of the whole tree.
+ *
+ * @package vzlogger
+ * @license http://opensource.org/licenses/gpl-license.php GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _JsonWriter_hpp_
+#define _JsonWriter_hpp_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define JSON_WRITER_CAPACITY 4096	/* initial size of the buffer */
+#define JSON_NUMBER_LEN 32			/* max. length of a formatted number */
+
+namespace vz {
+	namespace api {
+
+		/**
+		 * Compact JSON without whitespace, values are separated automatically
+		 */
+		class JsonWriter {
+		public:
+			JsonWriter(size_t capacity = JSON_WRITER_CAPACITY);
+			~JsonWriter();
+
+			/**
+			 * Start a new document, the buffer is kept
+			 */
+			void clear();
+
+			void open_array();
+			void close_array();
+			void open_object();
+			void close_object();
+
+			/**
+			 * Name of the next value of an object
+			 */
+			void key(const char *name);
+
+			void string(const char *value);
+			void integer(int64_t value);
+
+			/**
+			 * Shortest decimal which reads back as the same double
+			 *
+			 * NaN and infinity have no JSON representation and are written as null.
+			 */
+			void number(double value);
+
+			/**
+			 * [<timestamp>,<value>] as expected by the middleware
+			 */
+			void tuple(int64_t timestamp, double value);
+
+			const char *c_str() const { return _data; }
+			size_t size() const { return _size; }
+			bool empty() const { return _size == 0; }
+
+			/**
+			 * Format a double like number(), without separator
+			 *
+			 * @param out at least JSON_NUMBER_LEN bytes
+			 * @return length of the text, not terminated
+			 */
+			static size_t format(char *out, double value);
+
+		private:
+			JsonWriter(const JsonWriter &);
+			JsonWriter &operator=(const JsonWriter &);
+
+			void reserve(size_t n);
+			void separator();
+			void append(char c) { _data[_size++] = c; }
+			void terminate() { _data[_size] = '\0'; }
+
+			static size_t format(char *out, bool negative, uint64_t digits, int decimals);
+
+			char *_data;
+			size_t _size;
+			size_t _capacity;
+			bool _comma;		/**< a value precedes, the next one needs a separator */
+		}; // class JsonWriter
+
+	} // namespace api
+} // namespace vz
+#endif /* _JsonWriter_hpp_ */
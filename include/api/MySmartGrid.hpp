@@ -38,6 +38,7 @@
 #include <api/CurlIF.hpp>
 #include <api/CurlResponse.hpp>
 #include <Reading.hpp>
+#include <api/JsonWriter.hpp>
 
 namespace vz {
 	namespace api {
@@ -51,7 +52,7 @@ namespace vz {
 			MySmartGrid(Channel::Ptr ch, std::list<Option> options);
 			~MySmartGrid();
 	
-			void send();
+			bool send();
 
 			void register_device();
 			
@@ -68,18 +69,20 @@ namespace vz {
 			/**
 			 *  api configured as device
 			 */
-			json_object *_apiDevice(Buffer::Ptr buf);
+			json_object *_apiDevice();
 	
 			/**
 			 *  api configured as sensor
+			 *
+			 *  @return false if there is nothing to send, else the body is in _body
 			 */
-			json_object *_apiSensor(Buffer::Ptr buf);
+			bool _apiSensor();
 
 			json_object * _json_object_registration();
 			json_object * _json_object_heartbeat();
 			json_object * _json_object_event(Buffer::Ptr buf);
 			json_object * _json_object_sensor(const std::string &sensorName);
-			json_object * _json_object_measurements(Buffer::Ptr buf);
+			bool _json_measurements(JsonWriter &json);
 
 			void _api_header();
 
@@ -107,8 +110,8 @@ namespace vz {
 			CurlIF _curlIF;
 			CurlResponse::Ptr _response;
 	
-			// Volatil
-			std::list<Reading> _values;
+			size_t _cursor;	/**< number of queued readings covered by the last request */
+			JsonWriter _body;	/**< measurements of the last request, the buffer is reused */
 
 			time_t _first_ts;
 			long _first_counter;
@@ -44,7 +44,7 @@ namespace vz {
 			Null(Channel::Ptr ch, std::list<Option> options);
 			~Null();
 
-			void send();
+			bool send();
 
 			void register_device();
 
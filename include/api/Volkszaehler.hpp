@@ -34,11 +34,15 @@
 #define _Volkszaehler_hpp_
 
 #include <stdint.h>
+#include <vector>
 #include <curl/curl.h>
 #include <json/json.h>
 
 #include <ApiIF.hpp>
 #include <Options.hpp>
+#include <api/CurlShare.hpp>
+#include <api/Batch.hpp>
+#include <api/JsonWriter.hpp>
 #include "Buffer.hpp"
 
 namespace vz {
@@ -61,7 +65,12 @@ namespace vz {
 			Volkszaehler(Channel::Ptr ch, std::list<Option> options);
 			~Volkszaehler();
 
-			void send();
+			bool send();
+
+			/* send() split for the curl multi interface of the uploader */
+			bool asynchronous() const { return true; }
+			CURL *prepare();
+			void complete(CURLcode code);
 
 			void register_device();
 
@@ -72,14 +81,36 @@ namespace vz {
 
 			CURL *curl() { return _api.curl; }
 			/**
-			 * Create JSON object of tuples
+			 * Write JSON array of tuples
+			 *
+			 * Pending readings of the channel are read in place and only
+			 * acknowledged after a successful request, see _cursor.
+			 *
+			 * @param max limit of tuples, the cursor stops before the first one left out
+			 * @param entry wrap the tuples into the object of the channel in a batch
+			 * @return number of tuples, nothing is written if there are none
+			 */
+			size_t api_json_tuples(JsonWriter &json, size_t max = (size_t)-1, bool entry = false);
+
+			/**
+			 * Write JSON array of the tuples of all channels of the batch
 			 *
-			 * @param buf	the buffer our readings are stored in (required for mutex)
-			 * @param first	the first tuple of our linked list which should be encoded
-			 * @param last	the last tuple of our linked list which should be encoded
-			 * @return the json_object (has to be free'd)
+			 * Sets the cursors of the members within the limits of the batch.
+			 * Called with the lock of the batch held.
+			 *
+			 * @return number of tuples, nothing is written if there are none
 			 */
-			json_object * api_json_tuples(Buffer::Ptr buf);
+			size_t api_json_batch(JsonWriter &json);
+
+			/**
+			 * Release the readings covered by the last request of all members
+			 */
+			void acknowledge();
+
+			/**
+			 * Free request body and response of the last request
+			 */
+			void release();
 
       /**
        * Parses JSON encoded exception and stores describtion in err
@@ -89,12 +120,23 @@ namespace vz {
 
 
 		private:
+			CurlShare::Ptr _share; /**< caches and connections of the middleware host */
 			api_handle_t _api;
+			std::string _url;	/**< endpoint of the channel */
+
+			Batch::Ptr _batch;	/**< NULL unless uploading with other channels */
+			friend class Batch;	/**< hands the cursor of a leaving member to the sender */
+			bool _batched;		/**< the request in flight carries the batch, see Batch::sent() */
+			bool _leading;		/**< we hold the request of the batch */
+			bool _single;		/**< next request to our endpoint, the batch was rejected */
 
-          // Volatil
-			std::list<Reading> _values;
+			size_t _cursor;	/**< number of queued readings covered by the last request */
+			uint64_t _cursor_timestamp; /**< newest timestamp covered by the last request */
           uint64_t _last_timestamp; /**< remember last timestamp */
 
+			JsonWriter _body;	/**< of the request in flight, the buffer is reused */
+			CURLresponse _response;
+
 		}; //class Volkszaehler
 
     /**
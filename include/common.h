@@ -39,7 +39,27 @@ typedef enum {
 #define ERR_NOT_FOUND -2
 #define ERR_INVALID_TYPE -3
 
+/* highest log level compiled in, set by -DLOG_MAX_LEVEL=... */
+#ifndef LOG_MAX_LEVEL
+#define LOG_MAX_LEVEL 15
+#endif
+
 /* prototypes */
 void print(log_level_t lvl, const char *format, const char *id, ... );
+bool print_enabled(log_level_t lvl);
+
+/**
+ * Would a message of this level be written?
+ * Constant false for levels above LOG_MAX_LEVEL, so the compiler drops the code.
+ */
+#define LOG_ENABLED(lvl) ((lvl) <= LOG_MAX_LEVEL && print_enabled(lvl))
+
+/**
+ * Like print(), but the arguments are only evaluated if the message is
+ * written. Use it for messages in hot paths and for debug output.
+ */
+#define PRINT(lvl, ...) do { \
+	if (LOG_ENABLED(lvl)) print((lvl), __VA_ARGS__); \
+} while (0)
 
 #endif /* _COMMON_H_ */
@@ -43,6 +43,8 @@ public:
 	int open();
 	int close();
 	ssize_t read(std::vector<Reading> &rds, size_t n);
+	size_t feed(const uint8_t *data, size_t len, vz::protocol::ReadingSink &sink);
+	int fd() const { return _pull.empty() ? _fd : -1; }	/* pulled meters have to be asked */
 
 	const char *host() const { return _host.c_str(); }
 	const char *device() const { return _device.c_str(); }
@@ -62,6 +64,26 @@ private:
 	int _fd; /* file descriptor of port */
 	struct termios _oldtio; /* required to reset port */
 
+	/* state of the push parser, kept between calls of feed() */
+	enum context_t { START, VENDOR, BAUDRATE, IDENTIFICATION, ACK, START_LINE, OBIS_CODE, VALUE, UNIT, END_LINE, END };
+	struct {
+		context_t context;
+		char vendor[3+1];			/* 3 upper case vendor + '\0' termination */
+		char identification[16+1];	/* 16 meter specific + '\0' termination */
+		char obis_code[16+1];		/* A-B:C.D.E*F, see feed() */
+		char value[32+1];			/* value, i.e. the actual reading */
+		char unit[16+1];			/* the unit of the value, e.g. kWh, V, ... */
+		char baudrate;
+		char endseq[2+1];			/* end sequence ! or ?! */
+		char lastbyte;
+		int byte_iterator;
+		int skipped;				/* bytes skipped while waiting for sync */
+		size_t number_of_tuples;	/* readings of the current telegram */
+	} _parser;
+
+	void _reset_parser();
+	void _add_reading(vz::protocol::ReadingSink &sink);
+
 	/**
 	 * Open socket
 	 *
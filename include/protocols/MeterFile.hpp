@@ -28,6 +28,8 @@
 
 #include <protocols/Protocol.hpp>
 
+#define FILE_LINE_LEN 256	/* max. length of a line including '\0' */
+
 class MeterFile : public vz::protocol::Protocol {
 
 public:
@@ -37,6 +39,7 @@ public:
 	int open();
 	int close();
 	ssize_t read(std::vector<Reading> &rds, size_t n);
+	size_t feed(const uint8_t *data, size_t len, vz::protocol::ReadingSink &sink);
 
 	const char *path() { return _path.c_str(); }
 	const char *format() { return _format.c_str(); }
@@ -45,8 +48,13 @@ public:
 	std::string _path;
 	std::string _format;
 	int _rewind;
+	reading_id_t _id_empty;	/* interned StringIdentifier("") */
 
 	FILE *_fd;
+	char _line[FILE_LINE_LEN];	/* incomplete line of the push parser */
+	size_t _line_len;
+
+	bool _parse_line(char *line, Reading &rd);
 };
 
 #endif /* _FILE_H_ */
@@ -28,6 +28,8 @@
 
 #include <protocols/Protocol.hpp>
 
+#define FLUKSOV2_LINE_LEN 64
+
 class MeterFluksoV2 : public vz::protocol::Protocol {
 
 public:
@@ -37,14 +39,19 @@ public:
 	int open();
 	int close();
 	ssize_t read(std::vector<Reading> &rds, size_t n);
+	size_t feed(const uint8_t *data, size_t len, vz::protocol::ReadingSink &sink);
+	int fd() const { return _fd; }
 
   private:
-	ssize_t _read_line(int fd, char  *buffer, size_t n);
+	void _parse_line(char *line, vz::protocol::ReadingSink &sink);
   
   private:
 	const char *_fifo;
 	int _fd;	/* file descriptor of fifo */
 
+	char _line[FLUKSOV2_LINE_LEN+1];	/* line of the push parser, kept between calls of feed() */
+	size_t _line_len;
+
 	//const char *DEFAULT_FIFO = "/var/run/spid/delta/out";
 	// const char *_DEFAULT_FIFO;
 };
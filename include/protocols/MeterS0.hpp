@@ -49,6 +49,9 @@ public:
 	int _resolution;
 	int _counter;
 
+	reading_id_t _id_power;		/* interned identifiers */
+	reading_id_t _id_impulse;
+
 	int _fd;	/* file descriptor of port */
 	struct termios _old_tio;	/* required to reset port */
 };
@@ -50,6 +50,8 @@ public:
 	int open();
 	int close();
 	ssize_t read(std::vector<Reading> &rds, size_t n);
+	size_t feed(const uint8_t *data, size_t len, vz::protocol::ReadingSink &sink);
+	int fd() const { return _pull.empty() ? _fd : -1; }	/* pulled meters have to be asked */
 
 	const char *host() const { return _host.c_str(); }
 	const char *device() const { return _device.c_str(); }
@@ -66,6 +68,11 @@ protected:
 
 	const int BUFFER_LEN;
 
+	/* transport frame of the push parser, kept between calls of feed() */
+	std::vector<unsigned char> _frame;
+	size_t _frame_len;
+	bool _escaped;			/* last word was an escape sequence */
+
 	/**
 	 * Parses SML list entry and stores it in reading pointed by rd
 	 *
@@ -75,6 +82,13 @@ protected:
 	 */
 	bool _parse(sml_list *list, Reading *rd);
 
+	/**
+	 * Parses a complete transport frame including escape sequences
+	 *
+	 * @return number of readings passed to the sink
+	 */
+	size_t _parse_frame(unsigned char *buffer, size_t len, vz::protocol::ReadingSink &sink);
+
 	/**
 	 * Open serial port by device
 	 *
@@ -28,6 +28,7 @@
 #ifndef _protocol_hpp_
 #define _protocol_hpp_
 
+#include <stdint.h>
 #include <vector>
 #include <list>
 
@@ -35,9 +36,44 @@
 #include <shared_ptr.hpp>
 #include <Reading.hpp>
 #include <Options.hpp>
+#include <VZException.hpp>
 
 namespace vz {
 	namespace protocol {
+		/**
+		 * Receives the readings of a push parser
+		 */
+		class ReadingSink {
+		public:
+			virtual ~ReadingSink() {};
+
+			/**
+			 * @return false if the reading was dropped, e.g. because the sink is full
+			 */
+			virtual bool push(const Reading &rd) = 0;
+		};
+
+		/**
+		 * Sink filling the first n readings of a vector, as read() does
+		 */
+		class VectorSink : public ReadingSink {
+		public:
+			VectorSink(std::vector<Reading> &rds, size_t n) : _rds(rds), _max(n < rds.size() ? n : rds.size()), _size(0) {};
+
+			bool push(const Reading &rd) {
+				if (_size >= _max) return false;
+				_rds[_size++] = rd;
+				return true;
+			}
+
+			size_t size() const { return _size; }
+
+		private:
+			std::vector<Reading> &_rds;
+			size_t _max;
+			size_t _size;
+		};
+
 		class Protocol {
 		public:
 			typedef vz::shared_ptr<Protocol> Ptr;
@@ -50,6 +86,27 @@ namespace vz {
 			virtual int    close() = 0;
 			virtual ssize_t read(std::vector<Reading> &rds, size_t n) = 0;
 
+			/**
+			 * Push parser: parse the next chunk of raw meter data
+			 *
+			 * The parser state is kept between calls, so data can be passed in
+			 * chunks of any size, e.g. as it arrives from an event loop or from
+			 * a recording. Readings are passed to the sink as soon as they are complete.
+			 *
+			 * @return number of messages (telegrams, lines, ...) finished within this chunk
+			 */
+			virtual size_t feed(const uint8_t *data, size_t len, ReadingSink &sink) {
+				throw vz::VZException("Protocol " + _name + " has no push parser.");
+			}
+
+			/**
+			 * Descriptor which becomes readable when the meter sends data by itself
+			 *
+			 * Used by the reactor to call read() only when there is something to read.
+			 * @return -1 if the meter has to be polled or triggered
+			 */
+			virtual int fd() const { return -1; }
+
 			const std::string &name() { return _name; }
     
 		private:
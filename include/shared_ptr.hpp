@@ -37,6 +37,7 @@
 
 namespace vz {
 	using ::std::tr1::shared_ptr;
+	using ::std::tr1::weak_ptr;
 	using ::std::tr1::enable_shared_from_this;
 }
 
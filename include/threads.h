@@ -26,9 +26,17 @@
 #ifndef _THREADS_H_
 #define _THREADS_H_
 
-void logging_thread_cleanup(void *arg);
+#include <vector>
+
+#include <Reading.hpp>
+
+class MeterMap;
 
-void * logging_thread(void *arg);
 void * reading_thread(void *arg);
 
+/* steps of the reading thread, also used by the reactor */
+size_t read_meter(MeterMap *mapping, std::vector<Reading> &rds, int64_t tick = -1);
+void route_readings(MeterMap *mapping, std::vector<Reading> &rds, size_t n);
+void publish_channels(MeterMap *mapping);
+
 #endif /* _THREADS_H_ */
@@ -37,6 +37,7 @@ using namespace std;
 
 /* prototypes */
 void quit(int sig);
+void reload();
 void daemonize();
 
 void show_usage(char ** argv);
@@ -1,5 +1,5 @@
 /**
- * Circular buffer (double linked)
+ * Circular buffer (bounded, contiguous)
  *
  * Used to store recent readings and buffer in case of net inconnectivity
  *
@@ -28,14 +28,33 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#include "float.h" /* double min max */
+#include <algorithm>
 #include "common.h"
 
 #include "Buffer.hpp"
 
-Buffer::Buffer() :
-		_keep(32)
+size_t Buffer::_budget = 0;
+volatile size_t Buffer::_reserved = 0;
+
+Buffer::Buffer(size_t capacity) :
+		_head(0)
+		, _size(0)
+		, _capacity(capacity > 0 ? capacity : 1)
+		, _overflow(DROP_OLDEST)
+		, _dropped(0)
+		, _downsampled(0)
+		, _agg_count(0)
+		, _agg_sum(0)
+		, _agg_max(0)
+		, _agg_min(0)
+		, _agg_area(0)
+		, _agg_span(0)
+		, _agg_ref(0)
+		, _agg_have_prev(false)
+		, _keep(32)
 {
+	_ring.resize(std::min(_capacity, (size_t)BUFFER_INITIAL_SLOTS));
+	reserve(_ring.size() * sizeof(Reading), true);
 	_newValues=false;
 	pthread_mutex_init(&_mutex, NULL);
 	_aggmode=NONE;
@@ -43,142 +62,270 @@ Buffer::Buffer() :
 
 void Buffer::push(const Reading &rd) {
 	lock();
-	_sent.push_back(rd);
+	if (_aggmode != NONE) {
+		accumulate(rd);
+	} else {
+		append(rd);
+	}
 	unlock();
 }
 
-void Buffer::aggregate(int aggtime, bool aggFixedInterval) {
-	if (_aggmode == NONE) return;
+/**
+ * Fold reading into the accumulators of the current window
+ * Caller has to hold the lock.
+ */
+void Buffer::accumulate(const Reading &rd) {
+	double value = rd.value();
 
-	lock();
-	if (_aggmode == MAX) {
-		Reading *latest=NULL;
-		double aggvalue=DBL_MIN;
-		for (iterator it = _sent.begin(); it!= _sent.end(); it++) {
-			if (! it->deleted()) {
-				if (!latest) {
-					latest=&*it;
-				} else {
-					if (it->tvtod() > latest->tvtod()) {
-						latest=&*it;
-					}
-				}
-				aggvalue=std::max(aggvalue,it->value());
-				print(log_debug, "%f @ %f", "MAX",it->value(),it->tvtod());
-			}
-		}
-		for (iterator it = _sent.begin(); it!= _sent.end(); it++) {
-			if (! it->deleted()) {
-				if (&*it==latest) {
-					it->value(aggvalue);
-					print(log_debug, "RESULT %f @ %f", "MAX",it->value(),it->tvtod());
-				} else {
-					it->mark_delete();
-				}
-			}
+	if (_agg_count == 0) {
+		_agg_sum = 0;
+		_agg_area = 0;
+		_agg_span = 0;
+		_agg_max = value;
+		_agg_min = value;
+		_agg_ref = _agg_have_prev ? _agg_prev.value() : value;
+		_agg_latest = rd;
+	} else {
+		_agg_max = std::max(_agg_max, value);
+		_agg_min = std::min(_agg_min, value);
+		if (rd.time_us() > _agg_latest.time_us()) {
+			_agg_latest = rd;
 		}
-	} else if (_aggmode == AVG) {
-		Reading *latest=NULL;
-		double aggvalue=0;
-		int aggcount=0;
-		for (iterator it = _sent.begin(); it!= _sent.end(); it++) {
-			if (! it->deleted()) {
-				if (!latest) {
-					latest=&*it;
-				} else {
-					if (it->tvtod() > latest->tvtod()) {
-						latest=&*it;
-					}
-				}
-				aggvalue=aggvalue+it->value();
-				print(log_debug, "[%d] %f @ %f", "AVG",aggcount,it->value(),it->tvtod());
-
-				aggcount++;
-			}
-		}
-		for (iterator it = _sent.begin(); it!= _sent.end(); it++) {
-			if (! it->deleted()) {
-				if (&*it==latest) {
-					it->value(aggvalue/aggcount);
-					print(log_debug, "[%d] RESULT %f @ %f", "AVG",aggcount,it->value(),it->tvtod());
-				} else {
-					it->mark_delete();
-				}
-			}
+	}
+	_agg_sum += value;
+	_agg_count++;
+
+	/* trapezoid between previous and this reading, also across windows */
+	if (_agg_have_prev) {
+		int64_t dt = rd.time_us() - _agg_prev.time_us();
+		if (dt <= 0) {
+			return; /* out of order, ignore for time based modes */
 		}
-	} else if (_aggmode == SUM) {
-		Reading *latest=NULL;
-		double aggvalue=0;
-		for (iterator it = _sent.begin(); it!= _sent.end(); it++) {
-			if (! it->deleted()) {
-				if (!latest) {
-					latest=&*it;
-				} else {
-					if (it->tvtod() > latest->tvtod()) {
-						latest=&*it;
-					}
-				}
-				aggvalue=aggvalue+it->value();
-				print(log_debug, "%f @ %f", "SUM",it->value(),it->tvtod());
+		_agg_area += (double)dt * (_agg_prev.value() + value) / 2;
+		_agg_span += dt;
+	}
+	_agg_prev = rd;
+	_agg_have_prev = true;
+}
+
+/**
+ * Store reading in the ring
+ * Caller has to hold the lock.
+ */
+void Buffer::append(const Reading &rd) {
+	if (_size == _ring.size() && _ring.size() < _capacity) {
+		relocate(std::min(_capacity, 2 * _ring.size()));
+	}
+
+	/* full, either at capacity or the global budget did not allow to grow */
+	if (_size == _ring.size()) {
+		if (_overflow == DOWNSAMPLE && _size > 1) {
+			downsample();
+		} else {
+			_dropped++;
+			if ((_dropped & (_dropped - 1)) == 0) { /* log 1st, 2nd, 4th, 8th, ... drop only */
+				print(log_warning, "Buffer full (size=%lu), %lu readings dropped so far", NULL,
+							(unsigned long)_size, _dropped);
 			}
-		}
-		for (iterator it = _sent.begin(); it!= _sent.end(); it++) {
-			if (! it->deleted()) {
-				if (&*it==latest) {
-					it->value(aggvalue);
-					print(log_debug, "RESULT %f @ %f", "SUM",it->value(),it->tvtod());
-				} else {
-					it->mark_delete();
-				}
+
+			if (_overflow == DROP_NEWEST) {
+				return;
 			}
+			drop_front(1);
 		}
 	}
-	/* fix timestamp if aggFixedInterval set */
-	if ((aggFixedInterval==true) && (aggtime>0)) {
-		struct timeval tv;
-		for (iterator it = _sent.begin(); it!= _sent.end(); it++) {
-			if (! it->deleted()) {
-				tv.tv_usec = 0;
-				tv.tv_sec = aggtime * (long int)(it->tvtod() / aggtime);
-				it->time(tv);
-			}
-		}
+
+	_ring[(_head + _size) % _ring.size()] = rd;
+	_size++;
+}
+
+void Buffer::capacity(const size_t capacity) {
+	lock();
+	_capacity = (capacity > 0) ? capacity : 1;
+	if (_size > _capacity) {
+		_dropped += _size - _capacity;
+		drop_front(_size - _capacity);
+	}
+	if (_ring.size() > _capacity) {
+		relocate(_capacity);
 	}
 	unlock();
-	clean();
-	return;
 }
 
+/**
+ * Move readings to a new ring with the given number of slots
+ * Oldest reading ends up in the first slot. Caller has to hold the lock.
+ *
+ * @return false if growing is not allowed by the global budget
+ */
+bool Buffer::relocate(size_t slots) {
+	size_t old_slots = _ring.size();
 
-void Buffer::clean() {
-	lock();
-	for (iterator it = _sent.begin(); it!= _sent.end(); it++) {
-		if (it->deleted()) {
-			it = _sent.erase(it);
-			it--;
+	if (slots > old_slots && !reserve((slots - old_slots) * sizeof(Reading))) {
+		return false;
+	}
+
+	std::vector<Reading> ring(slots);
+
+	for (size_t i = 0; i < _size; i++) {
+		ring[i] = at(i);
+	}
+	_ring.swap(ring);
+	_head = 0;
+
+	if (slots < old_slots) {
+		release((old_slots - slots) * sizeof(Reading));
+	}
+	return true;
+}
+
+/**
+ * Merge pairs of readings of the older half in place
+ *
+ * Frees a quarter of the ring. The merged pairs are written towards the
+ * newer half and the head is advanced, the newer half is not moved.
+ * Caller has to hold the lock.
+ */
+void Buffer::downsample() {
+	size_t pairs = std::max((size_t)1, _size / 4);
+
+	for (size_t i = pairs; i-- > 0; ) {
+		at(pairs + i) = merge(at(2 * i), at(2 * i + 1));
+	}
+	_head = (_head + pairs) % _ring.size();
+	_size -= pairs;
+
+	_downsampled += pairs;
+	PRINT(log_debug, "Buffer full (size=%lu), downsampled %lu readings so far", NULL,
+				(unsigned long)(_size + pairs), _downsampled);
+}
+
+/**
+ * Combine two stored readings to one covering both
+ *
+ * Values of additive modes are summed up, others are averaged.
+ */
+Reading Buffer::merge(const Reading &older, const Reading &newer) const {
+	Reading rd(newer);
+
+	switch (_aggmode) {
+			case SUM:
+			case DELTA:
+			case INTEGRAL: rd.value(older.value() + newer.value()); break;
+			case MAX: rd.value(std::max(older.value(), newer.value())); break;
+			case MIN: rd.value(std::min(older.value(), newer.value())); break;
+			case LAST: break;
+			default: rd.value((older.value() + newer.value()) / 2); break;
+	}
+	return rd;
+}
+
+bool Buffer::reserve(size_t bytes, bool force) {
+	size_t reserved;
+
+	do {
+		reserved = _reserved;
+		if (!force && _budget > 0 && reserved + bytes > _budget) {
+			return false;
 		}
+	} while (!__sync_bool_compare_and_swap(&_reserved, reserved, reserved + bytes));
 
+	return true;
+}
+
+void Buffer::release(size_t bytes) {
+	__sync_fetch_and_sub(&_reserved, bytes);
+}
+
+/**
+ * Remove the n oldest readings. Caller has to hold the lock.
+ */
+void Buffer::drop_front(size_t n) {
+	if (n > _size) n = _size;
+
+	_head = (_head + n) % _ring.size();
+	_size -= n;
+
+	/* give back slots after a backlog has been consumed */
+	if (_ring.size() > BUFFER_INITIAL_SLOTS && _size < _ring.size() / 4) {
+		relocate(std::max((size_t)BUFFER_INITIAL_SLOTS, _ring.size() / 2));
 	}
-//_sent.clear();
-	unlock();
 }
 
-void Buffer::undelete() {
+/**
+ * Close the current aggregation window
+ *
+ * Stores one reading with the aggregated value and the timestamp of the
+ * latest reading of the window. Constant time, the readings of the window
+ * have already been folded into the accumulators by push().
+ */
+void Buffer::aggregate(int aggtime, bool aggFixedInterval) {
 	lock();
-	for (iterator it = _sent.begin(); it!= _sent.end(); it++) {
-		it->reset();
+	if (_aggmode == NONE) {
+		/* fix timestamp if aggFixedInterval set */
+		if ((aggFixedInterval==true) && (aggtime>0)) {
+			for (iterator it = begin(); it!= end(); it++) {
+				it->time_us(fixed_interval(*it, aggtime));
+			}
+		}
+		unlock();
+		return;
+	}
+
+	if (_agg_count > 0) {
+		Reading rd(_agg_latest);
+
+		switch (_aggmode) {
+				case MAX: rd.value(_agg_max); break;
+				case AVG: rd.value(_agg_sum / _agg_count); break;
+				case SUM: rd.value(_agg_sum); break;
+				case MIN: rd.value(_agg_min); break;
+				case LAST: break; /* value of latest reading */
+				case TWAVG: rd.value((_agg_span > 0) ? _agg_area / _agg_span : _agg_latest.value()); break;
+				case DELTA: rd.value(_agg_latest.value() - _agg_ref); break;
+				case INTEGRAL: rd.value(_agg_area / 3600e6); break;
+				default: break;
+		}
+
+		/* fix timestamp if aggFixedInterval set */
+		if ((aggFixedInterval==true) && (aggtime>0)) {
+			rd.time_us(fixed_interval(rd, aggtime));
+		}
+
+		PRINT(log_debug, "[%lu] RESULT %f @ %f", "AGG", (unsigned long)_agg_count, rd.value(), rd.tvtod());
+		append(rd);
+		_agg_count = 0;
 	}
 	unlock();
 }
 
+/**
+ * Timestamp rounded down to a multiple of aggtime seconds
+ */
+int64_t Buffer::fixed_interval(const Reading &rd, int aggtime) const {
+	int64_t step = (int64_t)aggtime * 1000000;
+	return rd.time_us() / step * step;
+}
 
-void Buffer::shrink(/*size_t keep*/) {
+/**
+ * Release the n oldest readings after they have been consumed
+ */
+void Buffer::acknowledge(size_t n) {
 	lock();
+	drop_front(n);
+	unlock();
+}
 
-//	while(size > keep && begin() != sent) {
-//		pop();
-//	}
 
+/**
+ * Drop oldest readings until not more than _keep are left
+ * Used when readings are only served by the local interface.
+ */
+void Buffer::shrink() {
+	lock();
+	if (_size > _keep) {
+		drop_front(_size - _keep);
+	}
 	unlock();
 }
 
@@ -187,18 +334,18 @@ char * Buffer::dump(char *dump, size_t len) {
 	dump[pos++] = '{';
 
 	lock();
-	for (iterator it = _sent.begin(); it!= _sent.end(); it++) {
+	for (iterator it = begin(); it!= end(); it++) {
 		if (pos < len) {
 			pos += snprintf(dump+pos, len-pos, "%.4f", it->value());
 		}
 
 		/* indicate last sent reading */
-		if (pos < len && _sent.end() == it) {
+		if (pos < len && end() == it) {
 			dump[pos++] = '!';
 		}
 
 		/* add seperator between values */
-		if (pos < len && it != _sent.end()) {
+		if (pos < len && it != end()) {
 			dump[pos++] = ',';
 		}
 	}
@@ -213,6 +360,7 @@ char * Buffer::dump(char *dump, size_t len) {
 }
 
 Buffer::~Buffer() {
+	release(_ring.size() * sizeof(Reading));
 	pthread_mutex_destroy(&_mutex);
 }
 
@@ -33,18 +33,41 @@
 #include "common.h"
 
 #include "Channel.hpp"
+#include "Uploader.hpp"
 
 int Channel::instances = 0;
 
+/**
+ * Numeric option, integers are accepted as well
+ */
+static double lookup_number(OptionList &optlist, const std::list<Option> &options, const char *key) {
+	try {
+		return optlist.lookup_double(options, key);
+	} catch (vz::InvalidTypeException &e) {
+		return optlist.lookup_int(options, key);
+	}
+}
+
+/**
+ * Largest power of two not above n, SpscQueue would round up
+ */
+static size_t queue_slots(size_t n) {
+	size_t slots = CHANNEL_MIN_QUEUE;
+	while (2 * slots <= n) slots <<= 1;
+	return slots;
+}
+
 Channel::Channel(
 	const std::list<Option> &pOptions,
 	const std::string apiProtocol,
 	const std::string uuid,
 	ReadingIdentifier::Ptr pIdentifier
 	)
-		: _thread_running(false)
-		, _options(pOptions)
+		: _options(pOptions)
 		, _buffer(new Buffer())
+		, _uploader(NULL)
+		, _job(0)
+		, _backpressure(0)
 		, _identifier(pIdentifier)
 		, _last(0)
 		, _uuid(uuid)
@@ -68,6 +91,16 @@ Channel::Channel(
 			_buffer->set_aggmode(Buffer::AVG);
 		} else if (strcasecmp(aggmode_str, "sum") == 0 ) {
 			_buffer->set_aggmode(Buffer::SUM);
+		} else if (strcasecmp(aggmode_str, "min") == 0 ) {
+			_buffer->set_aggmode(Buffer::MIN);
+		} else if (strcasecmp(aggmode_str, "last") == 0 ) {
+			_buffer->set_aggmode(Buffer::LAST);
+		} else if (strcasecmp(aggmode_str, "twavg") == 0 ) {
+			_buffer->set_aggmode(Buffer::TWAVG);
+		} else if (strcasecmp(aggmode_str, "delta") == 0 ) {
+			_buffer->set_aggmode(Buffer::DELTA);
+		} else if (strcasecmp(aggmode_str, "integral") == 0 ) {
+			_buffer->set_aggmode(Buffer::INTEGRAL);
 		} else if (strcasecmp(aggmode_str, "none") == 0 ) {
 			_buffer->set_aggmode(Buffer::NONE);
 		} else {
@@ -83,15 +116,255 @@ Channel::Channel(
 		throw;
 	}
 
+	try {
+		/* max. number of buffered readings */
+		int capacity = optlist.lookup_int(pOptions, "capacity");
+		if (capacity < 1) {
+			throw vz::VZException("Capacity has to be positive.");
+		}
+		_buffer->capacity(capacity);
+	} catch (vz::OptionNotFoundException &e) {
+		/* using default value if not specified */
+	} catch (vz::VZException &e) {
+		print(log_error, "Invalid capacity (%s)", name(), e.what());
+		throw;
+	}
+
+	try {
+		/* what to discard if buffer is full */
+		const char *overflow_str = optlist.lookup_string(pOptions, "overflow");
+		if (strcasecmp(overflow_str, "drop_oldest") == 0 ) {
+			_buffer->overflow_policy(Buffer::DROP_OLDEST);
+		} else if (strcasecmp(overflow_str, "drop_newest") == 0 ) {
+			_buffer->overflow_policy(Buffer::DROP_NEWEST);
+		} else if (strcasecmp(overflow_str, "downsample") == 0 ) {
+			_buffer->overflow_policy(Buffer::DOWNSAMPLE);
+		} else {
+			throw vz::VZException("Overflow policy unknown.");
+		}
+	} catch (vz::OptionNotFoundException &e) {
+		/* using default value if not specified */
+		_buffer->overflow_policy(Buffer::DROP_OLDEST);
+	} catch (vz::VZException &e) {
+		print(log_error, "Invalid overflow policy (%s)", name(), e.what());
+		throw;
+	}
+
+	size_t slots = 0; /* of the logging queue */
+	try {
+		/* memory budget in bytes, overrides capacity */
+		int memory = optlist.lookup_int(pOptions, "memory");
+		if (memory < (int)(2 * CHANNEL_MIN_QUEUE * sizeof(Reading))) {
+			throw vz::VZException("Memory budget too small.");
+		}
+		/* a quarter for the logging queue, the rest for the buffer */
+		slots = queue_slots(memory / 4 / sizeof(Reading));
+		_buffer->capacity(memory / sizeof(Reading) - slots);
+	} catch (vz::OptionNotFoundException &e) {
+		/* using capacity */
+	} catch (vz::VZException &e) {
+		print(log_error, "Invalid memory budget (%s)", name(), e.what());
+		throw;
+	}
+
+	try {
+		/* hold the meter if the logging thread falls behind */
+		_backpressure = optlist.lookup_int(pOptions, "backpressure");
+		if (_backpressure < 0) {
+			throw vz::VZException("Backpressure has to be positive.");
+		}
+	} catch (vz::OptionNotFoundException &e) {
+		/* using default value if not specified */
+		_backpressure = 0;
+	} catch (vz::VZException &e) {
+		print(log_error, "Invalid backpressure (%s)", name(), e.what());
+		throw;
+	}
 
+	try {
+		/* forward only changes beyond the dead-band */
+		double absolute = 0, relative = 0;
+		bool found = false;
+		try {
+			absolute = lookup_number(optlist, pOptions, "deadband");
+			found = true;
+		} catch (vz::OptionNotFoundException &e) {
+		}
+		try {
+			relative = lookup_number(optlist, pOptions, "deadband_relative");
+			found = true;
+		} catch (vz::OptionNotFoundException &e) {
+		}
+		if (found) {
+			_filter.deadband(absolute, relative);
+		}
+	} catch (vz::VZException &e) {
+		print(log_error, "Invalid deadband (%s)", name(), e.what());
+		throw;
+	}
+
+	try {
+		/* forward only readings needed to reconstruct the curve within the given error */
+		_filter.compression(lookup_number(optlist, pOptions, "compression"));
+	} catch (vz::OptionNotFoundException &e) {
+		/* no compression */
+	} catch (vz::VZException &e) {
+		print(log_error, "Invalid compression (%s)", name(), e.what());
+		throw;
+	}
+
+	try {
+		/* forward a reading at least every heartbeat seconds */
+		int heartbeat = optlist.lookup_int(pOptions, "heartbeat");
+		if (heartbeat < 1) {
+			throw vz::VZException("Heartbeat has to be positive.");
+		}
+		_filter.heartbeat(heartbeat);
+	} catch (vz::OptionNotFoundException &e) {
+		/* no heartbeat */
+	} catch (vz::VZException &e) {
+		print(log_error, "Invalid heartbeat (%s)", name(), e.what());
+		throw;
+	}
+
+	try {
+		/* keep unsent readings on disk, opened by open_spool() */
+		_spool_dir = optlist.lookup_string(pOptions, "spool");
+	} catch (vz::OptionNotFoundException &e) {
+		/* readings are kept in memory only */
+	}
+
+	/* allocated up front, so it only holds a quarter of the buffer, the rest waits in the buffer */
+	if (slots == 0) {
+		slots = queue_slots(_buffer->capacity() / 4);
+	}
+	_queue.reset(new Queue(slots));
+	Buffer::reserve(_queue->capacity() * sizeof(Reading), true);
+	if (Buffer::budget() > 0 && Buffer::reserved() > Buffer::budget()) {
+		print(log_warning, "Global memory budget exceeded by logging queues", name());
+	}
 
 	pthread_cond_init(&condition, NULL); /* initialize thread syncronization helpers */
+	pthread_mutex_init(&_consumer, NULL);
+}
+
+/**
+ * Pass a reading from the meter through the filter into the buffer
+ */
+void Channel::push(const Reading &rd) {
+	if (!_filter.enabled()) {
+		_buffer->push(rd);
+		return;
+	}
+
+	Reading out[2];
+	size_t n = _filter.apply(rd, out);
+	for (size_t i = 0; i < n; i++) {
+		_buffer->push(out[i]);
+	}
+}
+
+/**
+ * Hand over buffered readings to the uploader
+ *
+ * Called by the reading thread at the end of each aggregation period.
+ * The buffer mutex is only contended by the local webserver.
+ *
+ * @return number of readings which did not fit into the logging queue
+ */
+size_t Channel::publish() {
+	size_t n = 0;
+
+	_buffer->lock();
+	for (Buffer::iterator it = _buffer->begin(); it != _buffer->end(); it++) {
+		if (!_queue->push(*it)) {
+			break;
+		}
+		n++;
+	}
+	_buffer->unlock();
+	_buffer->acknowledge(n);
+
+	if (n < _buffer->size()) {
+		PRINT(log_debug, "Logging queue full, keeping %lu readings in buffer", name(),
+					(unsigned long)_buffer->size());
+	}
+	if (_uploader != NULL) {
+		_uploader->ready(_job);
+	}
+
+	return _buffer->size();
+}
+
+/**
+ * Open the spool before the channel is logged
+ *
+ * Not done by the constructor: a reload parses the channels again, and
+ * those matching a running channel must not touch its segments.
+ */
+void Channel::open_spool() {
+	if (_spool_dir.empty() || _spool) return;
+
+	try {
+		_spool.reset(new Spool(_spool_dir, _uuid));
+	} catch (vz::VZException &e) {
+		print(log_error, "Cannot open spool (%s)", name(), e.what());
+		throw;
+	}
+}
+
+/**
+ * Move published readings from the logging queue to the spool
+ *
+ * Called by the uploader before sending. All readings are synced
+ * to disk at once. If the spool cannot take them, the rest stays queued.
+ */
+void Channel::persist() {
+	if (!_spool) return;
+
+	size_t n = 0;
+	Reading *rd;
+
+	pthread_mutex_lock(&_consumer);
+	try {
+		while ((rd = _queue->peek(n)) != NULL) {
+			_spool->append(*rd);
+			n++;
+		}
+	} catch (vz::VZException &e) {
+		print(log_error, "Cannot spool readings: %s", name(), e.what());
+	}
+
+	_spool->commit();
+	_queue->acknowledge(n);
+	pthread_mutex_unlock(&_consumer);
+	_drained.notify();
+}
+
+void Channel::acknowledge(size_t n) {
+	pthread_mutex_lock(&_consumer);
+	if (_spool) {
+		_spool->acknowledge(n);
+	} else {
+		_queue->acknowledge(n);
+		_drained.notify();
+	}
+	pthread_mutex_unlock(&_consumer);
+}
+
+size_t Channel::pending() const {
+	pthread_mutex_lock(&_consumer);
+	size_t n = _spool ? _spool->size() : _queue->size();
+	pthread_mutex_unlock(&_consumer);
+	return n;
 }
 
 /**
  * Free all allocated memory recursivly
  */
 Channel::~Channel() {
+	Buffer::release(_queue->capacity() * sizeof(Reading));
+	pthread_mutex_destroy(&_consumer);
 	pthread_cond_destroy(&condition);
 }
 
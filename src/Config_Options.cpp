@@ -41,7 +41,12 @@ Config_Options::Config_Options()
 		, _verbosity(0)
 		, _comet_timeout(30)
 		, _buffer_length(600)
-		, _retry_pause(15)
+		, _retry_pause(HEALTH_DEFAULT_BACKOFF)
+		, _retry_max(HEALTH_DEFAULT_MAX_BACKOFF)
+		, _uploaders(UPLOADER_DEFAULT_WORKERS)
+		, _parallel(0)
+		, _reactor(0)
+		, _memory(0)
 		, _daemon(false)
 		, _local(false)
 		, _logging(true)
@@ -58,7 +63,12 @@ Config_Options::Config_Options(
 		, _verbosity(0)
 		, _comet_timeout(30)
 		, _buffer_length(600)
-		, _retry_pause(15)
+		, _retry_pause(HEALTH_DEFAULT_BACKOFF)
+		, _retry_max(HEALTH_DEFAULT_MAX_BACKOFF)
+		, _uploaders(UPLOADER_DEFAULT_WORKERS)
+		, _parallel(0)
+		, _reactor(0)
+		, _memory(0)
 		, _daemon(false)
 		, _local(false)
 		, _logging(true)
@@ -122,6 +132,21 @@ void Config_Options::config_parse(
 			else if (strcmp(key, "retry") == 0 && type == json_type_int) {
 				_retry_pause = json_object_get_int(value);
 			}
+			else if (strcmp(key, "retry_max") == 0 && type == json_type_int) {
+				_retry_max = json_object_get_int(value);
+			}
+			else if (strcmp(key, "uploaders") == 0 && type == json_type_int) {
+				_uploaders = json_object_get_int(value);
+			}
+			else if (strcmp(key, "parallel") == 0 && type == json_type_int) {
+				_parallel = json_object_get_int(value);
+			}
+			else if (strcmp(key, "reactor") == 0 && type == json_type_int) {
+				_reactor = json_object_get_int(value);
+			}
+			else if (strcmp(key, "memory") == 0 && type == json_type_int) {
+				_memory = json_object_get_int(value);
+			}
 			else if (strcmp(key, "verbosity") == 0 && type == json_type_int) {
 				_verbosity = json_object_get_int(value);
 			}
@@ -170,7 +195,7 @@ void Config_Options::config_parse(
 		throw;
 	}
 
-	print(log_debug, "Have %d meters.", NULL, mappings.size());
+	PRINT(log_debug, "Have %d meters.", NULL, mappings.size());
 
 
 	//json_object_put(json_cfg); /* free allocated memory */
@@ -179,6 +204,7 @@ void Config_Options::config_parse(
 void Config_Options::config_parse_meter(MapContainer &mappings, Json::Ptr jso) {
 	std::list<Json> json_channels;
 	std::list<Option> options;
+	std::string config; /* meter options without channels, compared on reload */
 
 	json_object_object_foreach(jso->Object(), key, value) {
 		enum json_type type = json_object_get_type(value);
@@ -195,11 +221,13 @@ void Config_Options::config_parse_meter(MapContainer &mappings, Json::Ptr jso) {
 		else { /* all other options will be passed to meter_init() */
 			Option option(key, value);
 			options.push_back(option);
+			config.append(key).append("=").append(json_object_to_json_string(value)).append(";");
 		}
 	}
 
 	/* init meter */
 	MeterMap  metermap(options);
+	metermap.config(config);
 
 	print(log_info, "New meter initialized (protocol=%s)", NULL/*(mapping*/,
 				meter_get_details(metermap.meter()->protocolId())->name);
@@ -221,7 +249,7 @@ void Config_Options::config_parse_channel(Json &jso, MeterMap &mapping)
 	const char *id_str = NULL;
 	const char *apiProtocol_str = NULL;
 
-	print(log_debug, "Configure channel.", NULL);
+	PRINT(log_debug, "Configure channel.", NULL);
 	json_object_object_foreach(jso.Object(), key, value) {
 		enum json_type type = json_object_get_type(value);
 
@@ -279,6 +307,7 @@ void Config_Options::config_parse_channel(Json &jso, MeterMap &mapping)
 	}
 
 	Channel::Ptr ch(new Channel(options, apiProtocol_str, uuid, id));
+	ch->config(json_object_to_json_string(jso.Object()));
 	print(log_info, "New channel initialized (uuid=...%s api=%s id=%s)", ch->name(),
 				uuid+30, apiProtocol_str, (id_str) ? id_str : "(none)");
 	mapping.push_back(ch);
@@ -0,0 +1,146 @@
+/**
+ * Dead-band filter and swinging door compression for readings of a channel
+ *
+ * @package vzlogger
+ * @license http://opensource.org/licenses/gpl-license.php GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <algorithm>
+
+#include "Filter.hpp"
+
+Filter::Filter() :
+		_enabled(false)
+		, _absolute(0)
+		, _relative(0)
+		, _heartbeat(0)
+		, _compress(false)
+		, _deviation(0)
+		, _slope_upper(0)
+		, _slope_lower(0)
+		, _have_last(false)
+		, _have_held(false)
+		, _suppressed(0)
+{
+}
+
+void Filter::deadband(double absolute, double relative) {
+	_absolute = fabs(absolute);
+	_relative = fabs(relative);
+	_enabled = true;
+}
+
+void Filter::heartbeat(int seconds) {
+	_heartbeat = (int64_t)seconds * 1000000;
+}
+
+void Filter::compression(double deviation) {
+	_deviation = fabs(deviation);
+	_compress = true;
+	_enabled = true;
+}
+
+size_t Filter::apply(const Reading &rd, Reading out[2]) {
+	return _compress ? apply_swinging_door(rd, out) : apply_deadband(rd, out);
+}
+
+size_t Filter::apply_deadband(const Reading &rd, Reading out[2]) {
+	size_t n = 0;
+
+	if (_enabled && _have_last) {
+		double band = std::max(_absolute, _relative * fabs(_last.value()));
+		double diff = fabs(rd.value() - _last.value());
+		bool changed = (band > 0) ? (diff > band) : (diff != 0);
+		bool silent = (_heartbeat > 0) && (rd.time_us() - _last.time_us() >= _heartbeat);
+
+		if (!changed && !silent) {
+			_held = rd;
+			_have_held = true;
+			_suppressed++;
+			return 0;
+		}
+
+		if (changed && _have_held) {
+			out[n++] = _held;
+		}
+	}
+
+	out[n++] = rd;
+	_last = rd;
+	_have_last = true;
+	_have_held = false;
+
+	return n;
+}
+
+/**
+ * Swinging door trending
+ *
+ * The doors are the steepest and flattest slope from the last forwarded
+ * reading which keep all readings since then within the deviation. Once
+ * they open past parallel, no line fits anymore and the held reading
+ * becomes the start of the next segment.
+ */
+size_t Filter::apply_swinging_door(const Reading &rd, Reading out[2]) {
+	size_t n = 0;
+
+	if (!_have_last) {
+		out[n++] = rd;
+		_last = rd;
+		_have_last = true;
+		return n;
+	}
+
+	/* out of order or duplicate timestamp */
+	if (rd.time_us() <= (_have_held ? _held : _last).time_us()) {
+		_suppressed++;
+		return 0;
+	}
+
+	double dt = (rd.time_us() - _last.time_us()) / 1e6;
+	double upper = (rd.value() + _deviation - _last.value()) / dt;
+	double lower = (rd.value() - _deviation - _last.value()) / dt;
+
+	if (!_have_held) {
+		_slope_upper = upper;
+		_slope_lower = lower;
+	} else {
+		bool silent = (_heartbeat > 0) && (rd.time_us() - _last.time_us() >= _heartbeat);
+
+		if (silent || std::min(_slope_upper, upper) < std::max(_slope_lower, lower)) {
+			/* held reading ends the segment and starts the next one */
+			out[n++] = _held;
+			_last = _held;
+
+			dt = (rd.time_us() - _last.time_us()) / 1e6;
+			_slope_upper = (rd.value() + _deviation - _last.value()) / dt;
+			_slope_lower = (rd.value() - _deviation - _last.value()) / dt;
+		} else {
+			_slope_upper = std::min(_slope_upper, upper);
+			_slope_lower = std::max(_slope_lower, lower);
+			_suppressed++;
+		}
+	}
+
+	_held = rd;
+	_have_held = true;
+
+	return n;
+}
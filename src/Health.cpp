@@ -0,0 +1,96 @@
+/**
+ * Health of a middleware host
+ *
+ * @package vzlogger
+ * @license http://opensource.org/licenses/gpl-license.php GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+
+#include "Health.hpp"
+
+Health::Health(const std::string &host, unsigned int seed)
+		: _host(host)
+		, _state(CLOSED)
+		, _failures(0)
+		, _retry_at(0)
+		, _seed(seed)
+{
+}
+
+std::string Health::host_of(const std::string &url) {
+	size_t start = url.find("://");
+	start = (start == std::string::npos) ? 0 : start + 3;
+
+	size_t end = url.find('/', start);
+	return url.substr(0, end);
+}
+
+bool Health::admit(int64_t now) {
+	switch (_state) {
+		case CLOSED:
+			return true;
+
+		case OPEN:
+			if (now >= _retry_at) {
+				_state = PROBING;
+				return true;
+			}
+			return false;
+
+		default:
+			return false; /* wait for the outcome of the probe */
+	}
+}
+
+bool Health::success() {
+	bool reopened = (_state != CLOSED);
+
+	_state = CLOSED;
+	_failures = 0;
+	return reopened;
+}
+
+bool Health::failure(int64_t now, int backoff, int max_backoff) {
+	if (_state == OPEN) {
+		return false; /* sent before the breaker opened */
+	}
+
+	_state = OPEN;
+	_failures++;
+
+	/* exponential backoff, the jitter spreads the probes of several instances */
+	int64_t limit = (int64_t)((max_backoff > backoff) ? max_backoff : backoff) * 1000000;
+	int64_t delay = (int64_t)((backoff > 0) ? backoff : 1) * 1000000;
+	for (unsigned int i = 1; i < _failures && delay < limit; i++) {
+		delay *= 2;
+	}
+	if (delay > limit) delay = limit;
+
+	delay = delay / 2 + (int64_t)(rand_r(&_seed) / (RAND_MAX + 1.0) * (delay / 2));
+	_retry_at = now + delay;
+
+	return true;
+}
+
+void Health::cancel() {
+	if (_state == PROBING) {
+		_state = OPEN; /* backoff has passed, the next request probes */
+	}
+}
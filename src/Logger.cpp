@@ -0,0 +1,278 @@
+/**
+ * Asynchronous backend of print()
+ *
+ * @package vzlogger
+ * @license http://opensource.org/licenses/gpl-license.php GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <VZException.hpp>
+#include "Logger.hpp"
+
+Logger::Logger(size_t records)
+		: _records(records)
+		, _seq(0)
+		, _dropped(0)
+		, _reported(0)
+		, _console(true)
+		, _daemon(false)
+		, _file(NULL)
+		, _second(-1)
+		, _running(false)
+{
+	_stamp[0] = '\0';
+	pthread_mutex_init(&_mutex, NULL);
+	pthread_key_create(&_key, &release);
+}
+
+Logger::~Logger() {
+	stop();
+	flush(); /* messages queued while stopping */
+
+	for (std::list<ring *>::iterator it = _rings.begin(); it != _rings.end(); it++) {
+		delete *it;
+	}
+	pthread_key_delete(_key);
+	pthread_mutex_destroy(&_mutex);
+}
+
+void Logger::start() {
+	if (_running) return;
+
+	if (pthread_create(&_thread, NULL, &worker, (void *) this) != 0) {
+		throw vz::VZException("Cannot start logging thread.");
+	}
+	_running = true;
+}
+
+void Logger::stop() {
+	if (!_running) return;
+
+	/* threads logging from now on write synchronously */
+	_running = false;
+	__sync_synchronize();
+
+	pthread_cancel(_thread);
+	pthread_join(_thread, NULL);
+	flush();
+}
+
+void Logger::logfile(FILE *file) {
+	pthread_mutex_lock(&_mutex);
+	_file = file;
+	pthread_mutex_unlock(&_mutex);
+}
+
+void Logger::log(log_level_t level, const char *id, const char *fmt, va_list args) {
+	record rd;
+
+	if (!_running) {
+		/* before start() or after stop(), e.g. while parsing the configuration */
+		int state;
+		pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+		format(rd, level, id, fmt, args);
+
+		pthread_mutex_lock(&_mutex);
+		_daemon = (getppid() == 1);
+		write(rd);
+		if (_file) fflush(_file);
+		pthread_mutex_unlock(&_mutex);
+
+		free(rd.text);
+		pthread_setcancelstate(state, NULL);
+		return;
+	}
+
+	ring *r = local();
+	format(rd, level, id, fmt, args);
+	if (!r->queue.push(rd)) {
+		free(rd.text);
+		__sync_add_and_fetch(&_dropped, 1);
+	}
+}
+
+/**
+ * Write all queued messages in the order they were logged
+ */
+void Logger::flush() {
+	bool wrote = false;
+
+	pthread_mutex_lock(&_mutex);
+	_daemon = (getppid() == 1); /* running as fork in background? */
+
+	for (;;) {
+		ring *oldest = NULL;
+		record *first = NULL;
+
+		for (std::list<ring *>::iterator it = _rings.begin(); it != _rings.end(); it++) {
+			record *rd = (*it)->queue.front();
+			if (rd != NULL && (first == NULL || (long)(rd->seq - first->seq) < 0)) {
+				first = rd;
+				oldest = *it;
+			}
+		}
+		if (oldest == NULL) break;
+
+		write(*first);
+		free(first->text);
+		oldest->queue.pop();
+		wrote = true;
+	}
+
+	/* rings of exited threads, nobody appends to them any more */
+	for (std::list<ring *>::iterator it = _rings.begin(); it != _rings.end(); ) {
+		if ((*it)->orphaned && (*it)->queue.empty()) {
+			delete *it;
+			it = _rings.erase(it);
+		} else {
+			it++;
+		}
+	}
+
+	unsigned long dropped = _dropped;
+	if (dropped != _reported) {
+		record rd;
+		rd.time = time(NULL);
+		rd.level = log_warning;
+		rd.text = NULL;
+		strcpy(rd.id, "[log]");
+		snprintf(rd.msg, sizeof(rd.msg), "Dropped %lu messages, logging faster than they can be written",
+					dropped - _reported);
+		write(rd);
+		_reported = dropped;
+		wrote = true;
+	}
+
+	/* one flush per batch instead of one per message */
+	if (wrote) {
+		if (_console && !_daemon) {
+			fflush(stdout);
+			fflush(stderr);
+		}
+		if (_file) fflush(_file);
+	}
+	pthread_mutex_unlock(&_mutex);
+}
+
+void *Logger::worker(void *arg) {
+	static_cast<Logger *>(arg)->run();
+	return NULL;
+}
+
+/**
+ * Thread exits, the writer frees its ring when it has been drained
+ */
+void Logger::release(void *r) {
+	static_cast<ring *>(r)->orphaned = true;
+}
+
+void Logger::run() {
+	struct timespec ts;
+	ts.tv_sec = 0;
+	ts.tv_nsec = LOGGER_FLUSH_INTERVAL * 1000000L;
+
+	for (;;) {
+		nanosleep(&ts, NULL); /* cancellation point */
+
+		int state;
+		pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+		flush();
+		pthread_setcancelstate(state, NULL);
+	}
+}
+
+/**
+ * Ring of the calling thread, created on its first message
+ */
+Logger::ring *Logger::local() {
+	ring *r = static_cast<ring *>(pthread_getspecific(_key));
+
+	if (r == NULL) {
+		r = new ring(_records);
+
+		pthread_mutex_lock(&_mutex);
+		_rings.push_back(r);
+		pthread_mutex_unlock(&_mutex);
+
+		pthread_setspecific(_key, r);
+	}
+	return r;
+}
+
+void Logger::format(record &rd, log_level_t level, const char *id, const char *fmt, va_list args) {
+	va_list copy;
+	va_copy(copy, args);
+
+	rd.seq = __sync_fetch_and_add(&_seq, 1);
+	rd.time = time(NULL);
+	rd.level = level;
+	rd.text = NULL;
+
+	/* format section */
+	if (id) {
+		snprintf(rd.id, sizeof(rd.id), "[%s]", id);
+	} else {
+		rd.id[0] = '\0';
+	}
+
+	int len = vsnprintf(rd.msg, sizeof(rd.msg), fmt, args);
+	if (len >= (int)sizeof(rd.msg)) {
+		/* e.g. request bodies and buffer dumps */
+		rd.text = (char *) malloc(len + 1);
+		if (rd.text != NULL) {
+			vsnprintf(rd.text, len + 1, fmt, copy);
+		}
+	}
+	va_end(copy);
+}
+
+void Logger::write(const record &rd) {
+	const char *text = (rd.text != NULL) ? rd.text : rd.msg;
+	char prefix[sizeof(_stamp) + sizeof(rd.id)];
+
+	/* stamp of 17 and section of up to 7 characters, padded to 24 below */
+	snprintf(prefix, sizeof(prefix), "%s%s", stamp(rd.time), rd.id);
+
+	/* print to stdout/stderr */
+	if (_console && !_daemon) {
+		FILE *stream = (rd.level > 0) ? stdout : stderr;
+		fprintf(stream, "%-24s%s\n", prefix, text);
+	}
+
+	/* append to logfile */
+	if (_file) {
+		fprintf(_file, "%-24s%s\n", prefix, text);
+	}
+}
+
+/**
+ * Timestamp prefix, formatted once per second
+ */
+const char *Logger::stamp(time_t time) {
+	if (time != _second) {
+		struct tm timeinfo;
+		localtime_r(&time, &timeinfo);
+		strftime(_stamp, 18, "[%b %d %H:%M:%S]", &timeinfo);
+		_second = time;
+	}
+	return _stamp;
+}
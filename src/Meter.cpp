@@ -78,7 +78,7 @@ Meter::Meter(std::list<Option> pOptions) :
 	try {
 		// protocol
 		const char *protocol_str = optlist.lookup_string(pOptions, "protocol");
-		print(log_debug, "Creating new meter with protocol %s.", name(), protocol_str);
+		PRINT(log_debug, "Creating new meter with protocol %s.", name(), protocol_str);
 
 		if (meter_lookup_protocol(protocol_str, &_protocol_id) != SUCCESS) {
 //print(log_error, "Invalid protocol: %s", mtr, protocol_str);
@@ -112,6 +112,21 @@ Meter::Meter(std::list<Option> pOptions) :
 		print(log_error, "Invalid type for aggtime", name());
 		throw;
 	}
+	try {
+		// synchronized sampling
+		_sync = optlist.lookup_int(pOptions, "sync");
+	} catch (vz::OptionNotFoundException &e) {
+		_sync = 0; /* meter has its own timestamps */
+	} catch (vz::VZException &e) {
+		print(log_error, "Invalid type for sync", name());
+		throw;
+	}
+	if (_sync > 0) {
+		if (_interval > 0 && _interval != _sync) {
+			print(log_warning, "Interval %i is replaced by sync %i", name(), _interval, _sync);
+		}
+		_interval = _sync; /* read at each tick */
+	}
 	try {
 		_aggFixedInterval = optlist.lookup_bool(pOptions, "aggfixedinterval");
 	} catch (vz::OptionNotFoundException &e) {
@@ -187,7 +202,7 @@ Meter::Meter(std::list<Option> pOptions) :
 		throw;
 	}
 
-	print(log_debug, "Meter configured, %s.", name(), _enable ? "enabled" : "disabled");
+	PRINT(log_debug, "Meter configured, %s.", name(), _enable ? "enabled" : "disabled");
 }
 
 //Meter::Meter(const Meter *mtr) {
@@ -207,8 +222,16 @@ int Meter::close() {
 	return _protocol->close();
 }
 
-size_t Meter::read(std::vector<Reading> &rds, size_t n) {
-	return _protocol->read(rds, n);
+size_t Meter::read(std::vector<Reading> &rds, size_t n, int64_t tick) {
+	n = _protocol->read(rds, n);
+
+	/* synchronized meters: all readings of a tick share its timestamp */
+	if (tick >= 0) {
+		for (size_t i = 0; i < n; i++) {
+			rds[i].time_us(tick);
+		}
+	}
+	return n;
 }
 
 int meter_lookup_protocol(const char* name, meter_protocol_t *protocol) {
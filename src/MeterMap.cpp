@@ -34,19 +34,86 @@
  * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
  */
 #include <math.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
 
 #include <MeterMap.hpp>
 #include <Config_Options.hpp>
-#include <api/Volkszaehler.hpp>
-#include <api/MySmartGrid.hpp>
-#include <api/Null.hpp>
+#include <threads.h>
 
 extern Config_Options options;	/* global application options */
 
+#define METER_CHUNK_LEN 1024	/* max. bytes read at once in the reactor */
+
+/**
+ * Reads a meter in the reactor, the counterpart of reading_thread()
+ *
+ * Data is read as it arrives and fed to the push parser of the protocol,
+ * so a meter never blocks a reactor thread in the middle of a message.
+ */
+class MeterHandler : public Reactor::Handler, public vz::protocol::ReadingSink {
+public:
+	MeterHandler(MeterMap *mapping) : _mapping(mapping), _size(0) {
+		Meter::Ptr mtr = mapping->meter();
+		const meter_details_t *details = meter_get_details(mtr->protocolId());
+
+		_rds.assign(details->max_readings, Reading(mtr->identifier()));
+		_agg_end = time(NULL) + mtr->aggtime();
+	}
+
+	int fd() const { return _mapping->meter()->fd(); }
+
+	bool ready() {
+		Meter::Ptr mtr = _mapping->meter();
+		uint8_t data[METER_CHUNK_LEN];
+
+		ssize_t len = ::read(fd(), data, sizeof(data));
+		if (len < 0 && (errno == EAGAIN || errno == EINTR)) {
+			return true;
+		}
+		else if (len < 0) {
+			print(log_error, "Cannot read from meter: %s", mtr->name(), strerror(errno));
+			return false;
+		}
+		else if (len == 0) {
+			print(log_error, "Meter closed the connection", mtr->name());
+			return false;
+		}
+
+		size_t messages = mtr->protocol()->feed(data, len, *this);
+		flush();
+
+		if (messages > 0 && (mtr->aggtime() <= 0 || time(NULL) >= _agg_end)) {
+			_agg_end += mtr->aggtime(); /* end of the next aggregation period */
+			publish_channels(_mapping);
+		}
+		return true;
+	}
+
+	/* sink of the push parser */
+	bool push(const Reading &rd) {
+		if (_size == _rds.size()) flush();
+		_rds[_size++] = rd;
+		return true;
+	}
+
+private:
+	void flush() {
+		route_readings(_mapping, _rds, _size);
+		_size = 0;
+	}
+
+	MeterMap *_mapping;
+	std::vector<Reading> _rds;	// readings parsed from the last chunk
+	size_t _size;
+	time_t _agg_end;			// end of this aggregation period
+};
+
 /**
-	If the meter is enabled, start the meter and all its channels.
+	If the meter is enabled, start the meter and add its channels to the uploader.
 */
-void MeterMap::start() {
+void MeterMap::start(MapContainer &container) {
 	if (_meter->isEnabled()) {
 		try {
 			_meter->open();
@@ -60,52 +127,186 @@ void MeterMap::start() {
 				throw;
 			}
 		}
+		_open = true;
 
 		print(log_info, "Meter connection established", _meter->name());
-		pthread_create(&_thread, NULL, &reading_thread, (void *) this);
-		print(log_debug, "Meter thread started", _meter->name());
 
-		print(log_debug, "Meter is opened. Starting channels.", _meter->name());
+		PRINT(log_debug, "Meter is opened. Starting channels.", _meter->name());
+		_uploader = options.logging() ? &container.uploader() : NULL;
 		for (iterator it = _channels.begin(); it!=_channels.end(); it++) {
-			// set buffer length for perriodic meters
-			if (meter_get_details(_meter->protocolId())->periodic && options.local()) {
-				(*it)->buffer()->keep(ceil(options.buffer_length() / (double) _meter->interval()));
-			}
-
-			if (options.logging()) {
-				(*it)->start();
-				print(log_debug, "Logging thread started", (*it)->name());
-			}
+			attach(*it);
 		}
-		_thread_running = true;
+
+		resume(container);
 	} else {
 		print(log_info, "Meter for protocol '%s' is disabled. Skipping.", _meter->name(),
 					_meter->protocol()->name().c_str());
 	}
 }
 
-bool MeterMap::stopped() {
-	if (_meter->isEnabled()  && running()) {
-		if (pthread_join(_thread, NULL) == 0) {
-			_thread_running = false;
-
-			// join channel-threads
-			for (iterator it = _channels.begin(); it!=_channels.end(); it++) {
-				(*it)->cancel();
-				(*it)->join();
+/**
+ * Start reading the opened meter
+ */
+void MeterMap::resume(MapContainer &container) {
+	build_routes();
+	_exited = false;
+	_notify = &container.event();
+
+	/* synchronized meters are read at the ticks of the scheduler */
+	if (options.reactor() > 0 && _meter->fd() >= 0 && _meter->sync() <= 0) {
+		_reactor = &container.reactor();
+		_handler.reset(new MeterHandler(this));
+		_reactor->add(_handler.get());
+		PRINT(log_debug, "Meter added to reactor", _meter->name());
+	} else {
+		if (_meter->interval() > 0) {
+			_scheduler = &container.scheduler();
+			_timer = _scheduler->add(_meter->name(), (int64_t)_meter->interval() * 1000000);
+		}
+		pthread_create(&_thread, NULL, &reading_thread, (void *) this);
+		PRINT(log_debug, "Meter thread started", _meter->name());
+	}
+	_thread_running = true;
+}
+
+/**
+ * Stop reading, the meter stays open
+ */
+void MeterMap::pause() {
+	if (!running()) return;
+
+	if (_reactor != NULL) {
+		_reactor->remove(_handler.get());
+		_handler.reset();
+		_reactor = NULL;
+	} else {
+		pthread_cancel(_thread);
+		pthread_join(_thread, NULL);
+	}
+
+	if (_scheduler != NULL) {
+		_scheduler->remove(_timer);
+		_scheduler = NULL;
+	}
+	_thread_running = false;
+}
+
+void MeterMap::stop() {
+	pause();
+
+	for (iterator it = _channels.begin(); it != _channels.end(); it++) {
+		detach(*it);
+	}
+
+	if (_open) {
+		_meter->close();
+		_open = false;
+		print(log_info, "Meter closed", _meter->name());
+	}
+}
+
+void MeterMap::reconfigure(MapContainer &container, MeterMap &other) {
+	std::vector<Channel::Ptr> channels;
+	std::vector<bool> kept(_channels.size(), false);
+
+	pause();
+
+	for (iterator ch = other.begin(); ch != other.end(); ch++) {
+		size_t i = 0;
+		while (i < _channels.size() && (kept[i] || _channels[i]->config() != (*ch)->config())) i++;
+
+		if (i < _channels.size()) {
+			kept[i] = true;
+			channels.push_back(_channels[i]); /* keeps its buffer and queue */
+		} else {
+			try {
+				attach(*ch);
+			} catch (std::exception &e) {
+				print(log_error, "Cannot add channel: %s", (*ch)->name(), e.what());
+				continue;
 			}
-			return true;
+			channels.push_back(*ch);
+			print(log_info, "Channel added", (*ch)->name());
 		}
 	}
-	return false;
+
+	for (size_t i = 0; i < _channels.size(); i++) {
+		if (!kept[i]) {
+			detach(_channels[i]);
+			print(log_info, "Channel removed", _channels[i]->name());
+		}
+	}
+
+	_channels = channels;
+	resume(container);
 }
 
-void MeterMap::cancel() {
-	if (_meter->isEnabled() && running()) {
-		for (iterator it = _channels.begin(); it != _channels.end(); it++) {
-			(*it)->cancel();
-			(*it)->join();
+bool MeterMap::same_channels(const MeterMap &other) const {
+	if (_channels.size() != other._channels.size()) return false;
+
+	for (size_t i = 0; i < _channels.size(); i++) {
+		if (_channels[i]->config() != other._channels[i]->config()) return false;
+	}
+	return true;
+}
+
+void MeterMap::attach(Channel::Ptr ch) {
+	// set buffer length for perriodic meters
+	if (meter_get_details(_meter->protocolId())->periodic && options.local()) {
+		ch->buffer()->keep(ceil(options.buffer_length() / (double) _meter->interval()));
+	}
+
+	if (_uploader != NULL) {
+		ch->open_spool();
+		_uploader->add(ch, vz::ApiIF::create(ch));
+		PRINT(log_debug, "Logging to %s", ch->name(), ch->apiProtocol().c_str());
+	}
+}
+
+void MeterMap::detach(Channel::Ptr ch) {
+	if (ch->uploader() != NULL) {
+		ch->uploader()->remove(ch->job());
+	}
+}
+
+/**
+ * The channel identifiers are interned here, so the table is a plain vector
+ * indexed by identifier id. Readings with ids beyond the table are not
+ * configured; the parsers drop most of them before, as their lookup yields 0.
+ */
+void MeterMap::build_routes() {
+	_routes.clear();
+
+	for (iterator it = _channels.begin(); it != _channels.end(); it++) {
+		reading_id_t id = (*it)->identifier_id();
+		if (id >= _routes.size()) {
+			_routes.resize(id + 1);
 		}
+		_routes[id].push_back(*it);
+	}
+
+	/* the reading threads look up identifiers in the published table */
+	IdentifierTable::freeze();
+}
+
+bool MeterMap::stopped() {
+	if (!_meter->isEnabled() || !running()) {
+		return false;
+	}
+
+	if (_reactor != NULL) {
+		if (!_reactor->finished()) return false;
+	} else {
+		if (!_exited) return false;
+		pthread_join(_thread, NULL);
+	}
+	_thread_running = false;
+	return true;
+}
+
+void MeterMap::cancel() {
+	/* the reactor is stopped as a whole */
+	if (_meter->isEnabled() && running() && _reactor == NULL) {
 		pthread_cancel(_thread);
 		pthread_join(_thread, NULL);
 		_thread_running = false;
@@ -114,6 +315,13 @@ void MeterMap::cancel() {
 	}
 }
 
+void MeterMap::exited() {
+	_exited = true;
+	if (_notify != NULL) {
+		_notify->notify();
+	}
+}
+
 void MeterMap::registration() {
 	//Channel::Ptr ch;
 
@@ -121,22 +329,79 @@ void MeterMap::registration() {
 		return;
 	}
 	for (iterator ch = _channels.begin(); ch != _channels.end(); ch++) {
-		// create configured api interfaces
-		// NOTE: if additional APIs are introduced both threads.cpp and MeterMap.cpp need to be updated
-		vz::ApiIF::Ptr api;
-		if ((*ch)->apiProtocol() == "mysmartgrid") {
-			api =  vz::ApiIF::Ptr(new vz::api::MySmartGrid(*ch, (*ch)->options()));
-			print(log_debug, "Using MySmartGrid api.", (*ch)->name());
+		vz::ApiIF::create(*ch)->register_device();
+	}
+	printf("..done\n");
+}
+
+/**
+ * Meters are matched by their configuration. A running meter with the same
+ * configuration stays open, only its changed channels are replaced.
+ * Removed meters are closed before new ones are opened, so a device can
+ * move from one meter definition to another.
+ */
+void MapContainer::reload(MapContainer &fresh) {
+	std::list<MeterMap> next;
+	std::vector<MeterMap *> added;
+	unsigned unchanged = 0, changed = 0;
+
+	pthread_rwlock_wrlock(&_lock);
+
+	/* handlers must not run while meters are changed */
+	_reactor.stop();
+
+	while (!fresh._mappings.empty()) {
+		iterator n = fresh._mappings.begin();
+		iterator old = _mappings.begin();
+		while (old != _mappings.end() && !(old->running() && old->config() == n->config())) {
+			old++;
 		}
-		else if ((*ch)->apiProtocol() == "null") {
-			api =  vz::ApiIF::Ptr(new vz::api::Null(*ch, (*ch)->options()));
-			print(log_debug, "Using null api- meter data available via local httpd if enabled.", (*ch)->name());
+
+		if (old == _mappings.end()) {
+			next.splice(next.end(), fresh._mappings, n);
+			added.push_back(&next.back());
+			continue;
+		}
+
+		if (old->same_channels(*n)) {
+			unchanged++;
 		} else {
-			api =  vz::ApiIF::Ptr(new vz::api::Volkszaehler(*ch, (*ch)->options()));
-			print(log_debug, "Using default volkszaehler api.", (*ch)->name());
+			old->reconfigure(*this, *n);
+			print(log_info, "Channels reconfigured", old->meter()->name());
+			changed++;
 		}
+		next.splice(next.end(), _mappings, old);
+		fresh._mappings.erase(n);
+	}
 
-		api->register_device();
+	/* meters which are left have been removed or changed */
+	size_t removed = _mappings.size();
+	for (iterator it = _mappings.begin(); it != _mappings.end(); it++) {
+		it->stop();
 	}
-	printf("..done\n");
+	_mappings.swap(next);
+	next.clear(); /* closes their spools before a new channel opens the same one */
+
+	for (std::vector<MeterMap *>::iterator it = added.begin(); it != added.end(); it++) {
+		try {
+			(*it)->start(*this);
+		} catch (std::exception &e) {
+			print(log_error, "Cannot start meter: %s", (*it)->meter()->name(), e.what());
+		}
+	}
+
+	if (_scheduler.size() > 0) {
+		_scheduler.start();
+	}
+	if (_reactor.size() > 0) {
+		_reactor.start(options.reactor());
+	}
+	if (options.logging()) {
+		_uploader.start(options.uploaders(), options.parallel());
+	}
+
+	pthread_rwlock_unlock(&_lock);
+
+	print(log_info, "Configuration reloaded: %u meters unchanged, %u reconfigured, %lu started, %lu stopped",
+				(char*)0, unchanged, changed, (unsigned long)added.size(), (unsigned long)removed);
 }
@@ -264,6 +264,14 @@ bool Obis::operator==(const Obis &rhs) const {
 	return 1; // equal
 }
 
+size_t Obis::hash() const {
+	size_t h = 0;
+	for (int i = 0; i < 6; i++) {
+		h = h * 31 + _obisId._raw[i];
+	}
+	return h;
+}
+
 bool Obis::isAllNotGiven() const {
 	return *this == Obis(); // compare this one with empty one from default constructor
 }
@@ -121,7 +121,7 @@ Option::operator bool() const {
 }
 
 //Option& OptionList::lookup(List<Option> options, char *key) {
-const Option &OptionList::lookup(std::list<Option> options, const std::string &key) const {
+const Option &OptionList::lookup(const std::list<Option> &options, const std::string &key) const {
 	for (const_iterator it = options.begin(); it != options.end(); it++) {
 		if (it->key() == key ) {
 			return (*it);
@@ -131,9 +131,10 @@ const Option &OptionList::lookup(std::list<Option> options, const std::string &k
 	throw vz::OptionNotFoundException("Option '"+ std::string(key) +"' not found");
 }
 
-const char *OptionList::lookup_string(std::list<Option> options, const char *key)
+/* points into the option of the list, which must outlive the string */
+const char *OptionList::lookup_string(const std::list<Option> &options, const char *key)
 {
-	Option opt = lookup(options, key);
+	const Option &opt = lookup(options, key);
 	return (const char*)opt;
 }
 
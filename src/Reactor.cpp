@@ -0,0 +1,174 @@
+/**
+ * Event loop for meters which send data by themselves
+ *
+ * @package vzlogger
+ * @license http://opensource.org/licenses/gpl-license.php GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#include "common.h"
+#include "Reactor.hpp"
+
+Reactor::Reactor()
+		: _handlers(0)
+		, _finished(false)
+{
+	_epfd = epoll_create(16);
+	if (_epfd < 0) {
+		throw vz::VZException("Cannot create epoll instance.");
+	}
+	pthread_mutex_init(&_mutex, NULL);
+}
+
+Reactor::~Reactor() {
+	stop();
+	close(_epfd);
+	pthread_mutex_destroy(&_mutex);
+}
+
+void Reactor::add(Handler *handler) {
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+
+	/* one shot: a handler is never run by two threads at once */
+	ev.events = EPOLLIN | EPOLLONESHOT;
+	ev.data.ptr = handler;
+
+	if (epoll_ctl(_epfd, EPOLL_CTL_ADD, handler->fd(), &ev) != 0) {
+		throw vz::VZException(std::string("Cannot register descriptor: ") + strerror(errno));
+	}
+
+	pthread_mutex_lock(&_mutex);
+	_registry.push_back(handler);
+	pthread_mutex_unlock(&_mutex);
+	__sync_add_and_fetch(&_handlers, 1);
+}
+
+void Reactor::remove(Handler *handler) {
+	pthread_mutex_lock(&_mutex);
+	std::vector<Handler *>::iterator it = std::find(_registry.begin(), _registry.end(), handler);
+	bool found = (it != _registry.end());
+	if (found) {
+		_registry.erase(it);
+	}
+	pthread_mutex_unlock(&_mutex);
+
+	/* already dropped after a failure */
+	if (!found) return;
+
+	epoll_ctl(_epfd, EPOLL_CTL_DEL, handler->fd(), NULL);
+	__sync_sub_and_fetch(&_handlers, 1);
+}
+
+/**
+ * Handler failed, stop waiting for it
+ */
+void Reactor::drop(Handler *handler) {
+	remove(handler);
+
+	if (_handlers == 0) {
+		print(log_warning, "No meters left", "reactor");
+		shutdown();
+	}
+}
+
+void Reactor::start(int threads) {
+	size_t n = (threads > 0) ? threads : 1;
+	if (n > _handlers) n = _handlers;
+
+	while (_threads.size() < n) {
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, &worker, (void *) this) != 0) {
+			throw vz::VZException("Cannot start reactor thread.");
+		}
+		_threads.push_back(thread);
+	}
+
+	PRINT(log_debug, "Started %lu reactor threads for %lu meters", "reactor",
+				(unsigned long)_threads.size(), (unsigned long)_handlers);
+}
+
+void Reactor::stop() {
+	/* threads block in epoll_wait() or in a meter, both are cancellation points */
+	for (std::vector<pthread_t>::iterator it = _threads.begin(); it != _threads.end(); it++) {
+		pthread_cancel(*it);
+		pthread_join(*it, NULL);
+	}
+	_threads.clear();
+}
+
+void Reactor::shutdown() {
+	_finished = true;
+	_done.notify(); /* only write(), safe in a signal handler */
+}
+
+void Reactor::wait() {
+	while (!_finished) {
+		_done.wait();
+	}
+	_done.notify(); /* other waiters */
+}
+
+void *Reactor::worker(void *arg) {
+	static_cast<Reactor *>(arg)->run();
+	return NULL;
+}
+
+void Reactor::run() {
+	struct epoll_event ev;
+
+	while (!_finished) {
+		int n = epoll_wait(_epfd, &ev, 1, -1);
+		if (n < 0 && errno != EINTR) {
+			print(log_error, "epoll_wait failed: %s", "reactor", strerror(errno));
+			shutdown();
+			break;
+		}
+		if (n <= 0) continue;
+
+		Handler *handler = static_cast<Handler *>(ev.data.ptr);
+		bool keep = false;
+
+		/* stop() only cancels in epoll_wait(), never in the middle of a handler */
+		int state;
+		pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+		try {
+			keep = handler->ready();
+		} catch (std::exception &e) {
+			print(log_error, "Reading failed: %s", "reactor", e.what());
+		}
+
+		if (!keep) {
+			drop(handler);
+		} else {
+			/* arm again for the next message */
+			ev.events = EPOLLIN | EPOLLONESHOT;
+			if (epoll_ctl(_epfd, EPOLL_CTL_MOD, handler->fd(), &ev) != 0) {
+				print(log_error, "Cannot rearm descriptor: %s", "reactor", strerror(errno));
+				drop(handler);
+			}
+		}
+		pthread_setcancelstate(state, NULL);
+	}
+}
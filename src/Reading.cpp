@@ -34,44 +34,38 @@
 #include "Reading.hpp"
 
 Reading::Reading()
-		: _deleted(false)
+		: _time(0)
 		, _value(0)
+		, _id(0)
 {
 }
 
 Reading::Reading(ReadingIdentifier::Ptr pIndentifier)
-		: _deleted(false)
+		: _time(0)
 		, _value(0)
-								//    , time(0)
-		, _identifier(pIndentifier)
+		, _id(IdentifierTable::intern(pIndentifier))
 {
-
 }
+
 Reading::Reading(
 	double pValue
 	, struct timeval pTime
 	, ReadingIdentifier::Ptr pIndentifier
 	)
-		: _deleted(false)
-		, _value(pValue)
-		, _time(pTime)
-		, _identifier(pIndentifier)
+		: _value(pValue)
+		, _id(IdentifierTable::intern(pIndentifier))
 {
+	time(pTime);
 }
 
-Reading::Reading(
-	const Reading &orig
-	) :
-		_deleted(orig._deleted)
-		, _value(orig._value)
-		, _time(orig._time)
-		, _identifier (orig._identifier)
-{
-//	printf("+==>Copy: %f %f orig %f %f\n", tvtod(), _value, orig.tvtod(), orig._value);
+void Reading::time() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	time(tv);
 }
 
 double Reading::tvtod() const {
-	return (double)_time.tv_sec + ((double)_time.tv_usec / 1e6);
+	return (double)(_time / 1000000) + ((double)(_time % 1000000) / 1e6);
 }
 
 double Reading::tvtod(struct timeval const &tv) const {
@@ -142,7 +136,7 @@ size_t Reading::unparse(
 	char *buffer, size_t n
 	) {
 
-	return _identifier->unparse(buffer, n);
+	return identifier()->unparse(buffer, n);
 
 #if 0
 	switch (protocol) {
@@ -200,6 +194,19 @@ bool ReadingIdentifier::compare( ReadingIdentifier const *lhs,  ReadingIdentifie
 	return false;
 }
 
+/* FNV-1a, seeded with the identifier type */
+static size_t hash_bytes(size_t h, const void *data, size_t len) {
+	const unsigned char *p = static_cast<const unsigned char *>(data);
+	for (size_t i = 0; i < len; i++) {
+		h = (h ^ p[i]) * 16777619;
+	}
+	return h;
+}
+
+size_t ObisIdentifier::hash() const {
+	return _obis.hash();
+}
+
 size_t ObisIdentifier::unparse(char *buffer, size_t n) {
 	return _obis.unparse(buffer, n);
 }
@@ -212,6 +219,10 @@ bool StringIdentifier::operator==(StringIdentifier const &cmp) const{
 	return (_string == cmp._string);
 }
 
+size_t StringIdentifier::hash() const {
+	return hash_bytes(2166136261u ^ 2, _string.data(), _string.size());
+}
+
 void StringIdentifier::parse(const char *string) {
 	_string = string;
 }
@@ -231,6 +242,10 @@ bool ChannelIdentifier::operator==(ChannelIdentifier const &cmp) const {
 	return (_channel == cmp._channel);
 }
 
+size_t ChannelIdentifier::hash() const {
+	return hash_bytes(2166136261u ^ 3, &_channel, sizeof(_channel));
+}
+
 void ChannelIdentifier::parse(const char *string) {
 	char type[13];
 	int channel;
@@ -259,3 +274,113 @@ size_t NilIdentifier::unparse(char *buffer, size_t n) {
 //buffer[0] = '\0';
 	//return strlen(buffer);
 }
+
+/* IdentifierTable */
+pthread_mutex_t IdentifierTable::_mutex = PTHREAD_MUTEX_INITIALIZER;
+std::vector<ReadingIdentifier::Ptr> IdentifierTable::_ids;
+IdentifierTable::index_t IdentifierTable::_index;
+std::list<IdentifierTable::Frozen> IdentifierTable::_tables;
+IdentifierTable::Frozen * volatile IdentifierTable::_frozen = NULL;
+
+/* caller has to hold the lock */
+void IdentifierTable::init() {
+	if (_ids.empty()) {
+		_ids.push_back(ReadingIdentifier::Ptr(new NilIdentifier()));
+		_index.insert(std::make_pair(_ids[0]->hash(), 0));
+	}
+}
+
+/* @return 0 if not found */
+reading_id_t IdentifierTable::find(const std::vector<ReadingIdentifier::Ptr> &ids,
+								   const index_t &index, const ReadingIdentifier &rid) {
+	std::pair<index_t::const_iterator, index_t::const_iterator> range = index.equal_range(rid.hash());
+	for (index_t::const_iterator it = range.first; it != range.second; it++) {
+		if (*ids[it->second] == rid) {
+			return it->second;
+		}
+	}
+	return 0;
+}
+
+reading_id_t IdentifierTable::intern(const ReadingIdentifier &rid) {
+	pthread_mutex_lock(&_mutex);
+	init();
+
+	reading_id_t id = find(_ids, _index, rid);
+	if (id == 0 && !(*_ids[0] == rid)) {
+		/* first sight, store a copy */
+		id = _ids.size();
+		_ids.push_back(ReadingIdentifier::Ptr(rid.clone()));
+		_index.insert(std::make_pair(rid.hash(), id));
+	}
+	pthread_mutex_unlock(&_mutex);
+
+	return id;
+}
+
+reading_id_t IdentifierTable::intern(ReadingIdentifier::Ptr rid) {
+	if (rid.get() == NULL) {
+		return 0; /* NilIdentifier */
+	}
+	return intern(*rid);
+}
+
+/**
+ * Publish the identifiers interned so far
+ *
+ * Readers may still use the previous copy, so it is kept. A new copy
+ * is only made when the configuration added identifiers.
+ */
+void IdentifierTable::freeze() {
+	pthread_mutex_lock(&_mutex);
+	init();
+
+	if (_frozen == NULL || _frozen->ids.size() != _ids.size()) {
+		_tables.push_back(Frozen());
+		Frozen &frozen = _tables.back();
+		frozen.ids = _ids;
+		frozen.index = _index;
+
+		__sync_synchronize(); /* publish contents before pointer */
+		_frozen = &frozen;
+	}
+	pthread_mutex_unlock(&_mutex);
+}
+
+reading_id_t IdentifierTable::lookup(const ReadingIdentifier &rid) {
+	/* loads through the pointer depend on it, no barrier needed */
+	const Frozen *frozen = _frozen;
+
+	return (frozen != NULL) ? find(frozen->ids, frozen->index, rid) : 0;
+}
+
+ReadingIdentifier::Ptr IdentifierTable::get(reading_id_t id) {
+	const Frozen *frozen = _frozen;
+	ReadingIdentifier::Ptr rid;
+
+	if (frozen != NULL && id < frozen->ids.size()) {
+		rid = frozen->ids[id];
+	} else {
+		/* interned, but not frozen yet */
+		pthread_mutex_lock(&_mutex);
+		init();
+		if (id < _ids.size()) {
+			rid = _ids[id];
+		}
+		pthread_mutex_unlock(&_mutex);
+	}
+
+	if (rid.get() == NULL) {
+		throw vz::VZException("Unknown identifier id.");
+	}
+	return rid;
+}
+
+size_t IdentifierTable::size() {
+	pthread_mutex_lock(&_mutex);
+	init();
+	size_t n = _ids.size();
+	pthread_mutex_unlock(&_mutex);
+
+	return n;
+}
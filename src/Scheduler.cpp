@@ -0,0 +1,294 @@
+/**
+ * Drift-free scheduler for periodic meters
+ *
+ * @package vzlogger
+ * @license http://opensource.org/licenses/gpl-license.php GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "common.h"
+#include <VZException.hpp>
+#include "Scheduler.hpp"
+
+static void unlock_mutex(void *mutex) {
+	pthread_mutex_unlock(static_cast<pthread_mutex_t *>(mutex));
+}
+
+Scheduler::Scheduler(int64_t resolution)
+		: _resolution((resolution > 0 && 1000000 % resolution == 0) ? resolution : SCHEDULER_RESOLUTION)
+		, _wheel(SCHEDULER_SLOTS)
+		, _running(false)
+{
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+
+	pthread_mutex_init(&_mutex, NULL);
+	pthread_cond_init(&_cond, NULL);
+	pthread_cond_init(&_wakeup, &attr);
+	pthread_condattr_destroy(&attr);
+	anchor();
+}
+
+Scheduler::~Scheduler() {
+	stop();
+
+	pthread_cond_destroy(&_wakeup);
+	pthread_cond_destroy(&_cond);
+	pthread_mutex_destroy(&_mutex);
+}
+
+size_t Scheduler::add(const char *name, int64_t interval) {
+	timer t;
+	t.name = (name != NULL) ? name : "";
+	t.interval = (interval + _resolution / 2) / _resolution;
+	if (t.interval == 0) t.interval = 1;
+	t.due = t.tick = 0;
+	t.waiting = t.fired = t.late = false;
+	t.active = true;
+	t.overruns = t.skipped = 0;
+
+	pthread_mutex_lock(&_mutex);
+	size_t index = 0;
+	while (index < _timers.size() && _timers[index].active) index++;
+	if (index < _timers.size()) {
+		_timers[index] = t; /* reuse a removed timer, reloads do not grow the table */
+	} else {
+		_timers.push_back(t);
+	}
+	schedule(index);
+	pthread_cond_signal(&_wakeup); /* might be due before the current sleep ends */
+	pthread_mutex_unlock(&_mutex);
+
+	return index;
+}
+
+void Scheduler::remove(size_t index) {
+	pthread_mutex_lock(&_mutex);
+	timer &t = _timers[index];
+	if (t.active) {
+		_wheel[t.due % SCHEDULER_SLOTS].remove(index);
+		t.active = false;
+	}
+	pthread_mutex_unlock(&_mutex);
+}
+
+void Scheduler::start() {
+	if (_running) return;
+
+	if (pthread_create(&_thread, NULL, &worker, (void *) this) != 0) {
+		throw vz::VZException("Cannot start scheduler thread.");
+	}
+	_running = true;
+
+	PRINT(log_debug, "Started scheduler for %lu meters", "scheduler", (unsigned long)_timers.size());
+}
+
+void Scheduler::stop() {
+	if (!_running) return;
+
+	/* the thread sleeps in pthread_cond_timedwait(), a cancellation point */
+	pthread_cancel(_thread);
+	pthread_join(_thread, NULL);
+	_running = false;
+}
+
+int64_t Scheduler::wait(size_t index) {
+	waiter w = { this, index };
+	int64_t wall;
+
+	pthread_mutex_lock(&_mutex);
+	pthread_cleanup_push(&cleanup, &w);
+
+	_timers[index].waiting = true;
+	_timers[index].late = false;
+	while (!_timers[index].fired) {
+		pthread_cond_wait(&_cond, &_mutex);
+	}
+	_timers[index].fired = false;
+	wall = _origin_wall + (int64_t)_timers[index].tick * _resolution;
+
+	pthread_cleanup_pop(1);
+	return wall;
+}
+
+unsigned long Scheduler::overruns(size_t index) {
+	pthread_mutex_lock(&_mutex);
+	unsigned long n = _timers[index].overruns;
+	pthread_mutex_unlock(&_mutex);
+	return n;
+}
+
+unsigned long Scheduler::skipped(size_t index) {
+	pthread_mutex_lock(&_mutex);
+	unsigned long n = _timers[index].skipped;
+	pthread_mutex_unlock(&_mutex);
+	return n;
+}
+
+void *Scheduler::worker(void *arg) {
+	static_cast<Scheduler *>(arg)->run();
+	return NULL;
+}
+
+/**
+ * Leaving wait(), also when the meter thread is cancelled
+ */
+void Scheduler::cleanup(void *arg) {
+	waiter *w = static_cast<waiter *>(arg);
+	w->scheduler->_timers[w->timer].waiting = false;
+	pthread_mutex_unlock(&w->scheduler->_mutex);
+}
+
+void Scheduler::run() {
+	pthread_mutex_lock(&_mutex);
+	pthread_cleanup_push(&unlock_mutex, &_mutex);
+
+	for (;;) {
+		int64_t deadline = _origin_mono + (int64_t)next() * _resolution;
+		struct timespec ts;
+		ts.tv_sec = deadline / 1000000;
+		ts.tv_nsec = (deadline % 1000000) * 1000;
+
+		/* absolute deadline, time spent below does not shift the next tick */
+		pthread_cond_timedwait(&_wakeup, &_mutex, &ts);
+
+		/* wall clock was set, e.g. by the first NTP sync after boot */
+		int64_t step = (now(CLOCK_REALTIME) - now(CLOCK_MONOTONIC)) - (_origin_wall - _origin_mono);
+		if (llabs(step) >= _resolution) {
+			print(log_warning, "System time changed by %.1f s, aligning meters again", "scheduler", step / 1e6);
+			anchor();
+			for (size_t i = 0; i < _wheel.size(); i++) {
+				_wheel[i].clear();
+			}
+			for (size_t i = 0; i < _timers.size(); i++) {
+				if (_timers[i].active) schedule(i);
+			}
+		}
+
+		uint64_t last = current();
+		uint64_t from = _tick + 1;
+		if (last - _tick > SCHEDULER_SLOTS) {
+			from = last - SCHEDULER_SLOTS + 1; /* visit each slot once */
+		}
+		for (uint64_t t = from; t <= last; t++) {
+			expire(t % SCHEDULER_SLOTS, last);
+		}
+		_tick = last;
+	}
+
+	pthread_cleanup_pop(1);
+}
+
+int64_t Scheduler::now(clockid_t clock) {
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * Tick 0 is the last full second of the wall clock
+ */
+void Scheduler::anchor() {
+	int64_t wall = now(CLOCK_REALTIME);
+	int64_t mono = now(CLOCK_MONOTONIC);
+	int64_t frac = wall % 1000000;
+
+	_origin_wall = wall - frac;
+	_origin_mono = mono - frac;
+	_tick = current();
+}
+
+uint64_t Scheduler::current() {
+	return (now(CLOCK_MONOTONIC) - _origin_mono) / _resolution;
+}
+
+/**
+ * Put a timer on the wheel at the next multiple of its interval
+ */
+void Scheduler::schedule(size_t index) {
+	timer &t = _timers[index];
+	int64_t interval = t.interval * _resolution;
+	int64_t wall = _origin_wall + (now(CLOCK_MONOTONIC) - _origin_mono);
+	int64_t deadline = (wall / interval + 1) * interval;
+
+	t.due = (deadline - _origin_wall) / _resolution;
+	_wheel[t.due % SCHEDULER_SLOTS].push_back(index);
+}
+
+/**
+ * Tick of the earliest deadline, at most one turn of the wheel ahead
+ */
+uint64_t Scheduler::next() {
+	uint64_t due = _tick + SCHEDULER_SLOTS;
+	for (size_t i = 0; i < _timers.size(); i++) {
+		if (_timers[i].active && _timers[i].due < due) {
+			due = _timers[i].due;
+		}
+	}
+	return due;
+}
+
+/**
+ * Fire the timers of a slot which are due at tick last
+ */
+void Scheduler::expire(size_t slot, uint64_t last) {
+	std::list<size_t> &timers = _wheel[slot];
+	std::vector<size_t> expired;
+
+	for (std::list<size_t>::iterator it = timers.begin(); it != timers.end(); ) {
+		if (_timers[*it].due <= last) {
+			expired.push_back(*it);
+			it = timers.erase(it);
+		} else {
+			it++;
+		}
+	}
+
+	for (std::vector<size_t>::iterator it = expired.begin(); it != expired.end(); it++) {
+		timer &t = _timers[*it];
+
+		/* deadlines passed while the scheduler itself was delayed */
+		uint64_t missed = (last - t.due) / t.interval;
+		uint64_t tick = t.due + missed * t.interval;
+		t.skipped += missed;
+
+		if (t.waiting && !t.fired) {
+			t.fired = true;
+			t.tick = tick;
+		} else {
+			t.skipped++;
+			if (!t.late) {
+				t.late = true;
+				t.overruns++;
+				print(log_warning, "Reading takes longer than the interval, skipping tick", t.name.c_str());
+			}
+		}
+
+		t.due = tick + t.interval;
+		_wheel[t.due % SCHEDULER_SLOTS].push_back(*it);
+	}
+
+	if (!expired.empty()) {
+		pthread_cond_broadcast(&_cond);
+	}
+}
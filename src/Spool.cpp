@@ -0,0 +1,317 @@
+/**
+ * Persistent spool for unsent readings
+ *
+ * @package vzlogger
+ * @license http://opensource.org/licenses/gpl-license.php GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <vector>
+#include <algorithm>
+
+#include "common.h"
+#include <VZException.hpp>
+
+#include "Spool.hpp"
+
+Spool::Spool(const std::string &dir, const std::string &name, size_t records) :
+		_dir(dir)
+		, _name(name)
+		, _records(records > 0 ? records : 1)
+		, _size(0)
+		, _next_seq(0)
+{
+	recover();
+}
+
+Spool::~Spool() {
+	commit();
+	while (!_segments.empty()) {
+		unmap(_segments.front());
+		_segments.pop_front();
+	}
+}
+
+void Spool::append(const Reading &rd) {
+	if (_segments.empty() || _segments.back().count == _records) {
+		create();
+	}
+
+	segment &tail = _segments.back();
+	Reading *rec = &records(tail)[tail.count];
+	*rec = rd;
+	rec->id(0); /* identifiers are interned per process */
+
+	tail.count++;
+	_size++;
+}
+
+void Spool::commit() {
+	if (_segments.empty()) return;
+
+	sync(_segments.back());
+	if (_segments.size() > 1) {
+		sync(_segments.front()); /* ack pointer */
+	}
+}
+
+Reading *Spool::peek(size_t offset) {
+	if (_segments.empty()) return NULL;
+
+	segment &head = _segments.front();
+	if (head.acked + offset >= head.count) return NULL;
+
+	if (head.hdr == NULL) {
+		map(head);
+	}
+	return &records(head)[head.acked + offset];
+}
+
+void Spool::acknowledge(size_t n) {
+	while (n > 0 && !_segments.empty()) {
+		segment &head = _segments.front();
+		size_t k = std::min(n, (size_t)(head.count - head.acked));
+
+		head.acked += k;
+		_size -= k;
+		n -= k;
+
+		/* the tail is kept as long as readings can be appended */
+		if (head.acked < head.count || (_segments.size() == 1 && head.count < _records)) {
+			break;
+		}
+		remove_head();
+	}
+}
+
+std::string Spool::path(unsigned long seq) const {
+	char file[32];
+	snprintf(file, sizeof(file), ".%08lu.spool", seq);
+	return _dir + "/" + _name + file;
+}
+
+size_t Spool::mapping_size() const {
+	return sizeof(header) + _records * sizeof(Reading);
+}
+
+/**
+ * Scan the spool directory for segments of this spool
+ */
+void Spool::recover() {
+	std::vector<unsigned long> seqs;
+	std::string prefix = _name + ".";
+	DIR *dir = opendir(_dir.c_str());
+
+	if (dir == NULL) {
+		throw vz::VZException("Cannot open spool directory " + _dir + ": " + strerror(errno));
+	}
+
+	struct dirent *ent;
+	while ((ent = readdir(dir)) != NULL) {
+		const char *file = ent->d_name;
+		char *end;
+
+		if (strncmp(file, prefix.c_str(), prefix.length()) != 0) continue;
+		unsigned long seq = strtoul(file + prefix.length(), &end, 10);
+		if (end == file + prefix.length() || strcmp(end, ".spool") != 0) continue;
+
+		seqs.push_back(seq);
+	}
+	closedir(dir);
+	std::sort(seqs.begin(), seqs.end());
+	if (!seqs.empty()) {
+		_next_seq = seqs.back() + 1;
+	}
+
+	for (std::vector<unsigned long>::iterator it = seqs.begin(); it != seqs.end(); it++) {
+		segment seg = { *it, 0, 0, 0, -1, NULL };
+
+		try {
+			map(seg);
+		} catch (vz::VZException &e) {
+			print(log_warning, "Skipping spool segment: %s", NULL, e.what());
+			continue;
+		}
+
+		seg.count = std::min(seg.hdr->count, (uint64_t)_records);
+		seg.acked = std::min(seg.hdr->acked, seg.count);
+		seg.synced = seg.count;
+
+		if (seg.acked == seg.count && (seg.count == _records || it + 1 != seqs.end())) {
+			unmap(seg);
+			unlink(path(seg.seq).c_str());
+			continue;
+		}
+
+		/* one segment at a time, only head and tail stay mapped */
+		if (_segments.size() > 1) {
+			unmap(_segments.back());
+		}
+		_size += seg.count - seg.acked;
+		_segments.push_back(seg);
+	}
+
+	if (_size > 0) {
+		print(log_info, "Recovered %lu unsent readings from %lu spool segments", NULL,
+					(unsigned long)_size, (unsigned long)_segments.size());
+	}
+}
+
+/**
+ * Start a new tail segment
+ */
+void Spool::create() {
+	segment seg = { _next_seq++, 0, 0, 0, -1, NULL };
+	std::string file = path(seg.seq);
+
+	seg.fd = open(file.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (seg.fd < 0) {
+		throw vz::VZException("Cannot create spool segment " + file + ": " + strerror(errno));
+	}
+
+	/* reserve blocks now, a write to a sparse mapping on a full disk raises SIGBUS */
+	int err = posix_fallocate(seg.fd, 0, mapping_size());
+	if (err == EINVAL || err == EOPNOTSUPP) {
+		err = (ftruncate(seg.fd, mapping_size()) == 0) ? 0 : errno;
+	}
+	if (err != 0) {
+		close(seg.fd);
+		unlink(file.c_str());
+		throw vz::VZException("Cannot allocate spool segment " + file + ": " + strerror(err));
+	}
+
+	map(seg);
+
+	header *hdr = seg.hdr;
+	memset(hdr, 0, sizeof(header));
+	strncpy(hdr->magic, SPOOL_MAGIC, sizeof(hdr->magic));
+	hdr->version = SPOOL_VERSION;
+	hdr->record_size = sizeof(Reading);
+	hdr->records = _records;
+	msync(hdr, sizeof(header), MS_SYNC);
+
+	/* make the new directory entry durable */
+	int dirfd = open(_dir.c_str(), O_RDONLY);
+	if (dirfd >= 0) {
+		fsync(dirfd);
+		close(dirfd);
+	}
+
+	/* the previous tail is complete, release it unless it is still uploaded */
+	if (_segments.size() > 1) {
+		sync(_segments.back());
+		unmap(_segments.back());
+	}
+	_segments.push_back(seg);
+}
+
+void Spool::map(segment &seg) {
+	std::string file = path(seg.seq);
+	struct stat st;
+
+	if (seg.fd < 0) {
+		seg.fd = open(file.c_str(), O_RDWR);
+		if (seg.fd < 0) {
+			throw vz::VZException("Cannot open spool segment " + file + ": " + strerror(errno));
+		}
+	}
+
+	if (fstat(seg.fd, &st) != 0 || (size_t)st.st_size != mapping_size()) {
+		close(seg.fd);
+		seg.fd = -1;
+		throw vz::VZException("Invalid size of spool segment " + file);
+	}
+
+	void *addr = mmap(NULL, mapping_size(), PROT_READ | PROT_WRITE, MAP_SHARED, seg.fd, 0);
+	if (addr == MAP_FAILED) {
+		close(seg.fd);
+		seg.fd = -1;
+		throw vz::VZException("Cannot map spool segment " + file + ": " + strerror(errno));
+	}
+	seg.hdr = static_cast<header *>(addr);
+
+	/* freshly created segments are initialized by create() */
+	if (st.st_size > 0 && seg.hdr->magic[0] != '\0' && (
+				strncmp(seg.hdr->magic, SPOOL_MAGIC, sizeof(seg.hdr->magic)) != 0 ||
+				seg.hdr->version != SPOOL_VERSION ||
+				seg.hdr->record_size != sizeof(Reading) ||
+				seg.hdr->records != _records)) {
+		unmap(seg);
+		throw vz::VZException("Incompatible spool segment " + file);
+	}
+}
+
+void Spool::unmap(segment &seg) {
+	if (seg.hdr != NULL) {
+		munmap(seg.hdr, mapping_size());
+		seg.hdr = NULL;
+	}
+	if (seg.fd >= 0) {
+		close(seg.fd);
+		seg.fd = -1;
+	}
+}
+
+void Spool::remove_head() {
+	segment &head = _segments.front();
+
+	unmap(head);
+	if (unlink(path(head.seq).c_str()) != 0) {
+		print(log_warning, "Cannot remove spool segment: %s", NULL, strerror(errno));
+	}
+	_segments.pop_front();
+}
+
+/**
+ * Write back readings appended since the last sync, then the header
+ *
+ * The header is synced last so it never claims readings which are not on disk.
+ */
+void Spool::sync(segment &seg) {
+	if (seg.hdr == NULL) return;
+
+	char *base = reinterpret_cast<char *>(seg.hdr);
+	if (seg.count > seg.synced) {
+		size_t page = sysconf(_SC_PAGESIZE);
+		size_t from = (sizeof(header) + seg.synced * sizeof(Reading)) & ~(page - 1);
+		size_t to = sizeof(header) + seg.count * sizeof(Reading);
+
+		if (msync(base + from, to - from, MS_SYNC) != 0) {
+			print(log_error, "Cannot sync spool: %s", NULL, strerror(errno));
+			return;
+		}
+		seg.synced = seg.count;
+	}
+
+	if (seg.hdr->count != seg.count || seg.hdr->acked != seg.acked) {
+		seg.hdr->count = seg.count;
+		seg.hdr->acked = seg.acked;
+		if (msync(base, sizeof(header), MS_SYNC) != 0) {
+			print(log_error, "Cannot sync spool: %s", NULL, strerror(errno));
+		}
+	}
+}
@@ -0,0 +1,611 @@
+/**
+ * Pool of uploader threads
+ *
+ * @package vzlogger
+ * @license http://opensource.org/licenses/gpl-license.php GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <time.h>
+
+#include "common.h"
+#include <VZException.hpp>
+#include "Uploader.hpp"
+
+Uploader::Uploader()
+		: _stopping(false)
+		, _multi(NULL)
+		, _parallel(0)
+		, _backoff(HEALTH_DEFAULT_BACKOFF)
+		, _max_backoff(HEALTH_DEFAULT_MAX_BACKOFF)
+{
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC); /* backoff survives time changes */
+
+	pthread_mutex_init(&_mutex, NULL);
+	pthread_cond_init(&_cond, &attr);
+	pthread_cond_init(&_done, NULL);
+	pthread_condattr_destroy(&attr);
+}
+
+Uploader::~Uploader() {
+	stop();
+
+	/* channels keep a pointer to us */
+	for (std::vector<task>::iterator it = _jobs.begin(); it != _jobs.end(); it++) {
+		if (it->channel) it->channel->attach(NULL, 0);
+	}
+
+	pthread_cond_destroy(&_done);
+	pthread_cond_destroy(&_cond);
+	pthread_mutex_destroy(&_mutex);
+}
+
+void Uploader::backoff(int backoff, int max_backoff) {
+	pthread_mutex_lock(&_mutex);
+	_backoff = backoff;
+	_max_backoff = max_backoff;
+	pthread_mutex_unlock(&_mutex);
+}
+
+size_t Uploader::add(Channel::Ptr ch, vz::ApiIF::Ptr api) {
+	task t;
+	t.channel = ch;
+	t.api = api;
+	t.state = IDLE;
+	t.again = false;
+	t.host = -1;
+
+	std::string name = Health::host_of(api->middleware());
+
+	pthread_mutex_lock(&_mutex);
+	if (!name.empty()) {
+		for (size_t i = 0; i < _hosts.size(); i++) {
+			if (_hosts[i].health.host() == name) t.host = i;
+		}
+		if (t.host < 0) {
+			host h = { Health(name, (unsigned int)(time(NULL) ^ (_hosts.size() << 16))), std::deque<size_t>(), -1 };
+			_hosts.push_back(h);
+			t.host = _hosts.size() - 1;
+		}
+	}
+
+	/* slot of a removed channel is reused */
+	size_t job = 0;
+	while (job < _jobs.size() && _jobs[job].state != REMOVED) {
+		job++;
+	}
+	if (job < _jobs.size()) {
+		_jobs[job] = t;
+	} else {
+		_jobs.push_back(t);
+	}
+	pthread_mutex_unlock(&_mutex);
+
+	ch->attach(this, job);
+	return job;
+}
+
+void Uploader::remove(size_t job) {
+	Channel::Ptr ch;
+	vz::ApiIF::Ptr api; /* destroyed after the lock, it leaves its batch */
+
+	pthread_mutex_lock(&_mutex);
+	while (_jobs[job].state == RUNNING && !_threads.empty()) {
+		pthread_cond_wait(&_done, &_mutex);
+	}
+
+	task &t = _jobs[job];
+	if (t.state == QUEUED) {
+		_runq.erase(std::find(_runq.begin(), _runq.end(), job));
+	} else if (t.state == PARKED) {
+		std::deque<size_t> &parked = _hosts[t.host].parked;
+		parked.erase(std::find(parked.begin(), parked.end(), job));
+	}
+	if (t.host >= 0 && _hosts[t.host].probe == (long)job) {
+		_hosts[t.host].health.cancel();
+		_hosts[t.host].probe = -1;
+		pthread_cond_broadcast(&_cond); /* another parked channel probes */
+	}
+	ch = t.channel;
+	api = t.api;
+	t.state = REMOVED;
+	t.channel.reset();
+	t.api.reset();
+
+	while (!_jobs.empty() && _jobs.back().state == REMOVED) {
+		_jobs.pop_back();
+	}
+	pthread_mutex_unlock(&_mutex);
+
+	if (ch) {
+		ch->attach(NULL, 0);
+	}
+}
+
+void Uploader::start(int workers, int parallel) {
+	size_t n = (workers > 0) ? workers : 1;
+	if (n > _jobs.size()) n = _jobs.size();
+
+	_stopping = false;
+	if (parallel > 0) {
+		if (_threads.empty()) {
+			_multi = curl_multi_init();
+			if (_multi == NULL) {
+				throw vz::VZException("Cannot initialize curl multi interface.");
+			}
+			_parallel = parallel;
+
+			pthread_t thread;
+			if (pthread_create(&thread, NULL, &event_loop, (void *) this) != 0) {
+				throw vz::VZException("Cannot start uploader thread.");
+			}
+			_threads.push_back(thread);
+		}
+
+		PRINT(log_debug, "Started uploader for %lu parallel requests of %lu channels", "upload",
+					(unsigned long)_parallel, (unsigned long)_jobs.size());
+	} else {
+		while (_threads.size() < n) {
+			pthread_t thread;
+			if (pthread_create(&thread, NULL, &worker, (void *) this) != 0) {
+				throw vz::VZException("Cannot start uploader thread.");
+			}
+			_threads.push_back(thread);
+		}
+
+		PRINT(log_debug, "Started %lu uploader threads for %lu channels", "upload",
+					(unsigned long)_threads.size(), (unsigned long)_jobs.size());
+	}
+
+	/* send readings which have been published before the start */
+	for (size_t i = 0; i < _jobs.size(); i++) {
+		ready(i);
+	}
+}
+
+void Uploader::stop() {
+	pthread_mutex_lock(&_mutex);
+	_stopping = true;
+	pthread_cond_broadcast(&_cond);
+	wakeup();
+	pthread_mutex_unlock(&_mutex);
+
+	/* not cancelled, libcurl might hold a lock of the shared cache */
+	for (std::vector<pthread_t>::iterator it = _threads.begin(); it != _threads.end(); it++) {
+		pthread_join(*it, NULL);
+	}
+	_threads.clear();
+
+	if (_multi != NULL) {
+		pthread_mutex_lock(&_mutex);
+		CURLM *multi = _multi;
+		_multi = NULL;
+		pthread_mutex_unlock(&_mutex);
+		curl_multi_cleanup(multi);
+	}
+
+	/* jobs left over are sent again after a restart */
+	_runq.clear();
+	for (std::vector<task>::iterator it = _jobs.begin(); it != _jobs.end(); it++) {
+		if (it->state != REMOVED) it->state = IDLE;
+		it->again = false;
+	}
+
+	/* the health of the hosts is kept, start() parks their channels again */
+	for (std::vector<host>::iterator it = _hosts.begin(); it != _hosts.end(); it++) {
+		it->health.cancel();
+		it->parked.clear();
+		it->probe = -1;
+	}
+}
+
+void Uploader::ready(size_t job) {
+	pthread_mutex_lock(&_mutex);
+	if (job >= _jobs.size()) {
+		/* channel has been removed meanwhile */
+		pthread_mutex_unlock(&_mutex);
+		return;
+	}
+	task &t = _jobs[job];
+	if (t.state == IDLE) {
+		if (admit(job)) {
+			t.state = QUEUED;
+			_runq.push_back(job);
+			pthread_cond_signal(&_cond);
+			wakeup();
+		} else {
+			park(job);
+		}
+	} else if (t.state == RUNNING) {
+		t.again = true;
+	}
+	pthread_mutex_unlock(&_mutex);
+}
+
+long Uploader::next(bool block) {
+	long job = -1;
+
+	pthread_mutex_lock(&_mutex);
+	while (!_stopping) {
+		release(now());
+		if (!_runq.empty()) {
+			job = _runq.front();
+			_runq.pop_front();
+			_jobs[job].state = RUNNING;
+			_jobs[job].again = false;
+			break;
+		}
+		if (!block) break;
+
+		/* scheduled wait for the end of the next backoff instead of a sleeping worker */
+		int64_t until = deadline();
+		if (until < 0) {
+			pthread_cond_wait(&_cond, &_mutex);
+		} else {
+			struct timespec ts;
+			ts.tv_sec = until / 1000000;
+			ts.tv_nsec = (until % 1000000) * 1000;
+			pthread_cond_timedwait(&_cond, &_mutex, &ts);
+		}
+	}
+	pthread_mutex_unlock(&_mutex);
+
+	return job;
+}
+
+void Uploader::done(size_t job, bool again) {
+	pthread_mutex_lock(&_mutex);
+	task &t = _jobs[job];
+	if (t.host >= 0 && _hosts[t.host].probe == (long)job) {
+		/* probe without a request, e.g. nothing left to send: the next one probes */
+		_hosts[t.host].health.cancel();
+		_hosts[t.host].probe = -1;
+	}
+
+	if (t.host >= 0 && _hosts[t.host].health.state() != Health::CLOSED
+			&& t.channel->pending() > 0) {
+		/* readings stay queued until the host recovers */
+		park(job);
+		pthread_cond_broadcast(&_cond);
+	} else if (again || t.again) {
+		/* to the end of the queue, so one backlog does not starve the other channels */
+		t.state = QUEUED;
+		_runq.push_back(job);
+		pthread_cond_signal(&_cond);
+	} else {
+		t.state = IDLE;
+	}
+	t.again = false;
+	pthread_cond_broadcast(&_done);
+	pthread_mutex_unlock(&_mutex);
+}
+
+size_t Uploader::queued() {
+	pthread_mutex_lock(&_mutex);
+	size_t n = _runq.size();
+	pthread_mutex_unlock(&_mutex);
+	return n;
+}
+
+size_t Uploader::parked() {
+	size_t n = 0;
+	pthread_mutex_lock(&_mutex);
+	for (std::vector<host>::iterator it = _hosts.begin(); it != _hosts.end(); it++) {
+		n += it->parked.size();
+	}
+	pthread_mutex_unlock(&_mutex);
+	return n;
+}
+
+Health::state_t Uploader::health(size_t job) {
+	pthread_mutex_lock(&_mutex);
+	long h = _jobs[job].host;
+	Health::state_t state = (h >= 0) ? _hosts[h].health.state() : Health::CLOSED;
+	pthread_mutex_unlock(&_mutex);
+	return state;
+}
+
+bool Uploader::process(size_t job) {
+	/* add() might grow the job list meanwhile */
+	pthread_mutex_lock(&_mutex);
+	Channel::Ptr ch = _jobs[job].channel;
+	vz::ApiIF::Ptr api = _jobs[job].api;
+	pthread_mutex_unlock(&_mutex);
+
+	try {
+		ch->persist();
+
+		/* a spooled backlog is sent segment by segment, go on as long as it shrinks */
+		size_t pending = ch->pending();
+
+		/* any answer of the middleware counts, even an error for this channel */
+		if (api->send()) report(job, true);
+		return ch->pending() > 0 && ch->pending() < pending;
+	}
+	catch (vz::ConnectionException &e) {
+		print(log_error, "Upload failed due to: %s", ch->name(), e.what());
+		report(job, false);
+	}
+	catch (std::exception &e) {
+		print(log_error, "Upload failed due to: %s", ch->name(), e.what());
+	}
+	return false;
+}
+
+/**
+ * Start sending the readings of a channel with the event loop
+ *
+ * @return easy handle of the request or NULL if the job has been finished
+ */
+CURL *Uploader::begin(size_t job, size_t &pending) {
+	pthread_mutex_lock(&_mutex);
+	Channel::Ptr ch = _jobs[job].channel;
+	vz::ApiIF::Ptr api = _jobs[job].api;
+	pthread_mutex_unlock(&_mutex);
+
+	if (!api->asynchronous()) {
+		/* sent within the loop, the other requests wait meanwhile */
+		done(job, process(job));
+		return NULL;
+	}
+
+	try {
+		ch->persist();
+
+		pending = ch->pending();
+		CURL *handle = api->prepare();
+		if (handle != NULL) return handle;
+
+		/* nothing to send, e.g. duplicates only */
+		done(job, ch->pending() > 0 && ch->pending() < pending);
+		return NULL;
+	}
+	catch (std::exception &e) {
+		print(log_error, "Upload failed due to: %s", ch->name(), e.what());
+	}
+	done(job, false);
+	return NULL;
+}
+
+/**
+ * Request of the event loop has finished, counterpart of process()
+ */
+bool Uploader::complete(size_t job, size_t pending, CURLcode code) {
+	pthread_mutex_lock(&_mutex);
+	Channel::Ptr ch = _jobs[job].channel;
+	vz::ApiIF::Ptr api = _jobs[job].api;
+	pthread_mutex_unlock(&_mutex);
+
+	try {
+		api->complete(code);
+
+		report(job, true);
+		return ch->pending() > 0 && ch->pending() < pending;
+	}
+	catch (vz::ConnectionException &e) {
+		print(log_error, "Upload failed due to: %s", ch->name(), e.what());
+		report(job, false);
+	}
+	catch (std::exception &e) {
+		print(log_error, "Upload failed due to: %s", ch->name(), e.what());
+	}
+	return false;
+}
+
+/**
+ * Interrupt curl_multi_poll() of the event loop, called with the lock held
+ */
+void Uploader::wakeup() {
+#if LIBCURL_VERSION_NUM >= 0x074400 /* 7.68.0 */
+	if (_multi != NULL) curl_multi_wakeup(_multi);
+#endif
+}
+
+int64_t Uploader::now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * May the job be queued? The first job after the backoff becomes the probe
+ */
+bool Uploader::admit(size_t job) {
+	long h = _jobs[job].host;
+	if (h < 0 || _hosts[h].health.state() == Health::CLOSED) {
+		return true;
+	}
+
+	if (_hosts[h].health.admit(now())) {
+		_hosts[h].probe = job;
+		print(log_info, "Probing middleware %s", _jobs[job].channel->name(),
+					_hosts[h].health.host().c_str());
+		return true;
+	}
+	return false;
+}
+
+void Uploader::park(size_t job) {
+	_jobs[job].state = PARKED;
+	_hosts[_jobs[job].host].parked.push_back(job);
+}
+
+/**
+ * Queue the oldest parked job of each host whose backoff has passed
+ */
+void Uploader::release(int64_t now) {
+	for (std::vector<host>::iterator it = _hosts.begin(); it != _hosts.end(); it++) {
+		if (it->parked.empty() || it->health.state() != Health::OPEN || now < it->health.retry_at()) {
+			continue;
+		}
+
+		size_t job = it->parked.front();
+		it->parked.pop_front();
+		if (admit(job)) {
+			_jobs[job].state = QUEUED;
+			_runq.push_back(job);
+		} else {
+			it->parked.push_front(job);
+		}
+	}
+}
+
+/**
+ * End of the earliest backoff with parked jobs, -1 if there is none
+ */
+int64_t Uploader::deadline() {
+	int64_t until = -1;
+	for (std::vector<host>::iterator it = _hosts.begin(); it != _hosts.end(); it++) {
+		if (it->parked.empty() || it->health.state() != Health::OPEN) continue;
+		if (until < 0 || it->health.retry_at() < until) {
+			until = it->health.retry_at();
+		}
+	}
+	return until;
+}
+
+/**
+ * Outcome of a request, closes or opens the circuit breaker of the host
+ */
+void Uploader::report(size_t job, bool ok) {
+	pthread_mutex_lock(&_mutex);
+	long h = _jobs[job].host;
+	if (h >= 0) {
+		host &hst = _hosts[h];
+		const char *name = _jobs[job].channel->name();
+
+		if (ok && hst.health.success()) {
+			print(log_info, "Middleware %s is back, resuming %lu channels", name,
+						hst.health.host().c_str(), (unsigned long)hst.parked.size());
+			while (!hst.parked.empty()) {
+				_jobs[hst.parked.front()].state = QUEUED;
+				_runq.push_back(hst.parked.front());
+				hst.parked.pop_front();
+			}
+			pthread_cond_broadcast(&_cond);
+		} else if (!ok && hst.health.failure(now(), _backoff, _max_backoff)) {
+			print(log_warning, "Middleware %s failed %u times, next attempt in %.1f s", name,
+						hst.health.host().c_str(), hst.health.failures(),
+						(hst.health.retry_at() - now()) / 1e6);
+
+			/* channels queued for the host wait for the probe */
+			for (std::deque<size_t>::iterator it = _runq.begin(); it != _runq.end(); ) {
+				if (_jobs[*it].host == h) {
+					park(*it);
+					it = _runq.erase(it);
+				} else {
+					it++;
+				}
+			}
+		}
+		if (hst.probe == (long)job) {
+			hst.probe = -1;
+		}
+	}
+	pthread_mutex_unlock(&_mutex);
+}
+
+void *Uploader::worker(void *arg) {
+	static_cast<Uploader *>(arg)->run();
+	return NULL;
+}
+
+void Uploader::run() {
+	long job;
+
+	while ((job = next()) >= 0) {
+		done(job, process(job));
+	}
+	PRINT(log_debug, "Stopped uploader thread", "upload");
+}
+
+void *Uploader::event_loop(void *arg) {
+	static_cast<Uploader *>(arg)->run_multi();
+	return NULL;
+}
+
+void Uploader::run_multi() {
+	std::map<CURL *, request> requests;
+	CURLM *multi = _multi;
+	long job;
+
+	for (;;) {
+		/* wait for a job only while no request is in flight */
+		while (requests.size() < _parallel && (job = next(requests.empty())) >= 0) {
+			request rq = { (size_t)job, 0 };
+			CURL *handle = begin(job, rq.pending);
+			if (handle == NULL) continue;
+
+			CURLMcode rc = curl_multi_add_handle(multi, handle);
+			if (rc != CURLM_OK) {
+				print(log_error, "Upload failed due to: %s", "upload", curl_multi_strerror(rc));
+				done(job, false);
+				continue;
+			}
+			requests[handle] = rq;
+		}
+
+		pthread_mutex_lock(&_mutex);
+		bool stopping = _stopping;
+		int64_t until = deadline();
+		pthread_mutex_unlock(&_mutex);
+		if (stopping) break;
+
+		int running;
+		curl_multi_perform(multi, &running);
+
+		CURLMsg *msg;
+		int left;
+		while ((msg = curl_multi_info_read(multi, &left)) != NULL) {
+			if (msg->msg != CURLMSG_DONE) continue;
+
+			CURL *handle = msg->easy_handle;
+			CURLcode code = msg->data.result;
+			curl_multi_remove_handle(multi, handle); /* invalidates msg */
+
+			std::map<CURL *, request>::iterator it = requests.find(handle);
+			if (it == requests.end()) continue;
+			request rq = it->second;
+			requests.erase(it);
+
+			done(rq.job, complete(rq.job, rq.pending, code));
+		}
+		if (requests.empty()) continue;
+
+		/* the poll returns early for channels becoming ready and for the end of a backoff */
+		int timeout = 1000;
+		if (until >= 0) {
+			int64_t ms = (until - now()) / 1000;
+			if (ms < timeout) timeout = (ms > 0) ? ms : 0;
+		}
+#if LIBCURL_VERSION_NUM >= 0x074400 /* 7.68.0 */
+		curl_multi_poll(multi, NULL, 0, timeout, NULL);
+#else
+		curl_multi_wait(multi, NULL, 0, std::min(timeout, 100), NULL);
+#endif
+	}
+
+	/* interrupted requests are sent again after a restart */
+	for (std::map<CURL *, request>::iterator it = requests.begin(); it != requests.end(); it++) {
+		curl_multi_remove_handle(multi, it->first);
+	}
+	PRINT(log_debug, "Stopped uploader thread", "upload");
+}
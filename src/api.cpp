@@ -52,17 +52,17 @@ int curl_custom_debug_callback(
 			case CURLINFO_TEXT:
 			case CURLINFO_END:
 				if (end) *end = '\0'; /* terminate without \n */
-				print((log_level_t)(log_debug+5), "CURL: %.*s", ch->name(), (int) size, data);
+				PRINT((log_level_t)(log_debug+5), "CURL: %.*s", ch->name(), (int) size, data);
 				break;
 
 			case CURLINFO_SSL_DATA_IN:
 			case CURLINFO_DATA_IN:
-				print((log_level_t)(log_debug+5), "CURL: Received %lu bytes", ch->name(), (unsigned long) size);
+				PRINT((log_level_t)(log_debug+5), "CURL: Received %lu bytes", ch->name(), (unsigned long) size);
 				break;
 
 			case CURLINFO_SSL_DATA_OUT:
 			case CURLINFO_DATA_OUT:
-				print((log_level_t)(log_debug+5), "CURL: Sent %lu bytes.. ", ch->name(), (unsigned long) size);
+				PRINT((log_level_t)(log_debug+5), "CURL: Sent %lu bytes.. ", ch->name(), (unsigned long) size);
 				break;
 
 			case CURLINFO_HEADER_IN:
@@ -95,7 +95,7 @@ json_object * api_json_tuples(Buffer::Ptr buf) {
 	json_object *json_tuples = json_object_new_array();
 	Buffer::iterator it;
 
-	print(log_debug, "==> number of tuples: %d", "api", buf->size());
+	PRINT(log_debug, "==> number of tuples: %d", "api", buf->size());
 
 	for (it = buf->begin(); it != buf->end(); it++) {
 		struct json_object *json_tuple = json_object_new_array();
@@ -0,0 +1,56 @@
+/***********************************************************************/
+/** @file ApiIF.cpp
+ * Factory for the api implementations
+ *
+ * @copyright Copyright (c) 2011, The volkszaehler.org project
+ * @package vzlogger
+ * @license http://opensource.org/licenses/gpl-license.php GNU Public License
+ **/
+/*---------------------------------------------------------------------*/
+
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ApiIF.hpp>
+#include <api/Volkszaehler.hpp>
+#include <api/MySmartGrid.hpp>
+#include <api/Null.hpp>
+
+vz::ApiIF::Ptr vz::ApiIF::create(Channel::Ptr ch) {
+	// NOTE: additional APIs only need to be added here
+	if (ch->apiProtocol() == "mysmartgrid") {
+		PRINT(log_debug, "Using MySmartGrid api.", ch->name());
+		return vz::ApiIF::Ptr(new vz::api::MySmartGrid(ch, ch->options()));
+	}
+	else if (ch->apiProtocol() == "null") {
+		PRINT(log_debug, "Using null api- meter data available via local httpd if enabled.", ch->name());
+		return vz::ApiIF::Ptr(new vz::api::Null(ch, ch->options()));
+	}
+
+	// default == volkszaehler
+	PRINT(log_debug, "Using default volkszaehler api.", ch->name());
+	return vz::ApiIF::Ptr(new vz::api::Volkszaehler(ch, ch->options()));
+}
+
+/*
+ * Local variables:
+ *  tab-width: 2
+ *  c-indent-level: 2
+ *  c-basic-offset: 2
+ *  project-name: vzlogger
+ * End:
+ */
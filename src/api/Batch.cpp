@@ -0,0 +1,130 @@
+/**
+ * Channels of a middleware uploading in one request
+ *
+ * @package vzlogger
+ * @license http://opensource.org/licenses/gpl-license.php GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include <api/Batch.hpp>
+#include <api/Volkszaehler.hpp>
+
+pthread_mutex_t vz::api::Batch::_mutex = PTHREAD_MUTEX_INITIALIZER;
+std::map<std::string, vz::weak_ptr<vz::api::Batch> > vz::api::Batch::_batches;
+
+vz::api::Batch::Ptr vz::api::Batch::get(const std::string &url, size_t tuples, size_t bytes) {
+	pthread_mutex_lock(&_mutex);
+	Ptr batch = _batches[url].lock();
+	if (!batch) {
+		batch = Ptr(new Batch(url, tuples, bytes));
+		_batches[url] = batch;
+	}
+	pthread_mutex_unlock(&_mutex);
+
+	return batch;
+}
+
+size_t vz::api::Batch::batches() {
+	size_t n = 0;
+
+	pthread_mutex_lock(&_mutex);
+	for (std::map<std::string, vz::weak_ptr<Batch> >::iterator it = _batches.begin(); it != _batches.end(); it++) {
+		if (!it->second.expired()) n++;
+	}
+	pthread_mutex_unlock(&_mutex);
+
+	return n;
+}
+
+vz::api::Batch::Batch(const std::string &url, size_t tuples, size_t bytes)
+		: _url(url)
+		, _tuples(tuples)
+		, _bytes(bytes)
+		, _busy(false)
+{
+	pthread_mutex_init(&_lock, NULL);
+}
+
+vz::api::Batch::~Batch() {
+	pthread_mutex_destroy(&_lock);
+
+	pthread_mutex_lock(&_mutex);
+	std::map<std::string, vz::weak_ptr<Batch> >::iterator it = _batches.find(_url);
+	if (it != _batches.end() && it->second.expired()) {
+		_batches.erase(it);
+	}
+	pthread_mutex_unlock(&_mutex);
+}
+
+void vz::api::Batch::join(Volkszaehler *member) {
+	pthread_mutex_lock(&_lock);
+	_members.push_back(member);
+	pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * Called by the destructor of the member, which may run while the sender
+ * waits for the uploader, so it must not block until the request is done.
+ */
+void vz::api::Batch::leave(Volkszaehler *member) {
+	pthread_mutex_lock(&_lock);
+	_members.erase(std::remove(_members.begin(), _members.end(), member), _members.end());
+
+	std::vector<Volkszaehler *>::iterator it = std::find(_sent.begin(), _sent.end(), member);
+	if (it != _sent.end()) {
+		/* acknowledged by the sender, if the request succeeds */
+		if (member->_cursor > 0) {
+			_handed.push_back(std::make_pair(member->channel(), member->_cursor));
+		}
+		*it = NULL;
+	}
+	pthread_mutex_unlock(&_lock);
+}
+
+bool vz::api::Batch::acquire() {
+	pthread_mutex_lock(&_lock);
+	bool acquired = !_busy;
+	_busy = true;
+	pthread_mutex_unlock(&_lock);
+
+	return acquired;
+}
+
+void vz::api::Batch::release() {
+	std::vector<std::pair<Channel::Ptr, size_t> > handed;
+
+	pthread_mutex_lock(&_lock);
+	_busy = false;
+	_sent.clear();
+	handed.swap(_handed); /* the last reference to their channels, dropped outside the lock */
+	pthread_mutex_unlock(&_lock);
+}
+
+std::vector<vz::api::Volkszaehler *> &vz::api::Batch::begin(Volkszaehler *first) {
+	_sent = _members;
+
+	/* the others follow in a stable order, so the tuples of a channel truncated
+	   by the limits come first with the next request it starts */
+	std::vector<Volkszaehler *>::iterator it = std::find(_sent.begin(), _sent.end(), first);
+	if (it != _sent.end()) {
+		std::rotate(_sent.begin(), it, _sent.end());
+	}
+	return _sent;
+}
@@ -49,6 +49,11 @@ void vz::api::CurlIF::clearHeader() {
 		curl_slist_free_all(_headers);
 	_headers=NULL;
 }
+void vz::api::CurlIF::share(const std::string &url) {
+	_share = CurlShare::get(url);
+	_share->attach(_curl);
+}
+
 void vz::api::CurlIF::commitHeader() {
 	if (_headers != NULL )
 		curl_easy_setopt(handle(), CURLOPT_HTTPHEADER, _headers);
@@ -0,0 +1,115 @@
+/**
+ * Caches shared by all CURL handles of a middleware host
+ *
+ * @package vzlogger
+ * @license http://opensource.org/licenses/gpl-license.php GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <VZException.hpp>
+#include <Health.hpp>
+#include <api/CurlShare.hpp>
+
+pthread_mutex_t vz::api::CurlShare::_mutex = PTHREAD_MUTEX_INITIALIZER;
+std::map<std::string, vz::weak_ptr<vz::api::CurlShare> > vz::api::CurlShare::_shares;
+
+vz::api::CurlShare::Ptr vz::api::CurlShare::get(const std::string &url) {
+	std::string host = Health::host_of(url);
+
+	pthread_mutex_lock(&_mutex);
+	Ptr share = _shares[host].lock();
+	if (!share) {
+		try {
+			share = Ptr(new CurlShare(host));
+		} catch (vz::VZException &e) {
+			pthread_mutex_unlock(&_mutex);
+			throw;
+		}
+		_shares[host] = share;
+	}
+	pthread_mutex_unlock(&_mutex);
+
+	return share;
+}
+
+size_t vz::api::CurlShare::hosts() {
+	size_t n = 0;
+
+	pthread_mutex_lock(&_mutex);
+	for (std::map<std::string, vz::weak_ptr<CurlShare> >::iterator it = _shares.begin(); it != _shares.end(); it++) {
+		if (!it->second.expired()) n++;
+	}
+	pthread_mutex_unlock(&_mutex);
+
+	return n;
+}
+
+vz::api::CurlShare::CurlShare(const std::string &host)
+		: _host(host)
+{
+	_share = curl_share_init();
+	if (!_share) {
+		throw vz::VZException("CURL: cannot create share handle.");
+	}
+
+	for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+		pthread_mutex_init(&_locks[i], NULL);
+	}
+
+	/* uploader workers use the handles of one host concurrently */
+	curl_share_setopt(_share, CURLSHOPT_LOCKFUNC, &lock);
+	curl_share_setopt(_share, CURLSHOPT_UNLOCKFUNC, &unlock);
+	curl_share_setopt(_share, CURLSHOPT_USERDATA, this);
+
+	curl_share_setopt(_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+	curl_share_setopt(_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x073900 /* 7.57.0 */
+	curl_share_setopt(_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+}
+
+vz::api::CurlShare::~CurlShare() {
+	/* all handles have been cleaned up, they hold a reference */
+	curl_share_cleanup(_share);
+
+	for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+		pthread_mutex_destroy(&_locks[i]);
+	}
+
+	pthread_mutex_lock(&_mutex);
+	std::map<std::string, vz::weak_ptr<CurlShare> >::iterator it = _shares.find(_host);
+	if (it != _shares.end() && it->second.expired()) {
+		_shares.erase(it);
+	}
+	pthread_mutex_unlock(&_mutex);
+}
+
+void vz::api::CurlShare::attach(CURL *curl) {
+	curl_easy_setopt(curl, CURLOPT_SHARE, _share);
+
+	/* keep idle connections to the middleware alive between two uploads */
+	curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+}
+
+void vz::api::CurlShare::lock(CURL *curl, curl_lock_data data, curl_lock_access access, void *arg) {
+	pthread_mutex_lock(&static_cast<CurlShare *>(arg)->_locks[data]);
+}
+
+void vz::api::CurlShare::unlock(CURL *curl, curl_lock_data data, void *arg) {
+	pthread_mutex_unlock(&static_cast<CurlShare *>(arg)->_locks[data]);
+}
@@ -0,0 +1,227 @@
+/**
+ * Streaming JSON serializer for request bodies
+ *
+ * @package vzlogger
+ * @license http://opensource.org/licenses/gpl-license.php GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <VZException.hpp>
+#include <api/JsonWriter.hpp>
+
+#define JSON_MAX_DECIMALS 9			/* fixed point up to this many decimals, else %g */
+
+vz::api::JsonWriter::JsonWriter(size_t capacity)
+		: _data(NULL)
+		, _size(0)
+		, _capacity(0)
+		, _comma(false)
+{
+	reserve((capacity > 0) ? capacity : 1);
+	terminate();
+}
+
+vz::api::JsonWriter::~JsonWriter() {
+	free(_data);
+}
+
+void vz::api::JsonWriter::clear() {
+	_size = 0;
+	_comma = false;
+	terminate();
+}
+
+void vz::api::JsonWriter::open_array() {
+	separator();
+	reserve(1);
+	append('[');
+	terminate();
+	_comma = false;
+}
+
+void vz::api::JsonWriter::close_array() {
+	reserve(1);
+	append(']');
+	terminate();
+	_comma = true;
+}
+
+void vz::api::JsonWriter::open_object() {
+	separator();
+	reserve(1);
+	append('{');
+	terminate();
+	_comma = false;
+}
+
+void vz::api::JsonWriter::close_object() {
+	reserve(1);
+	append('}');
+	terminate();
+	_comma = true;
+}
+
+void vz::api::JsonWriter::key(const char *name) {
+	string(name);
+	reserve(1);
+	append(':');
+	terminate();
+	_comma = false;
+}
+
+void vz::api::JsonWriter::string(const char *value) {
+	static const char hex[] = "0123456789abcdef";
+
+	separator();
+	reserve(strlen(value) * 6 + 2); /* worst case: all control characters */
+	append('"');
+	for (const unsigned char *c = (const unsigned char *) value; *c != '\0'; c++) {
+		if (*c == '"' || *c == '\\') {
+			append('\\');
+			append(*c);
+		} else if (*c < 0x20) {
+			append('\\');
+			append('u');
+			append('0');
+			append('0');
+			append(hex[*c >> 4]);
+			append(hex[*c & 0xf]);
+		} else {
+			append(*c);
+		}
+	}
+	append('"');
+	terminate();
+	_comma = true;
+}
+
+void vz::api::JsonWriter::integer(int64_t value) {
+	separator();
+	reserve(JSON_NUMBER_LEN);
+	uint64_t magnitude = (value < 0) ? (uint64_t)(-(value + 1)) + 1 : (uint64_t) value;
+	_size += format(_data + _size, value < 0, magnitude, 0);
+	terminate();
+	_comma = true;
+}
+
+void vz::api::JsonWriter::number(double value) {
+	separator();
+	reserve(JSON_NUMBER_LEN);
+	_size += format(_data + _size, value);
+	terminate();
+	_comma = true;
+}
+
+void vz::api::JsonWriter::tuple(int64_t timestamp, double value) {
+	separator();
+	reserve(2 * JSON_NUMBER_LEN + 3);
+	append('[');
+	uint64_t magnitude = (timestamp < 0) ? (uint64_t)(-(timestamp + 1)) + 1 : (uint64_t) timestamp;
+	_size += format(_data + _size, timestamp < 0, magnitude, 0);
+	append(',');
+	_size += format(_data + _size, value);
+	append(']');
+	terminate();
+	_comma = true;
+}
+
+/**
+ * Values of meters have a few decimals at most: find the fewest decimals
+ * which read back exactly and print them as integer with a decimal point.
+ * Other values take the shortest of 15 to 17 significant digits.
+ */
+size_t vz::api::JsonWriter::format(char *out, double value) {
+	if (!isfinite(value)) {
+		memcpy(out, "null", 4);
+		return 4;
+	}
+
+	double magnitude = fabs(value);
+	double scale = 1;
+	for (int decimals = 0; decimals <= JSON_MAX_DECIMALS; decimals++, scale *= 10) {
+		double scaled = magnitude * scale;
+		if (scaled >= 9007199254740992.0) { /* 2^53, integers beyond are not exact */
+			break;
+		}
+
+		/* the division is rounded like strtod() reading the decimal */
+		double digits = floor(scaled + 0.5);
+		if (digits / scale == magnitude) {
+			return format(out, signbit(value) != 0, (uint64_t) digits, decimals);
+		}
+	}
+
+	int len = 0;
+	for (int precision = 15; precision <= 17; precision++) {
+		len = snprintf(out, JSON_NUMBER_LEN, "%.*g", precision, value);
+		if (strtod(out, NULL) == value) break;
+	}
+	return len;
+}
+
+size_t vz::api::JsonWriter::format(char *out, bool negative, uint64_t digits, int decimals) {
+	char reversed[24];
+	int n = 0;
+
+	/* at least one digit in front of the decimal point */
+	do {
+		reversed[n++] = '0' + digits % 10;
+		digits /= 10;
+	} while (digits > 0 || n <= decimals);
+
+	size_t len = 0;
+	if (negative) out[len++] = '-';
+	while (n > 0) {
+		if (n == decimals) out[len++] = '.';
+		out[len++] = reversed[--n];
+	}
+	return len;
+}
+
+void vz::api::JsonWriter::separator() {
+	if (_comma) {
+		reserve(1);
+		append(',');
+	}
+}
+
+/**
+ * Room for n more characters and the terminating zero
+ */
+void vz::api::JsonWriter::reserve(size_t n) {
+	if (_size + n + 1 <= _capacity) {
+		return;
+	}
+
+	size_t capacity = (_capacity > 0) ? _capacity : 1;
+	while (capacity < _size + n + 1) {
+		capacity *= 2;
+	}
+
+	char *data = (char *) realloc(_data, capacity);
+	if (data == NULL) {
+		throw vz::VZException("Cannot allocate memory for the request body.");
+	}
+	_data = data;
+	_capacity = capacity;
+}
@@ -52,13 +52,14 @@ vz::api::MySmartGrid::MySmartGrid(
 		, _channelType(chn_type_device)
 		, _scaler(1)
 		, _response(new vz::api::CurlResponse())
+		, _cursor(0)
 		, _first_ts(0)
 		, _first_counter(0)
 		, _last_counter(0)
 
 {
 	OptionList optlist;
-	print(log_debug, "===> Create MySmartGrid-API", channel()->name());
+	PRINT(log_debug, "===> Create MySmartGrid-API", channel()->name());
 	char url[255];
   unsigned short curlTimeout = 30; // 30 seconds
 
@@ -112,7 +113,7 @@ vz::api::MySmartGrid::MySmartGrid(
 				break;
 	}
 
-	print(log_debug, "msg_api_init() %s", channel()->name(), url);
+	PRINT(log_debug, "msg_api_init() %s", channel()->name(), url);
 
 	_api_header();
 
@@ -120,6 +121,7 @@ vz::api::MySmartGrid::MySmartGrid(
 	curl_easy_setopt(_curlIF.handle(), CURLOPT_SSL_VERIFYHOST, 0L);
 
 	curl_easy_setopt(_curlIF.handle(), CURLOPT_URL, url);
+	_curlIF.share(middleware());
 
 // CurlCallback::write_callback requires CurlResponse* as data
 	curl_easy_setopt(_curlIF.handle(), CURLOPT_WRITEFUNCTION, &(vz::api::CurlCallback::write_callback));
@@ -142,9 +144,9 @@ vz::api::MySmartGrid::~MySmartGrid()
 {
 }
 
-void vz::api::MySmartGrid::send()
+bool vz::api::MySmartGrid::send()
 {
-	json_object *json_obj;
+	json_object *json_obj = NULL;
 	char digest[255];
 
 	const char *json_str;
@@ -156,27 +158,27 @@ void vz::api::MySmartGrid::send()
 
 	if (_first_ts>0) {
 		if ((now-first_ts()) < interval() ) {
-			print(log_debug, "api-MySmartGrid, skip message.", "");
-			return;
+			PRINT(log_debug, "api-MySmartGrid, skip message.", "");
+			return false;
 		}
 	} else { // _first_ts = 0
 	}
 
 	switch(_channelType) {
 			case chn_type_device:
-				json_obj = _apiDevice(channel()->buffer());
+				json_obj = _apiDevice();
+				json_str = json_object_to_json_string(json_obj);
 				break;
 			case chn_type_sensor:
-				json_obj = _apiSensor(channel()->buffer());
+				json_str = _apiSensor() ? _body.c_str() : NULL;
 				break;
 	}
-	json_str = json_object_to_json_string(json_obj);
 	if (json_str == NULL || strcmp(json_str, "null")==0) {
-		print(log_debug, "JSON request body is null. Nothing to send now.", channel()->name());
-		return;
+		PRINT(log_debug, "JSON request body is null. Nothing to send now.", channel()->name());
+		return false;
 	}
 
-	print(log_debug, "JSON request body: '%s'", channel()->name(), json_str);
+	PRINT(log_debug, "JSON request body: '%s'", channel()->name(), json_str);
 
 /* initialize response */
 	_response->clear_response();
@@ -186,7 +188,7 @@ void vz::api::MySmartGrid::send()
 	_api_header();
 	hmac_sha1(digest, (const unsigned char*)json_str, strlen(json_str));
 	_curlIF.addHeader(digest);
-	print(log_debug, "Header_Digest: %s", channel()->name(), digest);
+	PRINT(log_debug, "Header_Digest: %s", channel()->name(), digest);
 
 	_curlIF.commitHeader();
 
@@ -195,11 +197,11 @@ void vz::api::MySmartGrid::send()
 
 /* check response */
 	if (curl_code == CURLE_OK && http_code == 200) { /* everything is ok */
-		print(log_debug, "Request succeeded with code: %i", channel()->name(), http_code);
-		_values.clear();
+		PRINT(log_debug, "Request succeeded with code: %i", channel()->name(), http_code);
+		/* release sent readings */
+		channel()->acknowledge(_cursor);
 	}
 	else { /* error */
-		channel()->buffer()->undelete();
 		if (curl_code != CURLE_OK) {
 			print(log_error, "CURL: %s", channel()->name(), curl_easy_strerror(curl_code));
 		}
@@ -215,17 +217,19 @@ void vz::api::MySmartGrid::send()
 /* householding */
 	json_object_put(json_obj);
 
-	if (options.daemon() && (curl_code != CURLE_OK || http_code != 200)) {
-		print(log_info, "Waiting %i secs for next request due to previous failure",
-					channel()->name(), options.retry_pause());
-		sleep(options.retry_pause());
+	/* host did not answer, the uploader retries after a backoff */
+	if (curl_code != CURLE_OK) {
+		throw vz::ConnectionException("Middleware not reachable");
+	}
+	if (http_code >= 500) {
+		throw vz::ConnectionException("Middleware answered with server error");
 	}
-//sleep(20);
+	return true;
 }
 
 void vz::api::MySmartGrid::register_device() {
 	OptionList optlist;
-	//print(log_debug, "Register device: '%s'", channel()->name(), channel()->uuid());
+	//PRINT(log_debug, "Register device: '%s'", channel()->name(), channel()->uuid());
 
 	char url[255];
 	sprintf(url, "%s/device/%s", middleware().c_str(), _deviceId.c_str());			/* build url */
@@ -267,16 +271,16 @@ void vz::api::MySmartGrid::_send(
 	long int http_code;
 	CURLcode curl_code;
 
-	print(log_debug, "msg_api_send() %s", channel()->name(), url.c_str());
+	PRINT(log_debug, "msg_api_send() %s", channel()->name(), url.c_str());
 	curl_easy_setopt(_curlIF.handle(), CURLOPT_URL, url.c_str());
 
 	json_str = json_object_to_json_string(json_obj);
 	if (json_str == NULL || strcmp(json_str, "null")==0) {
-		print(log_debug, "JSON request body is null. Nothing to send now.", channel()->name());
+		PRINT(log_debug, "JSON request body is null. Nothing to send now.", channel()->name());
 		return;
 	}
 
-	print(log_debug, "JSON request body: '%s'", channel()->name(), json_str);
+	PRINT(log_debug, "JSON request body: '%s'", channel()->name(), json_str);
 
 	/* initialize response */
 	_response->clear_response();
@@ -286,7 +290,7 @@ void vz::api::MySmartGrid::_send(
 	_api_header();
 	hmac_sha1(digest, (const unsigned char*)json_str, strlen(json_str));
 	_curlIF.addHeader(digest);
-	print(log_debug, "Header_Digest: %s", channel()->name(), digest);
+	PRINT(log_debug, "Header_Digest: %s", channel()->name(), digest);
 
 	_curlIF.commitHeader();
 
@@ -295,11 +299,9 @@ void vz::api::MySmartGrid::_send(
 
 	/* check response */
 	if (curl_code == CURLE_OK && http_code == 200) { /* everything is ok */
-		print(log_debug, "Request succeeded with code: %i", channel()->name(), http_code);
-		_values.clear();
+		PRINT(log_debug, "Request succeeded with code: %i", channel()->name(), http_code);
 	}
 	else { /* error */
-		channel()->buffer()->undelete();
 		if (curl_code != CURLE_OK) {
 			print(log_error, "CURL: %s", channel()->name(), curl_easy_strerror(curl_code));
 		}
@@ -315,10 +317,12 @@ void vz::api::MySmartGrid::_send(
 	/* householding */
 	json_object_put(json_obj);
 
-	if (options.daemon() && (curl_code != CURLE_OK || http_code != 200)) {
-		print(log_info, "Waiting %i secs for next request due to previous failure",
-					channel()->name(), options.retry_pause());
-		sleep(options.retry_pause());
+	/* host did not answer, the uploader retries after a backoff */
+	if (curl_code != CURLE_OK) {
+		throw vz::ConnectionException("Middleware not reachable");
+	}
+	if (http_code >= 500) {
+		throw vz::ConnectionException("Middleware answered with server error");
 	}
 }
 
@@ -344,7 +348,7 @@ void vz::api::MySmartGrid::api_parse_exception(char *err, size_t n) {
 			if (json_obj) {
 				snprintf(err, n, "Server-Error: %s", json_object_get_string(json_obj));
 			} else {
-				print(log_debug, "CURL - Resp: '%s'", channel()->name(), _response->get_response().c_str());
+				PRINT(log_debug, "CURL - Resp: '%s'", channel()->name(), _response->get_response().c_str());
 				strncpy(err, "missing exception", n);
 			}
 		}
@@ -357,15 +361,11 @@ void vz::api::MySmartGrid::api_parse_exception(char *err, size_t n) {
 	json_tokener_free(json_tok);
 }
 
-json_object *vz::api::MySmartGrid::_apiDevice(Buffer::Ptr buf) {
+json_object *vz::api::MySmartGrid::_apiDevice() {
 
-	// copy all values to local buffer queue
-	buf->lock();
-	for (	Buffer::iterator it = buf->begin(); it != buf->end(); it++) {
-		it->mark_delete();
-	}
-	buf->unlock();
-	buf->clean();
+	// readings are not needed for device messages
+	channel()->acknowledge(channel()->pending());
+	_cursor = 0;
 
 	if (_first_ts>0) { // send lifesign
 		_first_ts = time(NULL);
@@ -376,9 +376,10 @@ json_object *vz::api::MySmartGrid::_apiDevice(Buffer::Ptr buf) {
 	}
 }
 
-json_object *vz::api::MySmartGrid::_apiSensor(Buffer::Ptr buf) {
+bool vz::api::MySmartGrid::_apiSensor() {
 
-	return _json_object_measurements(buf);
+	_body.clear();
+	return _json_measurements(_body);
 }
 
 
@@ -482,55 +483,44 @@ json_object * vz::api::MySmartGrid::_json_object_sensor(
  * @return <ReturnValue>
 **/
 /*---------------------------------------------------------------------*/
-json_object * vz::api::MySmartGrid::_json_object_measurements(Buffer::Ptr buf) {
+bool vz::api::MySmartGrid::_json_measurements(JsonWriter &json) {
 //  measurements: [[<timestamp1>,<value1>], [<timestamp2>,<value2>], ... ,[<timestamp n>,<value n>]]
-	json_object *json_obj    = json_object_new_object();
-	json_object *json_tuples = json_object_new_array();
-	Buffer::iterator it;
 
 //long last_counter = 0;
 
 	long timestamp = 0;
 	long value     = 0.0;
-
-	//print(log_debug, "MSG-API, buffer has %d element.", channel()->name(), buf->size());
-	if (_values.size() ) {
-		timestamp = _values.back().tvtod();
-		value     = _values.back().value();
-	}
-
-	// copy all values to local buffer queue
-	buf->lock();
-	for (it = buf->begin(); it != buf->end(); it++) {
-		if (timestamp < (long)it->tvtod() /*&& value != (long)(it->value() * _scaler)*/ ) {
-			_values.push_back(*it);
-			timestamp = it->tvtod();
-			value     = it->value() * _scaler;
+	size_t count   = 0;
+
+	//PRINT(log_debug, "MSG-API, buffer has %d element.", channel()->name(), channel()->pending());
+
+	// readings stay queued until the request succeeded, skip those with same second
+	Reading *rd;
+	for (_cursor = 0; (rd = channel()->peek(_cursor)) != NULL; _cursor++) {
+		if (timestamp < (long)rd->time_s() /*&& value != (long)(rd->value() * _scaler)*/ ) {
+			timestamp = rd->time_s();
+			value     = rd->value() * _scaler;
+			count++;
+			PRINT(log_debug, "==> %ld, %lf - %ld", channel()->name(), timestamp, rd->value(), value);
 		}
-		it->mark_delete();
 	}
-	buf->unlock();
-	buf->clean();
 
-	//print(log_debug, "Valuescounter: %d", channel()->name(), _values.size());
-
-	for (it = _values.begin(); it != _values.end(); it++) {
-		timestamp = it->tvtod();
-		value     = it->value() * _scaler;
-		print(log_debug, "==> %ld, %lf - %ld", channel()->name(), timestamp, it->value(), value);
-	}
-	if (_values.size() < 1 || (_values.size() < 2 && _first_counter==0) ) {
-		return NULL;
+	if (count < 1 || (count < 2 && _first_counter==0) ) {
+		return false;
 	}
 
+	json.open_object();
+	json.key("measurements");
+	json.open_array();
 
-	for (it = _values.begin(); it != _values.end(); it++) {
-		struct json_object *json_tuple = json_object_new_array();
-
-		// TODO use long int of new json-c version
-		// API requires milliseconds => * 1000
-		long timestamp = it->tvtod();
-		long value = it->value() * _scaler;
+	timestamp = 0;
+	for (size_t i = 0; i < _cursor; i++) {
+		rd = channel()->peek(i);
+		if (timestamp >= (long)rd->time_s()) {
+			continue;
+		}
+		timestamp = rd->time_s();
+		long value = rd->value() * _scaler;
 
 		if (_first_counter < 1 ) {
 			_first_counter = value;
@@ -538,17 +528,19 @@ json_object * vz::api::MySmartGrid::_json_object_measurements(Buffer::Ptr buf) {
 		} else {
 			if (/*(_last_counter < value)  &&*/ (_first_ts < timestamp)) {
 				_first_ts = timestamp;
-				json_object_array_add(json_tuple, json_object_new_int(timestamp));
-				json_object_array_add(json_tuple, json_object_new_int(value-_first_counter));
-				json_object_array_add(json_tuples, json_tuple);
+				json.open_array();
+				json.integer(timestamp);
+				json.integer(value-_first_counter);
+				json.close_array();
 				_last_counter = value;
 			} //else return NULL;
 		}
 	}
 
-	json_object_object_add(json_obj, "measurements", json_tuples);
+	json.close_array();
+	json.close_object();
 
-	return json_obj;
+	return true;
 }
 
 void vz::api::MySmartGrid::_api_header() {
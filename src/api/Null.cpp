@@ -45,8 +45,11 @@ vz::api::Null::~Null()
 {
 }
 
-void vz::api::Null::send()
+bool vz::api::Null::send()
 {
+	// discard readings, they are only served by the local httpd
+	channel()->acknowledge(channel()->pending());
+	return false;
 }
 
 void vz::api::Null::register_device()
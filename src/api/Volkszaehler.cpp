@@ -35,8 +35,11 @@
 #include <math.h>
 #include <unistd.h>
 
+#include <algorithm>
+
 #include <VZException.hpp>
 #include "Config_Options.hpp"
+#include "Uploader.hpp"
 #include <api/Volkszaehler.hpp>
 
 extern Config_Options options;
@@ -46,9 +49,17 @@ vz::api::Volkszaehler::Volkszaehler(
 	std::list<Option> pOptions
 	)
 	: ApiIF(ch)
+	, _batched(false)
+	, _leading(false)
+	, _single(false)
+	, _cursor(0)
+	, _cursor_timestamp(0)
 	, _last_timestamp(0)
 {
 	OptionList optlist;
+	_response.data = NULL;
+	_response.size = 0;
+
 	char url[255], agent[255];
 	unsigned short curlTimeout = 30; // 30 seconds
 
@@ -72,6 +83,34 @@ vz::api::Volkszaehler::Volkszaehler(
 	// prepare header, uuid & url
 	sprintf(agent, "User-Agent: %s/%s (%s)", PACKAGE, VERSION, curl_version());	// build user agent
 	sprintf(url, "%s/data/%s.json", middleware().c_str(), channel()->uuid());	// build url
+	_url = url;
+
+	// upload together with the other channels of a bulk endpoint
+	try {
+		std::string endpoint = optlist.lookup_string(pOptions, "batch");
+		int tuples = BATCH_DEFAULT_TUPLES;
+		int bytes = BATCH_DEFAULT_BYTES;
+
+		try {
+			tuples = optlist.lookup_int(pOptions, "batch_tuples");
+		} catch (vz::OptionNotFoundException &e) {
+		}
+		try {
+			bytes = optlist.lookup_int(pOptions, "batch_bytes");
+		} catch (vz::OptionNotFoundException &e) {
+		}
+		if (tuples < 1 || bytes < 1) {
+			throw vz::VZException("Limits of the batch must be positive.");
+		}
+
+		// relative to the middleware, or a stand-in of its own
+		if (endpoint.find("://") == std::string::npos) {
+			endpoint = middleware() + endpoint;
+		}
+		_batch = Batch::get(endpoint, tuples, bytes);
+	} catch (vz::OptionNotFoundException &e) {
+		// one request per channel
+	}
 
 	_api.headers = NULL;
 	_api.headers = curl_slist_append(_api.headers, "Content-type: application/json");
@@ -83,6 +122,10 @@ vz::api::Volkszaehler::Volkszaehler(
 		throw vz::VZException("CURL: cannot create handle.");
 	}
 
+	// reuse connections, TLS sessions and DNS results of other channels of the host
+	_share = CurlShare::get(middleware());
+	_share->attach(_api.curl);
+
 	curl_easy_setopt(_api.curl, CURLOPT_URL, url);
 	curl_easy_setopt(_api.curl, CURLOPT_HTTPHEADER, _api.headers);
 	curl_easy_setopt(_api.curl, CURLOPT_VERBOSE, options.verbosity());
@@ -94,115 +137,264 @@ vz::api::Volkszaehler::Volkszaehler(
 
 	// set timeout to 5 sec. required if next router has an ip-change.
 	curl_easy_setopt(_api.curl, CURLOPT_TIMEOUT, curlTimeout);
+
+	if (_batch) {
+		_batch->join(this);
+	}
 }
 
 vz::api::Volkszaehler::~Volkszaehler()
 {
+	release();
+	if (_batch) {
+		_batch->leave(this);
+	}
+
+	// before the share is released
+	curl_easy_cleanup(_api.curl);
+	curl_slist_free_all(_api.headers);
 }
 
-void vz::api::Volkszaehler::send()
+bool vz::api::Volkszaehler::send()
 {
-	CURLresponse response;
-	json_object *json_obj;
+	CURL *handle = prepare();
+	if (handle == NULL) {
+		return false;
+	}
 
-	const char *json_str;
-	long int http_code;
-	CURLcode curl_code;
+	complete(curl_easy_perform(handle));
+	return true;
+}
 
-	// initialize response
-	response.data = NULL;
-	response.size = 0;
+CURL *vz::api::Volkszaehler::prepare()
+{
+	// request which was aborted, e.g. when the uploader stopped
+	release();
 
-	json_obj = api_json_tuples(channel()->buffer());
-	json_str = json_object_to_json_string(json_obj);
-	if (json_str == NULL || strcmp(json_str, "null")==0) {
-		print(log_debug, "JSON request body is null. Nothing to send now.", channel()->name());
-		return;
+	if (_batch) {
+		if (!_batch->acquire()) {
+			PRINT(log_debug, "Request of the batch in flight, sending with the next one.", channel()->name());
+			return NULL;
+		}
+		_leading = true;
+	}
+
+	if (_batch && !_single) {
+		_batched = true;
+		_batch->lock();
+		api_json_batch(_body);
+		_batch->unlock();
+		curl_easy_setopt(curl(), CURLOPT_URL, _batch->url().c_str());
+	} else {
+		_batched = false;
+		api_json_tuples(_body);
+		curl_easy_setopt(curl(), CURLOPT_URL, _url.c_str());
+		_single = false;
+	}
+
+	if (_body.empty()) {
+		PRINT(log_debug, "JSON request body is null. Nothing to send now.", channel()->name());
+		/* release duplicates which have been skipped */
+		acknowledge();
+		release();
+		return NULL;
 	}
 
-	print(log_debug, "JSON request body: %s", channel()->name(), json_str);
+	PRINT(log_debug, "JSON request body: %s", channel()->name(), _body.c_str());
 
-	curl_easy_setopt(curl(), CURLOPT_POSTFIELDS, json_str);
+	// the body is not copied, it is kept in _body until complete()
+	curl_easy_setopt(curl(), CURLOPT_POSTFIELDSIZE, (long) _body.size());
+	curl_easy_setopt(curl(), CURLOPT_POSTFIELDS, _body.c_str());
 	curl_easy_setopt(curl(), CURLOPT_WRITEFUNCTION, curl_custom_write_callback);
-	curl_easy_setopt(curl(), CURLOPT_WRITEDATA, (void *) &response);
+	curl_easy_setopt(curl(), CURLOPT_WRITEDATA, (void *) &_response);
+
+	return curl();
+}
+
+void vz::api::Volkszaehler::complete(CURLcode curl_code)
+{
+	long int http_code = 0;
 
-	curl_code = curl_easy_perform(curl());
 	curl_easy_getinfo(curl(), CURLINFO_RESPONSE_CODE, &http_code);
 
 	// check response
 	if (curl_code == CURLE_OK && http_code == 200) { // everything is ok
-		print(log_debug, "CURL Request succeeded with code: %i", channel()->name(), http_code);
-		_values.clear();
-		// clear buffer-readings
-		//channel()->buffer.sent = last->next;
+		PRINT(log_debug, "CURL Request succeeded with code: %i", channel()->name(), http_code);
+		/* release sent readings */
+		acknowledge();
 	}
 	else { // error
 		if (curl_code != CURLE_OK) {
 			print(log_error, "CURL: %s", channel()->name(), curl_easy_strerror(curl_code));
 		}
+		else if (_batched && http_code < 500) {
+			/* e.g. a duplicate, which is only removed by the request of the channel itself */
+			_batch->lock();
+			std::vector<Volkszaehler *> &sent = _batch->sent();
+			print(log_error, "Middleware rejected batch of %lu channels with code %ld, sending them one by one",
+						channel()->name(), (unsigned long)sent.size(), http_code);
+			for (std::vector<Volkszaehler *>::iterator it = sent.begin(); it != sent.end(); it++) {
+				if (*it != NULL) (*it)->_single = true;
+			}
+			_batch->unlock();
+		}
 		else if (http_code != 200) {
 			char err[255];
-			api_parse_exception(response, err, 255);
+			api_parse_exception(_response, err, 255);
 			print(log_error, "CURL Error from middleware: %s", channel()->name(), err);
 		}
 	}
 
+	/* channels left over by the limits or ready while we were in flight */
+	std::vector<Channel::Ptr> resume;
+	if (_batched && curl_code == CURLE_OK && http_code < 500) {
+		_batch->lock();
+		std::vector<Volkszaehler *> &sent = _batch->sent();
+		for (std::vector<Volkszaehler *>::iterator it = sent.begin(); it != sent.end(); it++) {
+			if (*it != NULL && *it != this && (*it)->channel()->pending() > 0) {
+				resume.push_back((*it)->channel());
+			}
+		}
+		_batch->unlock();
+	}
+
 	// householding
-	free(response.data);
-	json_object_put(json_obj);
+	release();
+
+	for (std::vector<Channel::Ptr>::iterator it = resume.begin(); it != resume.end(); it++) {
+		if ((*it)->uploader() != NULL) {
+			(*it)->uploader()->ready((*it)->job());
+		}
+	}
+
+	/* host did not answer, the uploader retries after a backoff */
+	if (curl_code != CURLE_OK) {
+		throw vz::ConnectionException("Middleware not reachable");
+	}
+	if (http_code >= 500) {
+		throw vz::ConnectionException("Middleware answered with server error");
+	}
+}
+
+void vz::api::Volkszaehler::release()
+{
+	free(_response.data);
+	_response.data = NULL;
+	_response.size = 0;
 
-	if (options.daemon() && (curl_code != CURLE_OK || http_code != 200)) {
-		print(log_info, "Waiting %i secs for next request due to previous failure",
-					channel()->name(), options.retry_pause());
-		sleep(options.retry_pause());
+	_body.clear();
+
+	if (_leading) {
+		_leading = false;
+		_batch->release();
 	}
 }
 
+void vz::api::Volkszaehler::acknowledge()
+{
+	if (!_batched) {
+		channel()->acknowledge(_cursor);
+		_last_timestamp = _cursor_timestamp;
+		return;
+	}
+
+	_batch->lock();
+	std::vector<Volkszaehler *> &sent = _batch->sent();
+	for (std::vector<Volkszaehler *>::iterator it = sent.begin(); it != sent.end(); it++) {
+		if (*it == NULL) continue; /* left meanwhile, handed its cursor to us */
+		(*it)->channel()->acknowledge((*it)->_cursor);
+		(*it)->_last_timestamp = (*it)->_cursor_timestamp;
+	}
+
+	std::vector<std::pair<Channel::Ptr, size_t> > &handed = _batch->handed();
+	for (std::vector<std::pair<Channel::Ptr, size_t> >::iterator it = handed.begin(); it != handed.end(); it++) {
+		it->first->acknowledge(it->second);
+	}
+	_batch->unlock();
+}
+
 void vz::api::Volkszaehler::register_device() {
 }
 
 
-json_object * vz::api::Volkszaehler::api_json_tuples(Buffer::Ptr buf) {
+size_t vz::api::Volkszaehler::api_json_tuples(JsonWriter &json, size_t max, bool entry) {
 
-	json_object *json_tuples = json_object_new_array();
-	Buffer::iterator it;
+	size_t tuples = 0;
+	Reading *rd;
 
-	print(log_debug, "==> number of tuples: %d", channel()->name(), buf->size());
-	uint64_t timestamp = 1;
+	PRINT(log_debug, "==> number of tuples: %d", channel()->name(), channel()->pending());
+	uint64_t last = _last_timestamp;
 
-	// copy all values to local buffer queue
-	buf->lock();
-	for (it = buf->begin(); it != buf->end(); it++) {
-		timestamp = round(it->tvtod() * 1000);
-		print(log_debug, "compare: %llu %llu %f", channel()->name(), _last_timestamp, timestamp, it->tvtod() * 1000);
-		if (_last_timestamp < timestamp ) {
-			_values.push_back(*it);
-			_last_timestamp = timestamp;
+	// serialize queued readings in place, they are acknowledged after the request succeeded
+	channel()->lock_consumer();
+	for (_cursor = 0; (rd = channel()->peek(_cursor)) != NULL; _cursor++) {
+		uint64_t timestamp = rd->time_ms();
+		PRINT(log_debug, "compare: %llu %llu", channel()->name(), last, timestamp);
+		if (last >= timestamp) {
+			continue; // skip duplicates
+		}
+		if (tuples == max) {
+			break; // left for the next request
 		}
-		it->mark_delete();
+		last = timestamp;
+
+		if (tuples++ == 0) {
+			if (entry) {
+				json.open_object();
+				json.key("uuid");
+				json.string(channel()->uuid());
+				json.key("tuples");
+			}
+			json.open_array();
+		}
+
+		// API requires milliseconds
+		json.tuple(timestamp, rd->value());
 	}
-	buf->unlock();
-	buf->clean();
 
-	if (_values.size() < 1 ) {
-		return NULL;
+	if (tuples > 0) {
+		json.close_array();
+		if (entry) json.close_object();
 	}
+	channel()->unlock_consumer();
+	_cursor_timestamp = last;
 
-	for (it = _values.begin(); it != _values.end(); it++) {
-		struct json_object *json_tuple = json_object_new_array();
+	return tuples;
+}
+
+/* upper limits of the serialized size */
+#define BATCH_TUPLE_BYTES 48	/* [<ms>,<value>], with 17 digits and exponent */
+#define BATCH_ENTRY_BYTES 24	/* {"uuid":"","tuples":[]}, */
+
+size_t vz::api::Volkszaehler::api_json_batch(JsonWriter &json) {
+
+	size_t tuples = 0;
 
-		// TODO use long int of new json-c version
-		// API requires milliseconds => * 1000
-		double timestamp = it->tvtod() * 1000;
-		double value = it->value();
+	json.open_array();
 
-		json_object_array_add(json_tuple, json_object_new_double(timestamp));
-		json_object_array_add(json_tuple, json_object_new_double(value));
+	std::vector<Volkszaehler *> &sent = _batch->begin(this);
+	for (std::vector<Volkszaehler *>::iterator it = sent.begin(); it != sent.end(); it++) {
+		Volkszaehler *member = *it;
+		size_t entry = BATCH_ENTRY_BYTES + strlen(member->channel()->uuid());
+		size_t bytes = _batch->bytes() - std::min(_batch->bytes(), json.size() + 1);
+		size_t max = (bytes > entry) ? std::min(_batch->tuples() - tuples, (bytes - entry) / BATCH_TUPLE_BYTES) : 0;
+
+		if (max == 0 && tuples > 0) {
+			member->_cursor = 0; // request is full
+			continue;
+		}
+
+		// at least one tuple, even if the limits are too tight for it
+		// duplicates are acknowledged with the request
+		tuples += member->api_json_tuples(json, std::max(max, (size_t)1), true);
+	}
 
-		json_object_array_add(json_tuples, json_tuple);
+	json.close_array();
+	if (tuples == 0) {
+		json.clear();
 	}
 
-	return json_tuples;
+	return tuples;
 }
 
 void vz::api::Volkszaehler::api_parse_exception(CURLresponse response, char *err, size_t n) {
@@ -224,7 +416,7 @@ void vz::api::Volkszaehler::api_parse_exception(CURLresponse response, char *err
 			if (err_type == "UniqueConstraintViolationException") {
 				if (err_message.find("Duplicate entry") ) {
 					print(log_warning, "Middleware says duplicated value. Removing first entry!", channel()->name());
-					_values.pop_front();
+					channel()->acknowledge(1);
 				}
 			}
 		}
@@ -257,20 +449,20 @@ int vz::api::curl_custom_debug_callback(
 			case CURLINFO_TEXT:
 			case CURLINFO_END:
 				if (end) *end = '\0'; // terminate without \n
-				print((log_level_t)(log_debug+5), "CURL: %.*s", ch->name(), (int) size, data);
+				PRINT((log_level_t)(log_debug+5), "CURL: %.*s", ch->name(), (int) size, data);
 				break;
 
 			case CURLINFO_SSL_DATA_IN:
 			case CURLINFO_DATA_IN:
-				print((log_level_t)(log_debug+5), "CURL: Received %lu bytes", ch->name(), (unsigned long) size);
-				print((log_level_t)(log_debug+5), "CURL: Received '%s' bytes", ch->name(), data);
+				PRINT((log_level_t)(log_debug+5), "CURL: Received %lu bytes", ch->name(), (unsigned long) size);
+				PRINT((log_level_t)(log_debug+5), "CURL: Received '%s' bytes", ch->name(), data);
 				break;
 
 			case CURLINFO_SSL_DATA_OUT:
 			case CURLINFO_DATA_OUT:
 				data[size]=0;
-				print((log_level_t)(log_debug+5), "CURL: Sent %lu bytes.. ", ch->name(), (unsigned long) size);
-				print((log_level_t)(log_debug+5), "CURL: Sent '%s' bytes", ch->name(), data);
+				PRINT((log_level_t)(log_debug+5), "CURL: Sent %lu bytes.. ", ch->name(), (unsigned long) size);
+				PRINT((log_level_t)(log_debug+5), "CURL: Sent '%s' bytes", ch->name(), data);
 				break;
 
 			case CURLINFO_HEADER_IN:
@@ -36,6 +36,14 @@
 
 extern Config_Options options;
 
+/* copied while the mappings are read locked */
+struct channel_status {
+	Channel::Ptr channel;
+	Meter::Ptr meter;
+	unsigned long overruns;		// deadlines the meter was still busy at
+	unsigned long skipped;		// ticks the meter missed
+};
+
 int handle_request(
 	void *cls
 	, struct MHD_Connection *connection
@@ -85,37 +93,52 @@ int handle_request(
 				}
 			}
 
+			/* collect the channels first, a reload must not wait for a comet request */
+			std::vector<channel_status> channels;
+			mappings->read_lock();
 			for (MapContainer::iterator mapping = mappings->begin(); mapping!=mappings->end(); mapping++) {
 				for (MeterMap::iterator ch = mapping->begin(); ch!=mapping->end(); ch++) {
-//foreach(mapping->channels, ch, channel_t) {
 					if (strcmp((*ch)->uuid(), uuid) == 0 || show_all) {
-						response_code = MHD_HTTP_OK;
+						channel_status entry = { *ch, mapping->meter(), mapping->overruns(), mapping->skipped() };
+						channels.push_back(entry);
+					}
+				}
+			}
+			mappings->unlock();
+
+			for (size_t i = 0; i < channels.size(); i++) {
+				Channel::Ptr ch = channels[i].channel;
+				Meter::Ptr meter = channels[i].meter;
+				response_code = MHD_HTTP_OK;
 
 /* blocking until new data arrives (comet-like blocking of HTTP response) */
-						if (mode && strcmp(mode, "comet") == 0) {
+				if (mode && strcmp(mode, "comet") == 0) {
 /* convert from timeval to timespec */
-//							gettimeofday(&tp, NULL);
-//							ts.tv_sec  = tp.tv_sec + options.comet_timeout();
-//							ts.tv_nsec = tp.tv_usec * 1000;
+//					gettimeofday(&tp, NULL);
+//					ts.tv_sec  = tp.tv_sec + options.comet_timeout();
+//					ts.tv_nsec = tp.tv_usec * 1000;
 
-							(*ch)->wait();
-						}
+					ch->wait();
+				}
 
-						struct json_object *json_ch = json_object_new_object();
+				struct json_object *json_ch = json_object_new_object();
 
-						json_object_object_add(json_ch, "uuid", json_object_new_string((*ch)->uuid()));
+				json_object_object_add(json_ch, "uuid", json_object_new_string(ch->uuid()));
 //json_object_object_add(json_ch, "middleware", json_object_new_string(ch->middleware()));
 //json_object_object_add(json_ch, "last", json_object_new_double(ch->last.value));
-						json_object_object_add(json_ch, "last", json_object_new_double((*ch)->tvtod()));
-						json_object_object_add(json_ch, "interval", json_object_new_int(mapping->meter()->interval()));
-						json_object_object_add(json_ch, "protocol", json_object_new_string(meter_get_details(mapping->meter()->protocolId())->name));
+				json_object_object_add(json_ch, "last", json_object_new_double(ch->tvtod()));
+				json_object_object_add(json_ch, "interval", json_object_new_int(meter->interval()));
+				json_object_object_add(json_ch, "protocol", json_object_new_string(meter_get_details(meter->protocolId())->name));
+				json_object_object_add(json_ch, "dropped", json_object_new_int(ch->dropped()));
+				json_object_object_add(json_ch, "downsampled", json_object_new_int(ch->downsampled()));
+				json_object_object_add(json_ch, "suppressed", json_object_new_int(ch->suppressed()));
+				json_object_object_add(json_ch, "overruns", json_object_new_int(channels[i].overruns));
+				json_object_object_add(json_ch, "skipped", json_object_new_int(channels[i].skipped));
 
 //struct json_object *json_tuples = api_json_tuples(&ch->buffer, ch->buffer.head, ch->buffer.tail);
 //json_object_object_add(json_ch, "tuples", json_tuples);
 
-						json_object_array_add(json_data, json_ch);
-					}
-				}
+				json_object_array_add(json_data, json_ch);
 			}
 
 			json_object_object_add(json_obj, "version", json_object_new_string(VERSION));
@@ -51,6 +51,7 @@ MeterD0::MeterD0(std::list<Option> options)
 		, _host("")
 		, _device("")
 		, _wait_sync_end (false)
+		, _fd(-1)
 {
 	OptionList optlist;
 
@@ -80,7 +81,7 @@ MeterD0::MeterD0(std::list<Option> options)
 			hx[0]=strtol(hs,NULL,16);
 			_pull.append(hx,1);
 		}
-		print(log_debug,"pullseq len:%d found",name().c_str(),_pull.size());
+		PRINT(log_debug,"pullseq len:%d found",name().c_str(),_pull.size());
 	} catch (vz::OptionNotFoundException &e) {
 		// using default value if not specified
 		_pull = "";
@@ -97,7 +98,7 @@ MeterD0::MeterD0(std::list<Option> options)
 			hx[0]=strtol(hs,NULL,16);
 			_ack.append(hx,1);
 		}
-		print(log_debug,"ackseq len:%d found %s, %x",name().c_str(),_ack.size(),_ack.c_str(),_ack.c_str()[0]);
+		PRINT(log_debug,"ackseq len:%d found %s, %x",name().c_str(),_ack.size(),_ack.c_str(),_ack.c_str()[0]);
 	} catch (vz::OptionNotFoundException &e) {
 		// using default value if not specified
 		_ack = "";
@@ -210,7 +211,7 @@ MeterD0::MeterD0(std::list<Option> options)
 		throw;
 	}
 
-
+	_reset_parser();
 }
 
 MeterD0::~MeterD0() {
@@ -237,91 +238,26 @@ int MeterD0::close() {
 
 ssize_t MeterD0::read(std::vector<Reading>& rds, size_t max_readings) {
 
-	enum { START, VENDOR, BAUDRATE, IDENTIFICATION, ACK, START_LINE, OBIS_CODE, VALUE, UNIT, END_LINE, END } context;
-
-	bool error_flag = false;
-	const int VENDOR_LEN = 3;
-	char vendor[VENDOR_LEN +1];			// 3 upper case vendor + '\0' termination
-	const int IDENTIFICATION_LEN = 16;
-	char identification[IDENTIFICATION_LEN +1];	// 16 meter specific + '\0' termination
-	const int OBIS_LEN = 16;
-	char obis_code[OBIS_LEN +1];		/* A-B:C.D.E*F
-								   fields A, B, E, F are optional
-								   fields C & D are mandatory
-								   A: energy type; 1: energy
-								   B: channel number; 0: no channel specified
-								   C: data items; 0-89 in COSEM context: IEC 62056-62, Clause D.1; 96: General service entries
-								   1:  Totel Active power+
-								   21: L1 Active power+
-								   31: L1 Current
-								   32: L1 Voltage
-								   41: L2 Active power+
-								   51: L2 Current
-								   52: L2 Voltage
-								   61: L3 Active power+
-								   71: L3 Current
-								   72: L3 Voltage
-								   96.1.255: Metering point ID 256 (electricity related)
-								   96.5.5: Meter started status flag
-								   D: types
-								   E: further processing or classification of quantities
-								   F: storage of data
-								   see DIN-EN-62056-61 */
-	const int VALUE_LEN = 32;
-	char value[VALUE_LEN+1];			// value, i.e. the actual reading
-	const int UNIT_LEN = 16;
-	char unit[UNIT_LEN+1];			// the unit of the value, e.g. kWh, V, ...
-
-	char baudrate;				// 1 byte for
-	char byte,lastbyte;			// we parse our input byte wise
-	int byte_iterator;
-	char endseq[2+1];			// Endsequence ! not ?!
-	size_t number_of_tuples;
+	char byte;					// we parse our input byte wise
 	int bytes_read;
 	time_t start_time, end_time;
 	struct termios tio;
-	int baudrate_connect,baudrate_read;	// Baudrates for switching
+	vz::protocol::VectorSink sink(rds, max_readings);
 
-
-	baudrate_connect=_baudrate;
-	baudrate_read=_baudrate_read;
 	tcgetattr(_fd, &tio);
 
 	if (_pull.size()) {
 		tcflush(_fd, TCIOFLUSH);
-		cfsetispeed(&tio, baudrate_connect);
-		cfsetospeed(&tio, baudrate_connect);
+		cfsetispeed(&tio, _baudrate);
+		cfsetospeed(&tio, _baudrate);
 		// apply new configuration
 		tcsetattr(_fd, TCSANOW, &tio);
 		int wlen=write(_fd,_pull.c_str(),_pull.size());
-		print(log_debug,"sending pullsequenz send (len:%d is:%d).",name().c_str(),_pull.size(),wlen);
+		PRINT(log_debug,"sending pullsequenz send (len:%d is:%d).",name().c_str(),_pull.size(),wlen);
 	}
 
 	time(&start_time);
-
-	byte_iterator = number_of_tuples = baudrate = 0;
-	byte = lastbyte = 0;
-	context = START;				// start with context START
-
-	if (_wait_sync_end) {
-		/* wait once for the sync pattern ("!") at the end of a regular D0 message.
-		   This is intended for D0 meters that start sending data automatically
-		   (e.g. Hager EHZ361).
-		*/
-		int skipped = 0;
-		while (_wait_sync_end && ::read(_fd, &byte, 1)) {
-			if (byte == '!') {
-				_wait_sync_end = false;
-				print(log_debug, "found wait_sync_end. skipped %d bytes.", name().c_str(), skipped);
-			} else {
-				skipped++;
-				if (skipped > D0_BUFFER_LENGTH) {
-					_wait_sync_end = false;
-					print(log_error, "stopped searching for wait_sync_end after %d bytes without success!", name().c_str(), skipped);
-				}
-			}
-		}
-	}
+	_reset_parser();				// start with context START
 
 	while (1) {
 		// check for timeout
@@ -331,7 +267,7 @@ ssize_t MeterD0::read(std::vector<Reading>& rds, size_t max_readings) {
 			break;
 		}
 
-		// now read a single byte
+		// now read a single byte, so nothing of the next telegram is consumed
 		bytes_read = ::read(_fd, &byte, 1);
 		if (bytes_read == 0 || (bytes_read == -1 && errno == EAGAIN)) {
 			// wait 5ms and read again
@@ -344,57 +280,139 @@ ssize_t MeterD0::read(std::vector<Reading>& rds, size_t max_readings) {
 		}
 
 		// reset timeout if we are making progress
-		if (context != START) {
+		if (_parser.context != START) {
 			time(&start_time);
 		}
 
-		lastbyte = byte;
-		if ((byte == '/') && (byte_iterator == 0)) {
-			context = VENDOR;	// Slash can also be in OBIS String of TD-3511 meter
+		if (feed((const uint8_t *)&byte, 1, sink) > 0) {
+			return sink.size();
+		}
+	}// end while
+
+	// Read terminated
+	print(log_error, "read timed out!, context: %i, bytes read: %i, last byte 0x%x",
+			name().c_str(), _parser.context, _parser.byte_iterator, _parser.lastbyte);
+	return sink.size(); // in any case return the number of readings. there might be some valid ones.
+}
+
+void MeterD0::_reset_parser() {
+	_parser.context = START;
+	_parser.byte_iterator = 0;
+	_parser.skipped = 0;
+	_parser.number_of_tuples = 0;
+	_parser.baudrate = 0;
+	_parser.lastbyte = 0;
+	_parser.vendor[0] = _parser.identification[0] = '\0';
+	_parser.obis_code[0] = _parser.value[0] = _parser.unit[0] = '\0';
+	_parser.endseq[0] = '\0';
+}
+
+/**
+ * Parse D0 telegrams byte by byte
+ *
+ * The obis code has the format A-B:C.D.E*F
+ *  fields A, B, E, F are optional
+ *  fields C & D are mandatory
+ *  A: energy type; 1: energy
+ *  B: channel number; 0: no channel specified
+ *  C: data items; 0-89 in COSEM context: IEC 62056-62, Clause D.1; 96: General service entries
+ *     1:  Totel Active power+
+ *     21: L1 Active power+
+ *     31: L1 Current
+ *     32: L1 Voltage
+ *     41: L2 Active power+
+ *     51: L2 Current
+ *     52: L2 Voltage
+ *     61: L3 Active power+
+ *     71: L3 Current
+ *     72: L3 Voltage
+ *     96.1.255: Metering point ID 256 (electricity related)
+ *     96.5.5: Meter started status flag
+ *  D: types
+ *  E: further processing or classification of quantities
+ *  F: storage of data
+ *  see DIN-EN-62056-61
+ *
+ * A telegram is finished by "!" or aborted on errors, both count as message.
+ */
+size_t MeterD0::feed(const uint8_t *data, size_t len, vz::protocol::ReadingSink &sink) {
+	const int VENDOR_LEN = 3;
+	const int IDENTIFICATION_LEN = 16;
+	const int OBIS_LEN = 16;
+	const int VALUE_LEN = 32;
+	const int UNIT_LEN = 16;
+
+	size_t messages = 0;
+
+	for (size_t i = 0; i < len; i++) {
+		char byte = data[i];
+		bool error_flag = false;
+
+		if (_wait_sync_end) {
+			/* wait once for the sync pattern ("!") at the end of a regular D0 message.
+			   This is intended for D0 meters that start sending data automatically
+			   (e.g. Hager EHZ361).
+			*/
+			if (byte == '!') {
+				_wait_sync_end = false;
+				PRINT(log_debug, "found wait_sync_end. skipped %d bytes.", name().c_str(), _parser.skipped);
+			} else {
+				_parser.skipped++;
+				if (_parser.skipped > D0_BUFFER_LENGTH) {
+					_wait_sync_end = false;
+					print(log_error, "stopped searching for wait_sync_end after %d bytes without success!", name().c_str(), _parser.skipped);
+				}
+			}
+			continue;
+		}
+
+		_parser.lastbyte = byte;
+		if ((byte == '/') && (_parser.byte_iterator == 0)) {
+			_parser.context = VENDOR;	// Slash can also be in OBIS String of TD-3511 meter
 		}
 		else if ((byte == '?') || (byte == '!')) {
-			if (context != END){
-				context = END; 		// "!" is the identifier for the END
-				byte_iterator = 0;
+			if (_parser.context != END){
+				_parser.context = END; 		// "!" is the identifier for the END
+				_parser.byte_iterator = 0;
 			}
 		}
 
-		switch (context) {
+		switch (_parser.context) {
 			case START:										// strip the initial "/"
 				if (byte == '/'){ // if ((byte != '\r') &&  (byte != '\n')) { 	// allow extra new line at the start
-					byte_iterator = number_of_tuples = 0;	// start
-					context = VENDOR;						// set new context: START -> VENDOR
+					_parser.byte_iterator = _parser.number_of_tuples = 0;	// start
+					_parser.context = VENDOR;						// set new context: START -> VENDOR
 				} // else ignore the other chars. -> Wait for / (!? is checked above already)
 				break;
 
 			case VENDOR:									// VENDOR has 3 Bytes
 				if ((byte == '\r') || (byte == '\n') || (byte == '/')) {
-					byte_iterator = number_of_tuples = 0;
+					_parser.byte_iterator = _parser.number_of_tuples = 0;
 					break;
 				}
 
 				if (!isalpha(byte)) goto error;				// Vendor ID needs to be alpha
-				vendor[byte_iterator++] = byte;				// read next byte
-				if (byte_iterator >= VENDOR_LEN) {					// after 3rd byte
-					vendor[byte_iterator] = '\0';			// termination
-					byte_iterator = 0;						// reset byte counter
-					context = BAUDRATE;						// set new context: VENDOR -> BAUDRATE
+				_parser.vendor[_parser.byte_iterator++] = byte;				// read next byte
+				if (_parser.byte_iterator >= VENDOR_LEN) {					// after 3rd byte
+					_parser.vendor[_parser.byte_iterator] = '\0';			// termination
+					_parser.byte_iterator = 0;						// reset byte counter
+					_parser.context = BAUDRATE;						// set new context: VENDOR -> BAUDRATE
 				}
 				break;
 
 			case BAUDRATE:									// BAUDRATE consists of 1 char only
-				baudrate = byte;
-				byte_iterator = 0;
-				context = IDENTIFICATION;					// set new context: BAUDRATE -> IDENTIFICATION
+				_parser.baudrate = byte;
+				_parser.byte_iterator = 0;
+				_parser.context = IDENTIFICATION;					// set new context: BAUDRATE -> IDENTIFICATION
 				break;
 
 			case IDENTIFICATION:							// IDENTIFICATION has 16 bytes
 				if ((byte == '\r') || (byte == '\n')) { 	// line end
-					identification[byte_iterator] = '\0';	// termination
-					print(log_debug, "Pull answer (vendor=%s, baudrate=%c, identification=%s)",
-							name().c_str(),  vendor, baudrate, identification);
-					byte_iterator = 0;
-					context = ACK;							// set new context: IDENTIFICATION -> ACK (old: OBIS_CODE)
+					_parser.identification[_parser.byte_iterator] = '\0';	// termination
+					PRINT(log_debug, "Pull answer (vendor=%s, baudrate=%c, identification=%s)",
+							name().c_str(),  _parser.vendor, _parser.baudrate, _parser.identification);
+					_parser.byte_iterator = 0;
+					_parser.context = ACK;							// set new context: IDENTIFICATION -> ACK (old: OBIS_CODE)
 				}
 				else {
 					if (!isprint(byte)) {
@@ -402,8 +420,8 @@ ssize_t MeterD0::read(std::vector<Reading>& rds, size_t max_readings) {
 						//error_flag=true;
 					}
 					else {
-						if (byte_iterator<IDENTIFICATION_LEN)
-							identification[byte_iterator++] = byte;
+						if (_parser.byte_iterator<IDENTIFICATION_LEN)
+							_parser.identification[_parser.byte_iterator++] = byte;
 						else
 							print(log_error, "Too much data for identification (byte=0x%X)",
 									name().c_str(), byte);
@@ -413,35 +431,37 @@ ssize_t MeterD0::read(std::vector<Reading>& rds, size_t max_readings) {
 				break;
 
 			case ACK:
-				if (_ack.size()) {
+				if (_ack.size() && _fd >= 0) {
 					//tcflush(_fd, TCIOFLUSH);
 					//usleep (500000);
-					if (baudrate_read != baudrate_connect) {
-						cfsetispeed(&tio, baudrate_read);
+					if (_baudrate_read != _baudrate) {
+						struct termios tio;
+						tcgetattr(_fd, &tio);
+						cfsetispeed(&tio, _baudrate_read);
 						tcsetattr(_fd, TCSANOW, &tio);
 					}
 					int wlen = write(_fd,_ack.c_str(),_ack.size());
 					tcdrain(_fd);							// Wait until sent
-					print(log_debug, "Sending ack sequence send (len:%d is:%d,%s).",
+					PRINT(log_debug, "Sending ack sequence send (len:%d is:%d,%s).",
 							name().c_str(),_ack.size(),wlen,_ack.c_str());
 				}
-				context = OBIS_CODE;
+				_parser.context = OBIS_CODE;
 				break;
 
 			case START_LINE:
 				break;
 
 			case OBIS_CODE:
-				print(log_debug, "DEBUG OBIS_CODE byte %c hex= %X ", name().c_str(), byte, byte);
+				PRINT(log_debug, "DEBUG OBIS_CODE byte %c hex= %X ", name().c_str(), byte, byte);
 				if ((byte != '\n') && (byte != '\r') && (byte != 0x02)) {	// exclude STX
 					if (byte == '(') {
-						obis_code[byte_iterator] = '\0';
-						byte_iterator = 0;
-						context = VALUE;
+						_parser.obis_code[_parser.byte_iterator] = '\0';
+						_parser.byte_iterator = 0;
+						_parser.context = VALUE;
 					}
 					else {
-						if (byte_iterator < OBIS_LEN)
-							obis_code[byte_iterator++] = byte;
+						if (_parser.byte_iterator < OBIS_LEN)
+							_parser.obis_code[_parser.byte_iterator++] = byte;
 						else
 							print(log_error, "Too much data for obis_code (byte=0x%X)",
 															name().c_str(), byte);
@@ -450,22 +470,22 @@ ssize_t MeterD0::read(std::vector<Reading>& rds, size_t max_readings) {
 				break;
 
 			case VALUE:
-				print(log_debug, "DEBUG VALUE byte= %c hex= %x ",name().c_str(), byte, byte);
+				PRINT(log_debug, "DEBUG VALUE byte= %c hex= %x ",name().c_str(), byte, byte);
 				if ((byte == '*') || (byte == ')')) {
-					value[byte_iterator] = '\0';
-					byte_iterator = 0;
+					_parser.value[_parser.byte_iterator] = '\0';
+					_parser.byte_iterator = 0;
 
 					if (byte == ')') {
-						unit[0] = '\0';
-						context =  END_LINE;
+						_parser.unit[0] = '\0';
+						_parser.context =  END_LINE;
 					}
 					else {
-						context = UNIT;
+						_parser.context = UNIT;
 					}
 				}
 				else {
-					if (byte_iterator < VALUE_LEN)
-						value[byte_iterator++] = byte;
+					if (_parser.byte_iterator < VALUE_LEN)
+						_parser.value[_parser.byte_iterator++] = byte;
 					else
 						print(log_error, "Too much data for value (byte=0x%X)",
 															name().c_str(), byte);
@@ -474,13 +494,13 @@ ssize_t MeterD0::read(std::vector<Reading>& rds, size_t max_readings) {
 
 			case UNIT:
 				if (byte == ')') {
-					unit[byte_iterator] = '\0';
-					byte_iterator = 0;
-					context = END_LINE;
+					_parser.unit[_parser.byte_iterator] = '\0';
+					_parser.byte_iterator = 0;
+					_parser.context = END_LINE;
 				}
 				else {
-					if (byte_iterator < UNIT_LEN)
-						unit[byte_iterator++] = byte;
+					if (_parser.byte_iterator < UNIT_LEN)
+						_parser.unit[_parser.byte_iterator++] = byte;
 					else
 						print(log_error, "Too much data for unit (byte=0x%X)",
 															name().c_str(), byte);
@@ -501,25 +521,25 @@ ssize_t MeterD0::read(std::vector<Reading>& rds, size_t max_readings) {
 			// above is new! Previous versions ended on all but ? ("assuming !")
 			
 			if (byte == '!'){
-				if (byte_iterator == 0){
+				if (_parser.byte_iterator == 0){
 					// case a) ! as end ind.
-					// fallthrough to return number of tuples below.
+					// fallthrough to finish the telegram below.
 				}else{
 					// can only be case b) ?!. 
-					if (endseq[0] == '?'){
-						context = VENDOR;
-						byte_iterator = 0;
+					if (_parser.endseq[0] == '?'){
+						_parser.context = VENDOR;
+						_parser.byte_iterator = 0;
 						break;
 					}else{
 						error_flag = true; // state machine logic error!
-						print(log_debug, "DEBUG END b2 byte: %x byte_it: %d ", name().c_str(), byte, byte_iterator);
+						PRINT(log_debug, "DEBUG END b2 byte: %x byte_it: %d ", name().c_str(), byte, _parser.byte_iterator);
 					}
 				}
 			}else
 			if (byte == '?'){
-				if (byte_iterator == 0){
+				if (_parser.byte_iterator == 0){
 					// can be start of case b, store it
-					endseq[byte_iterator++] = byte;
+					_parser.endseq[_parser.byte_iterator++] = byte;
 					break;
 				}else{
 					// we simply keep the state. so we accept ??! as well
@@ -527,7 +547,7 @@ ssize_t MeterD0::read(std::vector<Reading>& rds, size_t max_readings) {
 				}
 			}else
 			{ // any other char than ! or ?:
-				if (byte_iterator>0) byte_iterator = 0; // reset ? reminder
+				if (_parser.byte_iterator>0) _parser.byte_iterator = 0; // reset ? reminder
 				break; // but stay in this state and accept that char! (here we ended before!)
 				// TODO Think about a timeout here?
 			}
@@ -538,54 +558,69 @@ ssize_t MeterD0::read(std::vector<Reading>& rds, size_t max_readings) {
 				goto error;
 			}
 
-			print(log_debug, "Read package with %i tuples (vendor=%s, baudrate=%c, identification=%s)",
-					name().c_str(), number_of_tuples, vendor, baudrate, identification);
-			return number_of_tuples;
+			PRINT(log_debug, "Read package with %i tuples (vendor=%s, baudrate=%c, identification=%s)",
+					name().c_str(), _parser.number_of_tuples, _parser.vendor, _parser.baudrate, _parser.identification);
+			messages++;
+			_reset_parser();
+			continue;
 		}// end switch
 		
-		if (END_LINE == context) { // add the data already here (so after the closing bracket) but before any \r\n
-			// free slots available and sane content?
-			if ((number_of_tuples < max_readings) && (strlen(obis_code) > 0) && (strlen(value) > 0)) {
-				switch (obis_code[0]){ // let's check sanity of first char. we can't use isValid() as here we get incomplete obis_codes as well (e.g. 1.8.0 -> 255-255:1.8.0)
-				case '0': // nobreak;
-				case '1': // nobreak;
-				case '2': // nobreak;
-				case 'C': // nobreak;
-				case 'F':
-					print(log_debug, "Parsed reading (OBIS code=%s, value=%s, unit=%s)",
-									name().c_str(), obis_code, value, unit);
-					rds[number_of_tuples].value(strtod(value, NULL));
-
-					try {
-						Obis obis(obis_code);
-						ReadingIdentifier *rid(new ObisIdentifier(obis));
-						rds[number_of_tuples].identifier(rid);
-						rds[number_of_tuples].time();
-						number_of_tuples++;
-					} catch (vz::VZException &e) {
-						print(log_error, "Failed to parse obis code (%s)", name().c_str(), obis_code);
-					}
-				break;
-				default:
-					print(log_debug, "Ignored reading (OBIS code=%s, value=%s, unit=%s)",
-									name().c_str(), obis_code, value, unit);
-				break;
-				}
-			}
-			byte_iterator = 0;
-			context = OBIS_CODE;
+		if (END_LINE == _parser.context) { // add the data already here (so after the closing bracket) but before any \r\n
+			_add_reading(sink);
+			_parser.byte_iterator = 0;
+			_parser.context = OBIS_CODE;
 		}
-		
-	}// end while
-
-	// Read terminated
-	print(log_error, "read timed out!, context: %i, bytes read: %i, last byte 0x%x",
-			name().c_str(),context,byte_iterator,lastbyte);
-	return number_of_tuples; // in any case return the number of readings. there might be some valid ones.
+		continue;
 
 error:
-	print(log_error, "Something unexpected happened: %s:%i!", name().c_str(), __FUNCTION__, __LINE__);
-	return number_of_tuples; // return number of good readings so far.
+		print(log_error, "Something unexpected happened: %s:%i!", name().c_str(), __FUNCTION__, __LINE__);
+		messages++; // the telegram ends here with the good readings so far
+		_reset_parser();
+	}
+
+	return messages;
+}
+
+/**
+ * Pass the reading of the current line to the sink
+ */
+void MeterD0::_add_reading(vz::protocol::ReadingSink &sink) {
+	// sane content?
+	if ((strlen(_parser.obis_code) == 0) || (strlen(_parser.value) == 0)) {
+		return;
+	}
+
+	switch (_parser.obis_code[0]){ // let's check sanity of first char. we can't use isValid() as here we get incomplete obis_codes as well (e.g. 1.8.0 -> 255-255:1.8.0)
+	case '0': // nobreak;
+	case '1': // nobreak;
+	case '2': // nobreak;
+	case 'C': // nobreak;
+	case 'F':
+		PRINT(log_debug, "Parsed reading (OBIS code=%s, value=%s, unit=%s)",
+						name().c_str(), _parser.obis_code, _parser.value, _parser.unit);
+		try {
+			Obis obis(_parser.obis_code);
+			Reading rd;
+			rd.id(IdentifierTable::lookup(ObisIdentifier(obis)));
+			if (rd.id() == 0) {
+				break; // no channel configured for this OBIS code
+			}
+			rd.value(strtod(_parser.value, NULL));
+			rd.time();
+
+			// free slots available?
+			if (sink.push(rd)) {
+				_parser.number_of_tuples++;
+			}
+		} catch (vz::VZException &e) {
+			print(log_error, "Failed to parse obis code (%s)", name().c_str(), _parser.obis_code);
+		}
+	break;
+	default:
+		PRINT(log_debug, "Ignored reading (OBIS code=%s, value=%s, unit=%s)",
+						name().c_str(), _parser.obis_code, _parser.value, _parser.unit);
+	break;
+	}
 }
 
 int MeterD0::_openSocket(const char *node, const char *service) {
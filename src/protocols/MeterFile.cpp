@@ -34,6 +34,9 @@
 
 MeterFile::MeterFile(std::list<Option> options)
 		: Protocol("file")
+		, _id_empty(IdentifierTable::intern(StringIdentifier("")))
+		, _fd(NULL)
+		, _line_len(0)
 {
 	OptionList optlist;
 
@@ -87,7 +90,7 @@ MeterFile::MeterFile(std::list<Option> options)
 			i++;
 		}
 
-		print(log_debug, "Parsed format string \"%s\" => \"%s\"", name().c_str(), config_format, scanf_format);
+		PRINT(log_debug, "Parsed format string \"%s\" => \"%s\"", name().c_str(), config_format, scanf_format);
 		_format = scanf_format;
 	} catch (vz::OptionNotFoundException &e) {
 		_format = ""; // use default format
@@ -135,8 +138,7 @@ ssize_t MeterFile::read(std::vector<Reading> &rds, size_t n) {
 
 	// TODO use inotify to block reading until file changes
 
-	char line[256], *endptr;
-	char *string=0;
+	char line[FILE_LINE_LEN];
 
 	// reset file pointer to beginning of file
 	if (_rewind) {
@@ -144,50 +146,84 @@ ssize_t MeterFile::read(std::vector<Reading> &rds, size_t n) {
 	}
 
 	unsigned int i = 0;
-	print(log_debug, "MeterFile::read: %d, %d", "", rds.size(), n);
+	PRINT(log_debug, "MeterFile::read: %d, %d", "", rds.size(), n);
 
-	while (i<n && fgets(line, 256, _fd)) {
-		char *nl;
-		if ((nl = strrchr(line, '\n'))) *nl = '\0'; // remove trailing newlines
-		if ((nl = strrchr(line, '\r'))) *nl = '\0';
+	while (i<n && fgets(line, FILE_LINE_LEN, _fd)) {
+		if (_parse_line(line, rds[i])) {
+			i++; // read successfully
+		}
+	}
 
-		if (_format != "") {
-			double timestamp=-1.0;
+	return i;
+}
 
-			// at least the value has to been read
-			double value=0.0;
+/**
+ * Lines are parsed as soon as they are complete, i.e. the newline has been fed
+ */
+size_t MeterFile::feed(const uint8_t *data, size_t len, vz::protocol::ReadingSink &sink) {
+	size_t lines = 0;
 
-			print(log_debug, "MeterFile::read: '%s'", "", line);
-			int found = sscanf(line, format(), &value, &string, &timestamp);
-			print(log_debug, "MeterFile::read: %lf, %s, %lf", "", value, string? string : "<null>", timestamp);
+	for (size_t i = 0; i < len; i++) {
+		_line[_line_len++] = data[i];
 
+		/* long lines are split like fgets() does */
+		if (data[i] == '\n' || _line_len >= FILE_LINE_LEN - 1) {
+			_line[_line_len] = '\0';
+			_line_len = 0;
 
-			rds[i].value(value);
-			ReadingIdentifier *rid(new StringIdentifier(string ? string : "<null>"));
-			rds[i].identifier(rid);
-			if (found >= 1) {
-				if (timestamp >=0.0)
-					rds[i].time(rds[i].dtotv(timestamp)); // convert double to timevals
-				else
-					rds[i].time(); // use current timestamp
-				i++; // read successfully
-			}
-			if (string){
-				free(string);
-				string = 0;
+			Reading rd;
+			if (_parse_line(_line, rd)) {
+				sink.push(rd);
 			}
+			lines++;
 		}
-		else { // just reading a value per line
-			rds[i].value(strtod(line, &endptr));
-			rds[i].time();
-			ReadingIdentifier* rid(new StringIdentifier(""));
-			rds[i].identifier(rid);
-
-			if (endptr != line) {
-				i++; // read successfully
-			}
+	}
+
+	return lines;
+}
+
+bool MeterFile::_parse_line(char *line, Reading &rd) {
+	char *endptr;
+	char *string=0;
+	char *nl;
+
+	if ((nl = strrchr(line, '\n'))) *nl = '\0'; // remove trailing newlines
+	if ((nl = strrchr(line, '\r'))) *nl = '\0';
+
+	if (_format != "") {
+		double timestamp=-1.0;
+
+		// at least the value has to been read
+		double value=0.0;
+
+		PRINT(log_debug, "MeterFile::read: '%s'", "", line);
+		int found = sscanf(line, format(), &value, &string, &timestamp);
+		PRINT(log_debug, "MeterFile::read: %lf, %s, %lf", "", value, string? string : "<null>", timestamp);
+
+
+		rd.value(value);
+		rd.id(IdentifierTable::lookup(StringIdentifier(string ? string : "<null>")));
+		if (string){
+			free(string);
+			string = 0;
+		}
+		if (found >= 1 && rd.id() != 0) { // skip unconfigured identifiers
+			if (timestamp >=0.0)
+				rd.time(rd.dtotv(timestamp)); // convert double to timevals
+			else
+				rd.time(); // use current timestamp
+			return true;
 		}
 	}
+	else { // just reading a value per line
+		rd.value(strtod(line, &endptr));
+		rd.time();
+		rd.id(_id_empty);
 
-	return i;
+		if (endptr != line) {
+			return true;
+		}
+	}
+
+	return false;
 }
@@ -37,6 +37,8 @@
 
 MeterFluksoV2::MeterFluksoV2(std::list<Option> options)
 		: Protocol("fluksov2")
+		, _fd(-1)
+		, _line_len(0)
 {
 	OptionList optlist;
 
@@ -76,19 +78,46 @@ int MeterFluksoV2::close() {
 
 ssize_t MeterFluksoV2::read(std::vector<Reading> &rds, size_t n) {
 
-	size_t i = 0;		/* number of readings */
-	ssize_t bytes = 0;	/* read_line() return code */
-	char line[64];		/* stores each line read */
-	char *cursor = line;	/* moving cursor for strsep() */
+	vz::protocol::VectorSink sink(rds, n);
+	char c;		/* character buffer */
+	ssize_t r;
 
-	do {
-		bytes = _read_line(_fd, line, 64); /* blocking read of a complete line */
-		if (bytes < 0) {
+	do { /* blocking read of a complete line */
+		r = ::read(_fd, &c, 1); /* read byte-per-byte, not to consume the next line */
+		if (r < 0) {
 			print(log_error, "read_line(%s): %s", name().c_str(), _fifo, strerror(errno));
-			return bytes; /* an error occured, pass through to caller */
+			return r; /* an error occured, pass through to caller */
+		}
+	} while (r == 0 || feed((const uint8_t *)&c, 1, sink) == 0);
+
+	return sink.size();
+}
+
+/**
+ * Lines are split at '\n' or after FLUKSOV2_LINE_LEN characters, empty lines are skipped
+ */
+size_t MeterFluksoV2::feed(const uint8_t *data, size_t len, vz::protocol::ReadingSink &sink) {
+	size_t lines = 0;
+
+	for (size_t i = 0; i < len; i++) {
+		if (data[i] != '\n') {
+			_line[_line_len++] = data[i];
+			if (_line_len < FLUKSOV2_LINE_LEN) continue;
 		}
-	} while (bytes == 0);
 
+		if (_line_len > 0) {
+			_line[_line_len] = '\0';
+			_parse_line(_line, sink);
+			lines++;
+		}
+		_line_len = 0;
+	}
+
+	return lines;
+}
+
+void MeterFluksoV2::_parse_line(char *line, vz::protocol::ReadingSink &sink) {
+	char *cursor = line;	/* moving cursor for strsep() */
 
 	char *time_str = strsep(&cursor, " \t"); /* first token is the timestamp */
 	struct timeval time;
@@ -97,46 +126,20 @@ ssize_t MeterFluksoV2::read(std::vector<Reading> &rds, size_t n) {
 
 	while (cursor) {
 		int channel = atoi(strsep(&cursor, " \t")) + 1; /* increment by 1 to distinguish between +0 and -0 */
+		const char *consumption = cursor ? strsep(&cursor, " \t") : "0";
+		const char *power = cursor ? strsep(&cursor, " \t") : "0";
+		Reading rd;
 
 		/* consumption - gets negative channel id as identifier! */
-		ReadingIdentifier *rid1(new ChannelIdentifier(-channel));
-		rds[i].time(time);
-		rds[i].identifier(rid1);
-		rds[i].value(atoi(strsep(&cursor, " \t")));
-		i++;
+		rd.time(time);
+		rd.id(IdentifierTable::lookup(ChannelIdentifier(-channel)));
+		rd.value(atoi(consumption));
+		if (rd.id() != 0) sink.push(rd); /* skip unconfigured channels */
 
 		/* power - gets positive channel id as identifier! */
-		ReadingIdentifier *rid2(new ChannelIdentifier(channel));
-		rds[i].time(time);
-		rds[i].identifier(rid2);
-		rds[i].value(atoi(strsep(&cursor, " \t")));
-		i++;
+		rd.time(time);
+		rd.id(IdentifierTable::lookup(ChannelIdentifier(channel)));
+		rd.value(atoi(power));
+		if (rd.id() != 0) sink.push(rd);
 	}
-
-	return i;
-}
-
-
-ssize_t MeterFluksoV2::_read_line(int fd, char  *buffer, size_t n) {
-	size_t i = 0;	/* iterator for buffer */
-	char c;		/* character buffer */
-
-	while (i < n) {
-		ssize_t r = ::read(fd, &c, 1); /* read byte-per-byte, to identify a line break */
-
-		if (r == 1) { /* successful read */
-			switch (c) {
-					case '\n': /* line delimiter */
-						return i;
-
-					default: /* normal character */
-						buffer[i++] = c;
-			}
-		}
-		else if (r < 0) { /* an error occured, pass through to caller */
-			return r;
-		}
-	}
-
-	return i;
 }
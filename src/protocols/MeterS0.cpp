@@ -37,6 +37,8 @@
 MeterS0::MeterS0(std::list<Option> options)
 		: Protocol("s0")
 		, _counter(0)
+		, _id_power(IdentifierTable::intern(StringIdentifier("Power")))
+		, _id_impulse(IdentifierTable::intern(StringIdentifier("Impulse")))
 {
 	OptionList optlist;
 
@@ -123,15 +125,15 @@ ssize_t MeterS0::read(std::vector<Reading> &rds, size_t n) {
 	double value = ( 3600000 ) / ( (t2-t1) * _resolution ) ;
 
 	/* store current timestamp */
-	rds[0].identifier(new StringIdentifier("Power"));
+	rds[0].id(_id_power);
 	rds[0].time(time2);
 	rds[0].value(value);
 
-	rds[1].identifier(new StringIdentifier("Impulse"));
+	rds[1].id(_id_impulse);
 	rds[1].time(time2);
 	rds[1].value(2);
 
-	print(log_debug, "Reading S0 - n=%d power=%f", name().c_str(), n, rds[0].value());
+	PRINT(log_debug, "Reading S0 - n=%d power=%f", name().c_str(), n, rds[0].value());
 	/* wait some ms for debouncing */
 	usleep(30000);
 
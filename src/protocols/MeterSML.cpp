@@ -59,6 +59,9 @@ MeterSML::MeterSML(std::list<Option> options)
 		, _host("")
 		, _device("")
 		, BUFFER_LEN(SML_BUFFER_LEN)
+		, _frame(SML_BUFFER_LEN)
+		, _frame_len(0)
+		, _escaped(false)
 {
 	OptionList optlist;
 
@@ -88,7 +91,7 @@ MeterSML::MeterSML(std::list<Option> options)
 			hx[0]=strtol(hs,NULL,16);
 			_pull.append(hx,1);
 		}
-		print(log_debug,"pullseq len:%d found",name().c_str(),_pull.size());
+		PRINT(log_debug,"pullseq len:%d found",name().c_str(),_pull.size());
 	} catch (vz::OptionNotFoundException &e) {
 		/* using default value if not specified */
 		_pull = "";
@@ -159,6 +162,9 @@ MeterSML::MeterSML(std::list<Option> options)
 MeterSML::MeterSML(const MeterSML &proto)
 		: Protocol(proto)
 		, BUFFER_LEN(SML_BUFFER_LEN)
+		, _frame(SML_BUFFER_LEN)
+		, _frame_len(0)
+		, _escaped(false)
 {
 }
 
@@ -194,15 +200,12 @@ int MeterSML::close() {
 ssize_t MeterSML::read(std::vector<Reading> &rds, size_t n) {
 
 	unsigned char buffer[SML_BUFFER_LEN];
-	size_t bytes, m = 0;
-
-	sml_file *file;
-	sml_get_list_response *body;
-	sml_list *entry;
+	size_t bytes;
+	vz::protocol::VectorSink sink(rds, n);
 
 	if (_pull.size()) {
 		int wlen = write(_fd,_pull.c_str(),_pull.size());
-		print(log_debug,"sending pullsequenz send (len:%d is:%d).", name().c_str(), _pull.size(), wlen);
+		PRINT(log_debug,"sending pullsequenz send (len:%d is:%d).", name().c_str(), _pull.size(), wlen);
 	}
 
 	/* wait until we receive a new datagram from the meter (blocking read) */
@@ -213,8 +216,69 @@ ssize_t MeterSML::read(std::vector<Reading> &rds, size_t n) {
 		return(0);
 	}
 
+	return _parse_frame(buffer, bytes, sink); // return number of successful readings
+}
+
+/**
+ * Find transport frames like sml_transport_read() does
+ *
+ * A frame starts with 1b1b1b1b 01010101 and consists of 4 byte words.
+ * It ends with the escape sequence 1b1b1b1b followed by 1a and 3 bytes
+ * padding and checksum. Other escaped sequences are not supported.
+ */
+size_t MeterSML::feed(const uint8_t *data, size_t len, vz::protocol::ReadingSink &sink) {
+	static const unsigned char esc_seq[] = { 0x1b, 0x1b, 0x1b, 0x1b };
+	size_t frames = 0;
+
+	for (size_t i = 0; i < len; i++) {
+		unsigned char byte = data[i];
+
+		/* wait for start sequence */
+		if (_frame_len < 8) {
+			if ((byte == 0x1b && _frame_len < 4) || (byte == 0x01 && _frame_len >= 4)) {
+				_frame[_frame_len++] = byte;
+			} else {
+				_frame_len = 0;
+			}
+			continue;
+		}
+
+		_frame[_frame_len++] = byte;
+		if ((_frame_len % 4) != 0) continue; /* word incomplete */
+
+		unsigned char *word = &_frame[_frame_len - 4];
+		if (_escaped) {
+			_escaped = false;
+
+			if (word[0] == 0x1a) { /* end sequence */
+				_parse_frame(&_frame[0], _frame_len, sink);
+				frames++;
+			} else {
+				print(log_error, "Unrecognized escape sequence", name().c_str());
+			}
+			_frame_len = 0;
+		}
+		else if (memcmp(word, esc_seq, 4) == 0) {
+			_escaped = true;
+		}
+		else if (_frame_len + 8 >= _frame.size()) {
+			print(log_error, "Message too long", name().c_str());
+			_frame_len = 0;
+		}
+	}
+
+	return frames;
+}
+
+size_t MeterSML::_parse_frame(unsigned char *buffer, size_t len, vz::protocol::ReadingSink &sink) {
+	size_t m = 0;
+
+	sml_file *file;
+	sml_get_list_response *body;
+	sml_list *entry;
+
 	/* parse SML file & stripping escape sequences */
-	file = sml_file_parse(buffer + 8, bytes - 16);
+	file = sml_file_parse(buffer + 8, len - 16);
 
 	/* obtain SML messagebody of type getResponseList */
 	for (short i = 0; i < file->messages_len; i++) {
@@ -225,9 +289,9 @@ ssize_t MeterSML::read(std::vector<Reading> &rds, size_t n) {
 			entry = body->val_list;
 
 			/* iterating through linked list */
-			for (; m < n && entry != NULL;) {
-				if (_parse(entry, &rds[m])) m++;
-				entry = entry->next;
+			for (; entry != NULL; entry = entry->next) {
+				Reading rd;
+				if (_parse(entry, &rd) && sink.push(rd)) m++;
 			}
 		}
 	}
@@ -235,7 +299,7 @@ ssize_t MeterSML::read(std::vector<Reading> &rds, size_t n) {
 	/* free the malloc'd memory */
 	sml_file_free(file);
 
-	return m; // return number of successful readings
+	return m;
 }
 
 bool MeterSML::_parse(sml_list *entry, Reading *rd) {
@@ -249,6 +313,11 @@ bool MeterSML::_parse(sml_list *entry, Reading *rd) {
 						(unsigned char)entry->obj_name->str[4],
 						(unsigned char)entry->obj_name->str[5]);
 	if (obis.isValid() && entry->value != NULL){
+		rd->id(IdentifierTable::lookup(ObisIdentifier(obis)));
+		if (rd->id() == 0) {
+			return false; // no channel configured for this OBIS code
+		}
+
 		// some entries might contain a string so check type and use proper rd->value(...) call
 		// if the entry does contain a string we can either throw it away or try to convert it to
 		// a value. We throw it away for now as its octet encoded and would need some conversion
@@ -260,9 +329,6 @@ bool MeterSML::_parse(sml_list *entry, Reading *rd) {
 			rd->value(sml_value_to_double(entry->value) * pow(10, scaler));
 		}
 
-		ReadingIdentifier *rid(new ObisIdentifier(obis));
-		rd->identifier(rid);
-
 		// TODO handle SML_TIME_SEC_INDEX or time by SML File/Message
 		struct timeval tv;
 		if (entry->val_time) { /* use time from meter */
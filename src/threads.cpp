@@ -29,10 +29,6 @@
 #include "Reading.hpp"
 #include "vzlogger.h"
 #include "threads.h"
-#include <ApiIF.hpp>
-#include <api/Volkszaehler.hpp>
-#include <api/MySmartGrid.hpp>
-#include <api/Null.hpp>
 
 extern Config_Options options;
 
@@ -40,13 +36,136 @@ void reading_thread_cleanup(void *rds) {
 	free(rds);
 }
 
+/**
+ * Read once from the meter and add the readings to the channel buffers
+ *
+ * @param tick timestamp for all readings in us, -1 keeps the time of the meter
+ */
+size_t read_meter(MeterMap *mapping, std::vector<Reading> &rds, int64_t tick) {
+	/* fetch readings from meter and calculate delta */
+	size_t n = mapping->meter()->read(rds, rds.size(), tick);
+
+	/* channels survive a reload, never cancel while holding their locks */
+	int state;
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+	route_readings(mapping, rds, n);
+	pthread_setcancelstate(state, NULL);
+	return n;
+}
+
+/**
+ * Add the first n readings to the buffers of the channels configured for them
+ */
+void route_readings(MeterMap *mapping, std::vector<Reading> &rds, size_t n) {
+	Meter::Ptr mtr = mapping->meter();
+
+	/* dumping meter output */
+	if (LOG_ENABLED((log_level_t)(log_debug + 1))) {
+		PRINT(log_debug, "Got %i new readings from meter:", mtr->name(), n);
+
+		char identifier[MAX_IDENTIFIER_LEN];
+		for (size_t i = 0; i < n; i++) {
+			rds[i].unparse(/*mtr->protocolId(),*/ identifier, MAX_IDENTIFIER_LEN);
+			PRINT(log_debug, "Reading: id=%s/%s value=%.2f ts=%.3f", mtr->name(),
+					identifier, rds[i].identifier()->toString().c_str(),
+					rds[i].value(), rds[i].tvtod());
+		}
+	}
+
+	/* update buffer length with current interval */
+//	if (details->periodic == FALSE && delta > 0 && delta != mtr->interval()) {
+//		print(log_debug, "Updating interval to %i", mtr->name(), delta);
+//		mtr->interval(delta);
+//	}
+
+	/* insert readings into channel queues */
+	for (size_t i = 0; i < n; i++) {
+		const MeterMap::route_t *route = mapping->route(rds[i].id());
+		if (route == NULL) {
+			continue; /* no channel configured for this identifier */
+		}
+
+		for (MeterMap::route_t::const_iterator ch = route->begin(); ch != route->end(); ch++) {
+			if ((*ch)->time_us() < rds[i].time_us()) {
+				(*ch)->last(rds[i]);
+			}
+
+			PRINT(log_info, "Adding reading to queue (value=%.2f ts=%.3f)", (*ch)->name(),
+					rds[i].value(), rds[i].tvtod());
+			(*ch)->push(rds[i]);
+		}
+	}
+
+	/* update buffer length */
+	if (options.local()) {
+		for (MeterMap::iterator ch = mapping->begin(); ch!=mapping->end(); ch++) {
+			(*ch)->buffer()->keep((mtr->interval() > 0) ? ceil(options.buffer_length() / mtr->interval()) : 0);
+		}
+	}
+}
+
+/**
+ * End of an aggregation period: aggregate the buffers and hand them to the uploader
+ */
+void publish_channels(MeterMap *mapping) {
+	Meter::Ptr mtr = mapping->meter();
+
+	for (MeterMap::iterator ch = mapping->begin(); ch!=mapping->end(); ch++) {
+
+		/* aggregate buffer values if aggmode != NONE */
+		(*ch)->buffer()->aggregate(mtr->aggtime(), mtr->aggFixedInterval());
+
+		if (options.logging()) {
+			/* move readings to the logging queue and wake up the uploader */
+			size_t left = (*ch)->publish();
+
+			/* backpressure: hold the meter until the uploader made room */
+			time_t until = time(NULL) + (*ch)->backpressure();
+			while (left > 0 && time(NULL) < until) {
+				(*ch)->wait_drained(1000);
+				left = (*ch)->publish();
+			}
+		} else {
+			/* shrink buffer, only the local interface uses it */
+			(*ch)->buffer()->shrink();
+		}
+
+		/* mark buffer "ready" */
+		(*ch)->buffer()->have_newValues();
+
+		/* notify webserver */
+		(*ch)->notify();
+
+		/* debugging */
+		if (LOG_ENABLED(log_debug)) {
+			size_t dump_len = 24;
+			char *dump = (char*)malloc(dump_len);
+
+			if (dump == NULL) {
+				print(log_error, "Cannot allocate buffer", (*ch)->name());
+			}
+
+			while (dump == NULL || (*ch)->dump(dump, dump_len) == NULL) {
+				dump_len *= 1.5;
+				free(dump);
+				dump = (char*)malloc(dump_len);
+			}
+
+			PRINT(log_debug, "Buffer dump (size=%i keep=%i dropped=%lu downsampled=%lu suppressed=%lu): %s",
+					(*ch)->name(), (*ch)->size(), (*ch)->keep(), (*ch)->dropped(), (*ch)->downsampled(),
+					(*ch)->suppressed(), dump);
+
+			free(dump);
+		}
+	}
+}
+
 void * reading_thread(void *arg) {
 	std::vector<Reading> rds;
 	MeterMap *mapping = static_cast<MeterMap *>(arg);
 	Meter::Ptr  mtr = mapping->meter();
 	time_t aggIntEnd;
 	const meter_details_t *details;
-	size_t n = 0;
 
 	details = meter_get_details(mtr->protocolId());
 
@@ -58,167 +177,56 @@ void * reading_thread(void *arg) {
 
 	//pthread_cleanup_push(&reading_thread_cleanup, rds);
 
-	print(log_debug, "Number of readers: %d", mtr->name(), details->max_readings);
-	print(log_debug, "Config.daemon: %d", mtr->name(), options.daemon());
-	print(log_debug, "Config.local: %d", mtr->name(), options.local());
+	PRINT(log_debug, "Number of readers: %d", mtr->name(), details->max_readings);
+	PRINT(log_debug, "Config.daemon: %d", mtr->name(), options.daemon());
+	PRINT(log_debug, "Config.local: %d", mtr->name(), options.local());
 
 
 	try {
+		int64_t tick = -1;
+		if (mtr->sync() > 0) {
+			tick = mapping->wait_tick(); /* first reading on the shared tick */
+		}
+
 		aggIntEnd = time(NULL);
 		do { /* start thread main loop */
 			aggIntEnd += mtr->aggtime(); /* end of this aggregation period */
 			do { /* aggregate loop */
-				/* fetch readings from meter and calculate delta */
-				n = mtr->read(rds, details->max_readings);
-
-				/* dumping meter output */
-				if (options.verbosity() > log_debug) {
-					print(log_debug, "Got %i new readings from meter:", mtr->name(), n);
-
-					char identifier[MAX_IDENTIFIER_LEN];
-					for (size_t i = 0; i < n; i++) {
-						rds[i].unparse(/*mtr->protocolId(),*/ identifier, MAX_IDENTIFIER_LEN);
-						print(log_debug, "Reading: id=%s/%s value=%.2f ts=%.3f", mtr->name(),
-								identifier, rds[i].identifier()->toString().c_str(),
-								rds[i].value(), rds[i].tvtod());
-					}
-				}
+				read_meter(mapping, rds, (mtr->sync() > 0) ? tick : -1);
 
-				/* update buffer length with current interval */
-//				if (details->periodic == FALSE && delta > 0 && delta != mtr->interval()) {
-//					print(log_debug, "Updating interval to %i", mtr->name(), delta);
-//					mtr->interval(delta);
-//				}
-
-				/* insert readings into channel queues */
-				for (MeterMap::iterator ch = mapping->begin(); ch!=mapping->end(); ch++) {
-					Reading *add = NULL;
-
-					//print(log_debug, "Check channel %s, n=%d", mtr->name(), ch->name(), n);
-
-					for (size_t i = 0; i < n; i++) {
-						if (*rds[i].identifier().get() == *(*ch)->identifier().get()) {
-							//print(log_debug, "found channel", mtr->name());
-							if ((*ch)->tvtod() < rds[i].tvtod()) {
-								(*ch)->last(&rds[i]);
-							}
-
-							print(log_info, "Adding reading to queue (value=%.2f ts=%.3f)", (*ch)->name(),
-									rds[i].value(), rds[i].tvtod());
-							(*ch)->push(rds[i]);
-
-							if (add == NULL) {
-								add = &rds[i]; /* remember first reading which has been added to the buffer */
-							}
-						}
-					}
-
-					/* update buffer length */
-					if (options.local()) {
-						(*ch)->buffer()->keep((mtr->interval() > 0) ? ceil(options.buffer_length() / mtr->interval()) : 0);
-					}
-				} // channel loop
+				/* synchronized meters read once per tick, each with its own timestamp */
+				if (mtr->sync() > 0 && mtr->aggtime() > 0 && time(NULL) < aggIntEnd) {
+					tick = mapping->wait_tick();
+				}
 			} while((mtr->aggtime() > 0) && (time(NULL) < aggIntEnd)); /* default aggtime is -1 */
 
-			for (MeterMap::iterator ch = mapping->begin(); ch!=mapping->end(); ch++) {
-
-				/* aggregate buffer values if aggmode != NONE */
-				(*ch)->buffer()->aggregate(mtr->aggtime(), mtr->aggFixedInterval());
-				/* mark buffer "ready" */
-				(*ch)->buffer()->have_newValues();
-
-				/* shrink buffer */
-				(*ch)->buffer()->clean();
-
-				/* notify webserver and logging thread */
-				(*ch)->notify();
-
-				/* debugging */
-				if (options.verbosity() >= log_debug) {
-					size_t dump_len = 24;
-					char *dump = (char*)malloc(dump_len);
-
-					if (dump == NULL) {
-						print(log_error, "Cannot allocate buffer", (*ch)->name());
-					}
-
-					while (dump == NULL || (*ch)->dump(dump, dump_len) == NULL) {
-						dump_len *= 1.5;
-						free(dump);
-						dump = (char*)malloc(dump_len);
-					}
-
-					print(log_debug, "Buffer dump (size=%i keep=%i): %s", (*ch)->name(),
-							(*ch)->size(), (*ch)->keep(), dump);
-
-					free(dump);
-				}
-			}
+			int state;
+			pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+			publish_channels(mapping);
+			pthread_setcancelstate(state, NULL);
 
 			if (mtr->interval() > 0) {
-				print(log_info, "Next reading in %i seconds", mtr->name(), mtr->interval());
-				sleep(mtr->interval());
+				/* absolute deadline, the time spent reading does not shift the next one */
+				PRINT(log_debug, "Waiting for next reading", mtr->name());
+				tick = mapping->wait_tick();
+				if (tick < 0) {
+					print(log_info, "Next reading in %i seconds", mtr->name(), mtr->interval());
+					sleep(mtr->interval());
+				}
 			}
 		} while (options.daemon() || options.local() || options.logging() );
 	} catch (std::exception &e) {
 		std::stringstream oss;
 		oss << e.what();
 		print(log_error, "Reading-THREAD - reading got an exception : %s", mtr->name(), e.what());
+		mapping->exited();
 		pthread_exit(0);
 	}
 
-	print(log_debug, "Stopped reading. ", mtr->name());
+	PRINT(log_debug, "Stopped reading. ", mtr->name());
 	//pthread_cleanup_pop(1);
 
+	mapping->exited();
 	pthread_exit(0);
 	return NULL;
 }
-
-void logging_thread_cleanup(/*void *arg*/) {
-//	api_handle_t *api = (api_handle_t *) arg;
-
-//	api_free(api);
-}
-
-void * logging_thread(void *arg) {
-	Channel::Ptr ch;
-	ch.reset(static_cast<Channel *>(arg)); /* casting argument */
-	print(log_debug, "Start logging thread for %s-api. Running as daemon: %s", ch->name(),
-				ch->apiProtocol().c_str(), options.daemon() ? "yes" : "no");
-
-	// create configured api interfaces
-	// NOTE: if additional APIs are introduced both threads.cpp and MeterMap.cpp need to be updated
-	vz::ApiIF::Ptr api;
-	if (ch->apiProtocol() == "mysmartgrid") {
-		api =  vz::ApiIF::Ptr(new vz::api::MySmartGrid(ch, ch->options()));
-		print(log_debug, "Using MySmartGrid api.", ch->name());
-	}
-	else if (ch->apiProtocol() == "null") {
-		api =  vz::ApiIF::Ptr(new vz::api::Null(ch, ch->options()));
-		print(log_debug, "Using null api- meter data available via local httpd if enabled.", ch->name());
-	} else {
-		// default == volkszaehler
-		api =  vz::ApiIF::Ptr(new vz::api::Volkszaehler(ch, ch->options()));
-		print(log_debug, "Using default volkszaehler api.", ch->name());
-	}
-
-	//pthread_cleanup_push(&logging_thread_cleanup, &api);
-
-	do { /* start thread mainloop */
-		try {
-			ch->wait();
-
-			api->send();
-		}
-		catch (std::exception &e) {
-			print(log_error, "Logging thread failed due to: %s", ch->name(), e.what());
-		}
-
-	} while (options.logging());
-
-	print(log_debug, "Stopped logging. (daemon=%d)", ch->name(), options.daemon());
-	pthread_exit(0);
-	//pthread_cleanup_pop(1);
-
-	return NULL;
-}
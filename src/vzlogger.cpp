@@ -41,6 +41,7 @@
 
 #include <Config_Options.hpp>
 #include <Meter.hpp>
+#include <Logger.hpp>
 #include "Obis.hpp"
 #include "vzlogger.h"
 #include "Channel.hpp"
@@ -53,6 +54,7 @@
 
 MapContainer mappings;		// mapping between meters and channels
 Config_Options options;		// global application options
+Logger logger;				// backend of print()
 bool gStop = false;
 size_t gSkippedFailed = 0;	// disabled or failed meters
 
@@ -103,43 +105,18 @@ void print(log_level_t level, const char *format, const char *id, ... ) {
 		return; /* skip message if its under the verbosity level */
 	}
 
-	struct timeval now;
-	struct tm * timeinfo;
-	char prefix[24];
-	size_t pos = 0;
-
-	gettimeofday(&now, NULL);
-	timeinfo = localtime(&now.tv_sec);
-
-	/* format timestamp */
-	pos += strftime(prefix+pos, 18, "[%b %d %H:%M:%S]", timeinfo);
-
-	/* format section */
-	if (id) {
-		snprintf(prefix+pos, 8, "[%s]", (char *) id);
-	}
-
+	/* formatted in the calling thread, written by the logging thread */
 	va_list args;
 	va_start(args, id);
-	/* print to stdout/stderr */
-	if (getppid() != 1) { /* running as fork in background? */
-		FILE *stream = (level > 0) ? stdout : stderr;
-
-		fprintf(stream, "%-24s", prefix);
-		vfprintf(stream, format, args);
-		fprintf(stream, "\n");
-	}
+	logger.log(level, id, format, args);
 	va_end(args);
+}
 
-	va_start(args, id);
-	/* append to logfile */
-	if (options.logfd()) {
-		fprintf(options.logfd(), "%-24s", prefix);
-		vfprintf(options.logfd(), format, args);
-		fprintf(options.logfd(), "\n");
-		fflush(options.logfd());
-	}
-	va_end(args);
+/**
+ * Would print() write a message of this level? Used by PRINT()
+ */
+bool print_enabled(log_level_t level) {
+	return level <= options.verbosity();
 }
 
 /**
@@ -228,13 +205,33 @@ void daemonize() {
 }
 
 /**
- * Cancel threads
+ * Signal handler, wakes up the main loop
  *
- * Threads gets joined in main()
+ * Threads get cancelled and joined in main(), SIGHUP reloads the configuration
  */
 void quit(int sig) {
-	//gStop = true;
-	mappings.quit(sig);
+	mappings.signal(sig);
+}
+
+/**
+ * Parse the configuration file again and apply it to the running meters
+ *
+ * Global options (verbosity, local interface, number of threads) keep
+ * their values until a restart.
+ */
+void reload() {
+	Config_Options fresh_options(options.config());
+	MapContainer fresh;
+
+	print(log_info, "Reloading configuration from %s", (char*)0, options.config().c_str());
+	try {
+		fresh_options.config_parse(fresh);
+	} catch (std::exception &e) {
+		print(log_error, "Reload failed, keeping the running configuration: %s", (char*)0, e.what());
+		return;
+	}
+
+	mappings.reload(fresh);
 }
 
 /**
@@ -364,6 +361,12 @@ int main(int argc, char *argv[]) {
 	// make sure command line options override config settings, just re-parse
 	config_parse_cli(argc, argv, &options);
 
+	/* global budget for buffered readings, not changed by a reload */
+	Buffer::budget(options.memory());
+	if (Buffer::budget() > 0 && Buffer::reserved() > Buffer::budget()) {
+		print(log_warning, "Global memory budget exceeded by logging queues", NULL);
+	}
+
 	// Register vzlogger
 	if (options.doRegistration()) {
 		register_device();
@@ -373,7 +376,7 @@ int main(int argc, char *argv[]) {
 	// @todo clarify why no logging in local mode
 	options.logging((!options.local() || options.daemon()));
 
-	print(log_debug, "daemon=%d, local=%d", "main", options.daemon(), options.local());
+	PRINT(log_debug, "daemon=%d, local=%d", "main", options.daemon(), options.local());
 
 	if (options.daemon() || options.local()) {
 		print(log_info, "Daemonize process...", (char*)0);
@@ -393,24 +396,44 @@ int main(int argc, char *argv[]) {
 		}
 
 		options.logfd(logfd);
-		print(log_debug, "Opened logfile %s", (char*)0, options.log().c_str());
+		logger.logfile(logfd);
+		PRINT(log_debug, "Opened logfile %s", (char*)0, options.log().c_str());
 	}
 
+	/* threads do not survive daemonize(), start the writer afterwards */
+	logger.start();
+
 	if (mappings.size() <= 0) {
 		print(log_error, "No meters found - quitting!", (char*)0);
 		return EXIT_FAILURE;
 	}
 
-	print(log_debug, "===> Start meters", "");
+	PRINT(log_debug, "===> Start meters", "");
 	try {
 		// open connection meters & start threads
 		for (MapContainer::iterator it = mappings.begin(); it != mappings.end(); it++) {
-			it->start();
+			it->start(mappings);
 			if (!it->running()) {
 				gSkippedFailed++;
 			}
 		}
 
+		// wake up meters with an interval
+		if (mappings.scheduler().size() > 0) {
+			mappings.scheduler().start();
+		}
+
+		// read meters which send by themselves
+		if (mappings.reactor().size() > 0) {
+			mappings.reactor().start(options.reactor());
+		}
+
+		// start sending readings of all logging channels
+		if (options.logging()) {
+			mappings.uploader().backoff(options.retry_pause(), options.retry_max());
+			mappings.uploader().start(options.uploaders(), options.parallel());
+		}
+
 		// quit if not at least one meter is enabled and working
 		if (mappings.size() - gSkippedFailed <= 0) {
 			print(log_error, "No functional meters found - quitting!", (char*)0);
@@ -434,11 +457,22 @@ int main(int argc, char *argv[]) {
 		print(log_error, "Startup failed: %s", "", e.what());
 		exit(1);
 	}
-	print(log_debug, "Startup done.", "");
+	PRINT(log_debug, "Startup done.", "");
 
 	try {
 		do {
-			/* wait for all threads to terminate */
+			/* woken up by signals and terminating reading threads */
+			mappings.wait(1000);
+
+			if (mappings.pending_signal()) {
+				mappings.quit(mappings.pending_signal());
+				gStop = true;
+			}
+			else if (mappings.pending_reload()) {
+				reload();
+			}
+
+			/* stop if a meter terminated */
 			for (MapContainer::iterator it = mappings.begin(); it != mappings.end(); it++) {
 				bool ret = it->stopped();
 				if (ret) gStop = true;
@@ -447,7 +481,10 @@ int main(int argc, char *argv[]) {
 	} catch (std::exception &e) {
 		print(log_error, "Main loop failed for %s", "", e.what());
 	}
-	print(log_debug, "Server stopped.", "");
+	mappings.reactor().stop();
+	mappings.scheduler().stop();
+	mappings.uploader().stop();
+	PRINT(log_debug, "Server stopped.", "");
 
 #ifdef LOCAL_SUPPORT
 	/* stop webserver */
@@ -460,6 +497,8 @@ int main(int argc, char *argv[]) {
 	curl_global_cleanup();
 
 	/* close logfile */
+	logger.stop();
+	logger.logfile(NULL);
 	if (options.logfd()) {
 		fclose(options.logfd());
 	}
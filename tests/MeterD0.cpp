@@ -26,6 +26,22 @@ void print(log_level_t l, char const*s1, char const*s2, ...)
 	}
 }
 
+bool print_enabled(log_level_t l)
+{
+	return l != log_debug;
+}
+
+/* the parser passes readings of configured channels only */
+static void configure(const char * const *codes)
+{
+	for (; *codes != NULL; codes++) {
+		IdentifierTable::intern(ObisIdentifier(Obis(*codes)));
+	}
+	IdentifierTable::freeze();
+}
+
+static const char * const ehz_codes[] = { "1-0:1.8.0*255", "1-0:1.7.0*255", "1-0:1.9.0*255", NULL };
+
 int writes(int fd, const char *str)
 {
 	EXPECT_NE((char*)0, str);
@@ -34,6 +50,7 @@ int writes(int fd, const char *str)
 }
 
 TEST(MeterD0, HagerEHZ_basic) {
+	configure(ehz_codes);
 	char tempfilename[L_tmpnam+1];
 	ASSERT_NE(tmpnam_r(tempfilename), (char*)0);
 	std::list<Option> options;
@@ -87,7 +104,72 @@ TEST(MeterD0, HagerEHZ_basic) {
 	EXPECT_EQ(0, unlink(tempfilename));
 }
 
+TEST(MeterD0, feed_chunks) {
+	configure(ehz_codes);
+	std::list<Option> options;
+	options.push_back(Option("device", (char*)"/dev/null"));
+	MeterD0 m(options);
+
+	std::vector<Reading> rds;
+	rds.resize(10);
+	vz::protocol::VectorSink sink(rds, rds.size());
+
+	const char *telegrams =
+		"/HAG5eHZ010C_EHZ1vA02\r\n"
+		"1-0:1.8.0*255(000001.2963)\r\n"
+		"!\n"
+		"/HAG5eHZ010C_EHZ1vA02\r\n"
+		"1-0:1.7.0*255(000001.2964)\r\n"
+		"1-0:1.9.0*255(000001.2965)\r\n"
+		"!\n";
+
+	// feed in chunks which end in the middle of lines and values
+	const uint8_t *data = (const uint8_t *)telegrams;
+	size_t len = strlen(telegrams);
+	EXPECT_EQ(0u, m.feed(data, 30, sink));
+	EXPECT_EQ(0u, sink.size());
+	EXPECT_EQ(1u, m.feed(data + 30, 22, sink));
+	EXPECT_EQ(1u, sink.size());
+	EXPECT_EQ(0u, m.feed(data + 52, 40, sink));
+	EXPECT_EQ(1u, m.feed(data + 92, len - 92, sink));
+	ASSERT_EQ(3u, sink.size());
+
+	EXPECT_EQ(1.2963, rds[0].value());
+	EXPECT_EQ(1.2964, rds[1].value());
+	EXPECT_EQ(1.2965, rds[2].value());
+
+	ObisIdentifier *o = dynamic_cast<ObisIdentifier*>(rds[2].identifier().get());
+	ASSERT_NE((ObisIdentifier*)0, o);
+	EXPECT_TRUE(Obis(1, 0, 1, 9, 0, 255)==(o->obis()));
+}
+
+TEST(MeterD0, feed_skips_unconfigured) {
+	configure(ehz_codes);
+	std::list<Option> options;
+	options.push_back(Option("device", (char*)"/dev/null"));
+	MeterD0 m(options);
+
+	std::vector<Reading> rds;
+	rds.resize(10);
+	vz::protocol::VectorSink sink(rds, rds.size());
+
+	const char *telegram =
+		"/HAG5eHZ010C_EHZ1vA02\r\n"
+		"1-0:2.8.0*255(000002.0000)\r\n"
+		"1-0:1.8.0*255(000001.2963)\r\n"
+		"1-0:96.5.5*255(000003.0000)\r\n"
+		"!\n";
+
+	size_t n = IdentifierTable::size();
+	EXPECT_EQ(1u, m.feed((const uint8_t *)telegram, strlen(telegram), sink));
+	ASSERT_EQ(1u, sink.size());
+	EXPECT_EQ(1.2963, rds[0].value());
+	EXPECT_EQ(n, IdentifierTable::size()); // unknown codes are not interned
+}
+
 TEST(MeterD0, HagerEHZ_waitsync) {
+	const char * const codes[] = { "2-1:2.3.4*255", NULL };
+	configure(codes);
 	char tempfilename[L_tmpnam+1];
 	char strend[5] = "end\0";
 	ASSERT_NE(tmpnam_r(tempfilename), (char*)0);
@@ -130,6 +212,8 @@ TEST(MeterD0, HagerEHZ_waitsync) {
 }
 
 TEST(MeterD0, LandisGyr_basic) {
+	const char * const codes[] = { "F.F", "0.0.0", "1.8.1", "1.8.2", "2.8.1", "2.8.2", "1.8.0", "2.8.0", NULL };
+	configure(codes);
 	char tempfilename[L_tmpnam+1];
 	char str_pullseq[12] = "2f3f210d0a";
 	ASSERT_NE(tmpnam_r(tempfilename), (char*)0);
@@ -214,6 +298,8 @@ TEST(MeterD0, LandisGyr_basic) {
 int writes_hex(int fd, const char *str);
 
 TEST(MeterD0, ACE3000_basic) {
+	const char * const codes[] = { "F.F", "C.1", "C.5.0", "1.8.0", NULL };
+	configure(codes);
 	char tempfilename[L_tmpnam+1];
 	char str_pullseq[12] = "2f3f210d0a";
 	ASSERT_NE(tmpnam_r(tempfilename), (char*)0);
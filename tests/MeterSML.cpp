@@ -28,7 +28,17 @@ int writes_hex(int fd, const char *str)
 	return toret;
 }
 
+/* the parser passes readings of configured channels only */
+static void configure()
+{
+	IdentifierTable::intern(ObisIdentifier(Obis(1, 0, 1, 8, 1, 255)));
+	IdentifierTable::intern(ObisIdentifier(Obis(1, 0, 1, 8, 2, 255)));
+	IdentifierTable::intern(ObisIdentifier(Obis(1, 0, 1, 7, 0, 255)));
+	IdentifierTable::freeze();
+}
+
 TEST(MeterSML, EMH_basic) {
+	configure();
 	char tempfilename[L_tmpnam+1];
 	ASSERT_NE(tmpnam_r(tempfilename), (char*)0);
 	std::list<Option> options;
@@ -177,3 +187,37 @@ TEST(MeterSML, EMH_basic) {
 
 
 
+
+TEST(MeterSML, feed) {
+	configure();
+	std::list<Option> options;
+	options.push_back(Option("device", (char*)"/dev/null"));
+	MeterSML m(options);
+
+	const char *hex = "1B1B1B1B010101017607003600001AFA6200620072630101760101070036044808FE09303232383038313601016331ED007607003600001AFB62006200726307017701093032323830383136017262016504487D897677078181C78203FF0101010104454D480177070100000000FF010101010930323238303831360177070100010801FF63018001621E52FF560008D1CF1B0177070100010802FF63018001621E52FF560000004E9C01770700006001FFFF010101010B303030323238303831360177070100010700FF0101621B52FF550000007001010163D201007607003600001AFC6200620072630201710163077A00001B1B1B1B1A019D37";
+	std::vector<uint8_t> data;
+	for (size_t i = 0; i < strlen(hex); i += 2) {
+		unsigned char c;
+		sscanf(&hex[i], "%2hhx", &c);
+		data.push_back(c);
+	}
+
+	std::vector<Reading> rds;
+	rds.resize(10);
+	vz::protocol::VectorSink sink(rds, rds.size());
+
+	// some noise before the start sequence, then the frame in odd sized chunks
+	const uint8_t noise[] = { 0x00, 0x1b, 0x42 };
+	size_t frames = m.feed(noise, sizeof(noise), sink);
+	for (size_t pos = 0; pos < data.size(); pos += 7) {
+		size_t len = std::min((size_t)7, data.size() - pos);
+		frames += m.feed(&data[pos], len, sink);
+	}
+	EXPECT_EQ(1u, frames);
+	ASSERT_EQ(3u, sink.size());
+
+	ObisIdentifier *o = dynamic_cast<ObisIdentifier*>(rds[1].identifier().get());
+	ASSERT_NE((ObisIdentifier*)0, o);
+	EXPECT_EQ(2012.4, rds[1].value());
+	EXPECT_TRUE(Obis(1, 0, 1, 8, 2, 255)==(o->obis()));
+}
@@ -0,0 +1,202 @@
+/**
+ * Micro benchmark for the reading buffer
+ *
+ * Compares the bounded ring buffer against the previous std::list based
+ * implementation for the operations done by the reading and logging threads:
+ * push, aggregate and acknowledge.
+ *
+ * @package vzlogger
+ * @license http://opensource.org/licenses/gpl-license.php GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <list>
+
+#include "common.h"
+#include "Buffer.hpp"
+
+// same hack as the unit tests
+#include "../../src/Buffer.cpp"
+#include "../../src/Reading.cpp"
+#include "../../src/Obis.cpp"
+
+void print(log_level_t level, const char *format, const char *id, ... ) {
+	(void)level; (void)format; (void)id;
+}
+
+/**
+ * Reference: the list based buffer (push, mark_delete and erase)
+ */
+class ListBuffer {
+	struct Entry {
+		Reading rd;
+		bool deleted;
+	};
+	typedef std::list<Entry>::iterator iterator;
+
+	public:
+	void push(const Reading &rd) {
+		Entry e = { rd, false };
+		lock();
+		_sent.push_back(e);
+		unlock();
+	}
+
+	/* single pass of the former SUM aggregation */
+	void aggregate() {
+		lock();
+		Reading *latest = NULL;
+		double sum = 0;
+		for (iterator it = _sent.begin(); it != _sent.end(); it++) {
+			if (!latest || it->rd.tvtod() > latest->tvtod()) latest = &it->rd;
+			sum += it->rd.value();
+		}
+		for (iterator it = _sent.begin(); it != _sent.end(); it++) {
+			if (&it->rd == latest) it->rd.value(sum);
+			else it->deleted = true;
+		}
+		unlock();
+		clean();
+	}
+
+	void clean() {
+		lock();
+		for (iterator it = _sent.begin(); it != _sent.end(); it++) {
+			if (it->deleted) {
+				it = _sent.erase(it);
+				it--;
+			}
+		}
+		unlock();
+	}
+
+	void mark_all() {
+		for (iterator it = _sent.begin(); it != _sent.end(); it++) {
+			it->deleted = true;
+		}
+	}
+
+	size_t size() const { return _sent.size(); }
+
+	ListBuffer() { pthread_mutex_init(&_mutex, NULL); }
+	~ListBuffer() { pthread_mutex_destroy(&_mutex); }
+
+	private:
+	void lock()   { pthread_mutex_lock(&_mutex); }
+	void unlock() { pthread_mutex_unlock(&_mutex); }
+
+	std::list<Entry> _sent;
+	pthread_mutex_t _mutex;
+};
+
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *what, size_t ops, double list_time, double ring_time) {
+	printf("%-28s %10.1f ns/op %10.1f ns/op %6.2fx\n", what,
+				 list_time * 1e9 / ops, ring_time * 1e9 / ops, list_time / ring_time);
+}
+
+int main(int argc, char *argv[]) {
+	size_t window = (argc > 1) ? atoi(argv[1]) : 64;	/* readings per aggregation window */
+	size_t rounds = (argc > 2) ? atoi(argv[2]) : 20000;
+	size_t backlog = window * 64;						/* readings queued during an outage */
+
+	ReadingIdentifier::Ptr id(new StringIdentifier("bench"));
+	struct timeval tv = { 0, 0 };
+	Reading rd(1.0, tv, id);
+	double t, t_list, t_ring;
+
+	printf("window=%lu rounds=%lu backlog=%lu\n",
+				 (unsigned long)window, (unsigned long)rounds, (unsigned long)backlog);
+	printf("%-28s %16s %16s %7s\n", "", "list", "ring", "speedup");
+
+	/* push + aggregate + acknowledge per window, like the reading thread */
+	{
+		ListBuffer list;
+		Buffer ring(window * 2);
+		ring.set_aggmode(Buffer::SUM);
+
+		t = now();
+		for (size_t r = 0; r < rounds; r++) {
+			for (size_t i = 0; i < window; i++) list.push(rd);
+			list.aggregate();
+			list.mark_all();
+			list.clean();
+		}
+		t_list = now() - t;
+
+		t = now();
+		for (size_t r = 0; r < rounds; r++) {
+			for (size_t i = 0; i < window; i++) ring.push(rd);
+			ring.aggregate(0, false);
+			ring.acknowledge(ring.size());
+		}
+		t_ring = now() - t;
+
+		report("push+aggregate+ack", rounds * window, t_list, t_ring);
+	}
+
+	/* push only, buffer keeps growing up to the backlog */
+	{
+		ListBuffer list;
+		Buffer ring(backlog);
+		size_t n = rounds * window / backlog + 1;
+
+		t = now();
+		for (size_t r = 0; r < n; r++) {
+			for (size_t i = 0; i < backlog; i++) list.push(rd);
+			list.mark_all();
+			list.clean();
+		}
+		t_list = now() - t;
+
+		t = now();
+		for (size_t r = 0; r < n; r++) {
+			for (size_t i = 0; i < backlog; i++) ring.push(rd);
+			ring.acknowledge(ring.size());
+		}
+		t_ring = now() - t;
+
+		report("push+ack (backlog)", n * backlog, t_list, t_ring);
+	}
+
+	/* steady state overflow: list is unbounded, ring drops the oldest */
+	{
+		Buffer ring(backlog);
+		size_t n = rounds * window;
+
+		t = now();
+		for (size_t i = 0; i < n; i++) ring.push(rd);
+		t_ring = now() - t;
+
+		printf("%-28s %16s %10.1f ns/op (dropped %lu)\n", "push on full ring", "-",
+					 t_ring * 1e9 / n, ring.dropped());
+	}
+
+	printf("memory per reading: list %lu bytes + malloc overhead, ring %lu bytes\n",
+				 (unsigned long)(sizeof(Reading) + 2 * sizeof(void *)), (unsigned long)sizeof(Reading));
+
+	return 0;
+}
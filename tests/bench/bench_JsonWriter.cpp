@@ -0,0 +1,117 @@
+/**
+ * Micro benchmark for the request body of the volkszaehler api
+ *
+ * Compares the streaming writer against the json-c object tree formerly
+ * built for the tuples [[<ms>,<value>],...] of a backlog: one array and
+ * two doubles allocated per tuple, then formatted by json-c.
+ *
+ * @package vzlogger
+ * @license http://opensource.org/licenses/gpl-license.php GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include <json/json.h>
+
+#include "api/JsonWriter.hpp"
+
+// same hack as the unit tests
+#include "../../src/api/JsonWriter.cpp"
+
+struct tuple {
+	uint64_t timestamp;
+	double value;
+};
+
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Reference: the body as built by json-c
+ */
+static size_t json_c(const std::vector<tuple> &tuples) {
+	json_object *json_tuples = json_object_new_array();
+
+	for (size_t i = 0; i < tuples.size(); i++) {
+		json_object *json_tuple = json_object_new_array();
+		json_object_array_add(json_tuple, json_object_new_double(tuples[i].timestamp));
+		json_object_array_add(json_tuple, json_object_new_double(tuples[i].value));
+		json_object_array_add(json_tuples, json_tuple);
+	}
+
+	size_t len = strlen(json_object_to_json_string(json_tuples));
+	json_object_put(json_tuples);
+	return len;
+}
+
+static size_t writer(vz::api::JsonWriter &json, const std::vector<tuple> &tuples) {
+	json.clear();
+	json.open_array();
+	for (size_t i = 0; i < tuples.size(); i++) {
+		json.tuple(tuples[i].timestamp, tuples[i].value);
+	}
+	json.close_array();
+	return json.size();
+}
+
+int main(int argc, char *argv[]) {
+	size_t backlog = (argc > 1) ? atoi(argv[1]) : 50000;	/* tuples queued during an outage */
+	size_t rounds = (argc > 2) ? atoi(argv[2]) : 20;
+	unsigned int seed = 1;
+
+	/* a reading per second with a few decimals, like an electricity meter */
+	std::vector<tuple> power(backlog), counter(backlog);
+	for (size_t i = 0; i < backlog; i++) {
+		power[i].timestamp = counter[i].timestamp = 1400000000000ULL + i * 1000;
+		power[i].value = (rand_r(&seed) % 500000) / 100.0;
+		counter[i].value = 12345678.9 + i * 0.1;
+	}
+
+	printf("backlog=%lu rounds=%lu\n", (unsigned long)backlog, (unsigned long)rounds);
+	printf("%-20s %16s %16s %7s %14s\n", "", "json-c", "writer", "speedup", "bytes");
+
+	const char *names[] = { "power (2 decimals)", "counter (growing)" };
+	std::vector<tuple> *sets[] = { &power, &counter };
+	vz::api::JsonWriter json;
+
+	for (int s = 0; s < 2; s++) {
+		size_t len_c = 0, len_w = 0;
+		double t, t_c, t_w;
+
+		t = now();
+		for (size_t r = 0; r < rounds; r++) len_c = json_c(*sets[s]);
+		t_c = now() - t;
+
+		t = now();
+		for (size_t r = 0; r < rounds; r++) len_w = writer(json, *sets[s]);
+		t_w = now() - t;
+
+		printf("%-20s %10.1f ns/tp %10.1f ns/tp %6.2fx %6lu %6lu\n", names[s],
+					 t_c * 1e9 / (rounds * backlog), t_w * 1e9 / (rounds * backlog), t_c / t_w,
+					 (unsigned long)(len_c / backlog), (unsigned long)(len_w / backlog));
+	}
+
+	return 0;
+}
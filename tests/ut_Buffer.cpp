@@ -0,0 +1,243 @@
+#include "gtest/gtest.h"
+#include "Buffer.hpp"
+
+// Buffer.cpp is already included by ut_api_volkszaehler.cpp
+
+static Reading reading(double value, time_t sec) {
+	struct timeval tv;
+	tv.tv_sec = sec;
+	tv.tv_usec = 0;
+	return Reading(value, tv, ReadingIdentifier::Ptr());
+}
+
+TEST(Buffer, push_grows_up_to_capacity) {
+	Buffer buf(100);
+	for (int i = 0; i < 100; i++) buf.push(reading(i, i));
+
+	ASSERT_EQ(100u, buf.size());
+	ASSERT_EQ(0u, buf.dropped());
+
+	int expect = 0;
+	for (Buffer::iterator it = buf.begin(); it != buf.end(); it++) {
+		EXPECT_EQ(expect++, it->value());
+	}
+	EXPECT_EQ(100, expect);
+}
+
+TEST(Buffer, overflow_drop_oldest) {
+	Buffer buf(10);
+	for (int i = 0; i < 25; i++) buf.push(reading(i, i));
+
+	ASSERT_EQ(10u, buf.size());
+	EXPECT_EQ(15u, buf.dropped());
+	EXPECT_EQ(15, buf.begin()->value());
+
+	int expect = 15;
+	for (Buffer::iterator it = buf.begin(); it != buf.end(); ++it) {
+		EXPECT_EQ(expect++, it->value());
+	}
+}
+
+TEST(Buffer, overflow_drop_newest) {
+	Buffer buf(10);
+	buf.overflow_policy(Buffer::DROP_NEWEST);
+	for (int i = 0; i < 25; i++) buf.push(reading(i, i));
+
+	ASSERT_EQ(10u, buf.size());
+	EXPECT_EQ(15u, buf.dropped());
+
+	int expect = 0;
+	for (Buffer::iterator it = buf.begin(); it != buf.end(); ++it) {
+		EXPECT_EQ(expect++, it->value());
+	}
+}
+
+TEST(Buffer, acknowledge_keeps_order_across_wrap) {
+	Buffer buf(8);
+	for (int i = 0; i < 13; i++) buf.push(reading(i, i)); // ring wrapped: 5..12
+
+	buf.acknowledge(3);
+	ASSERT_EQ(5u, buf.size());
+	int expect = 8;
+	for (Buffer::iterator it = buf.begin(); it != buf.end(); it++) {
+		EXPECT_EQ(expect++, it->value());
+	}
+
+	// pushing after acknowledge appends behind the remaining readings
+	buf.push(reading(42, 42));
+	ASSERT_EQ(6u, buf.size());
+	Buffer::iterator last = buf.begin();
+	for (size_t i = 0; i < 5; i++) last++;
+	EXPECT_EQ(42, last->value());
+
+	buf.acknowledge(100);
+	EXPECT_EQ(0u, buf.size());
+	EXPECT_EQ(5u, buf.dropped()); // acknowledged readings are not counted
+}
+
+TEST(Buffer, shrink_to_keep) {
+	Buffer buf;
+	buf.keep(5);
+	for (int i = 0; i < 20; i++) buf.push(reading(i, i));
+	buf.shrink();
+
+	ASSERT_EQ(5u, buf.size());
+	EXPECT_EQ(15, buf.begin()->value());
+	EXPECT_EQ(0u, buf.dropped());
+}
+
+TEST(Buffer, reduce_capacity) {
+	Buffer buf(50);
+	for (int i = 0; i < 50; i++) buf.push(reading(i, i));
+	buf.capacity(20);
+
+	ASSERT_EQ(20u, buf.size());
+	EXPECT_EQ(30u, buf.dropped());
+	EXPECT_EQ(30, buf.begin()->value());
+}
+
+TEST(Buffer, aggregate_sum) {
+	Buffer buf;
+	buf.set_aggmode(Buffer::SUM);
+	for (int i = 1; i <= 4; i++) buf.push(reading(i, i));
+	buf.aggregate(0, false);
+
+	ASSERT_EQ(1u, buf.size());
+	EXPECT_EQ(10, buf.begin()->value());
+	EXPECT_EQ(4, buf.begin()->tvtod());
+}
+
+TEST(Buffer, aggregate_incremental_windows) {
+	Buffer buf;
+	buf.set_aggmode(Buffer::AVG);
+
+	for (int i = 1; i <= 1000; i++) buf.push(reading(i % 10, 100 + i));
+	EXPECT_EQ(0u, buf.size()); // raw readings are not stored
+	buf.aggregate(0, false);
+	ASSERT_EQ(1u, buf.size());
+	EXPECT_DOUBLE_EQ(4.5, buf.begin()->value());
+
+	// empty window adds nothing
+	buf.aggregate(0, false);
+	EXPECT_EQ(1u, buf.size());
+
+	buf.set_aggmode(Buffer::MAX);
+	buf.push(reading(-3, 2000));
+	buf.push(reading(-7, 2001));
+	buf.aggregate(0, false);
+	ASSERT_EQ(2u, buf.size());
+	Buffer::iterator it = buf.begin();
+	it++;
+	EXPECT_EQ(-3, it->value());
+	EXPECT_EQ(2001, it->tvtod());
+}
+
+TEST(Buffer, aggregate_fixed_interval) {
+	Buffer buf;
+	buf.set_aggmode(Buffer::SUM);
+	buf.push(reading(1, 1234));
+	buf.push(reading(1, 1299));
+	buf.aggregate(300, true);
+
+	ASSERT_EQ(1u, buf.size());
+	EXPECT_EQ(2, buf.begin()->value());
+	EXPECT_EQ(1200, buf.begin()->tvtod());
+}
+
+TEST(Buffer, aggregate_min_last) {
+	Buffer buf;
+	buf.set_aggmode(Buffer::MIN);
+	buf.push(reading(5, 10));
+	buf.push(reading(2, 11));
+	buf.push(reading(7, 12));
+	buf.aggregate(0, false);
+	EXPECT_EQ(2, buf.begin()->value());
+
+	Buffer last;
+	last.set_aggmode(Buffer::LAST);
+	last.push(reading(5, 10));
+	last.push(reading(9, 12));
+	last.push(reading(7, 11)); // out of order
+	last.aggregate(0, false);
+	EXPECT_EQ(9, last.begin()->value());
+}
+
+TEST(Buffer, aggregate_time_weighted) {
+	Buffer buf;
+	buf.set_aggmode(Buffer::TWAVG);
+	// 100W for 9s, then a single 1000W sample 1s later
+	buf.push(reading(100, 0));
+	buf.push(reading(100, 9));
+	buf.push(reading(1000, 10));
+	buf.aggregate(0, false);
+	// (100*9 + 550*1) / 10
+	EXPECT_DOUBLE_EQ(145, buf.begin()->value());
+}
+
+TEST(Buffer, aggregate_integral_across_windows) {
+	Buffer buf;
+	buf.set_aggmode(Buffer::INTEGRAL);
+	buf.push(reading(1000, 0));
+	buf.push(reading(1000, 1800));
+	buf.aggregate(0, false);
+
+	// second window starts at the last reading of the first one
+	buf.push(reading(3000, 3600));
+	buf.aggregate(0, false);
+
+	ASSERT_EQ(2u, buf.size());
+	Buffer::iterator it = buf.begin();
+	EXPECT_DOUBLE_EQ(500, it->value());	// 1kW for 0.5h
+	it++;
+	EXPECT_DOUBLE_EQ(1000, it->value());	// ramp 1kW -> 3kW for 0.5h
+}
+
+TEST(Buffer, aggregate_counter_delta) {
+	Buffer buf;
+	buf.set_aggmode(Buffer::DELTA);
+	buf.push(reading(1000, 1));
+	buf.push(reading(1004, 2));
+	buf.aggregate(0, false);
+	buf.push(reading(1010, 3));
+	buf.push(reading(1015, 4));
+	buf.aggregate(0, false);
+
+	ASSERT_EQ(2u, buf.size());
+	Buffer::iterator it = buf.begin();
+	EXPECT_EQ(4, it->value());
+	it++;
+	EXPECT_EQ(11, it->value());
+}
+
+TEST(Buffer, overflow_downsample) {
+	Buffer buf(8);
+	buf.overflow_policy(Buffer::DOWNSAMPLE);
+	for (int i = 0; i < 9; i++) buf.push(reading(i, i));
+
+	// (0,1) and (2,3) merged, newer half untouched
+	ASSERT_EQ(7u, buf.size());
+	EXPECT_EQ(0u, buf.dropped());
+	EXPECT_EQ(2u, buf.downsampled());
+
+	double expect[] = { 0.5, 2.5, 4, 5, 6, 7, 8 };
+	int i = 0;
+	for (Buffer::iterator it = buf.begin(); it != buf.end(); it++, i++) {
+		EXPECT_DOUBLE_EQ(expect[i], it->value());
+	}
+	EXPECT_EQ(1, buf.begin()->tvtod()); // timestamp of the newer reading
+}
+
+TEST(Buffer, global_budget) {
+	size_t reserved = Buffer::reserved();
+	Buffer::budget(reserved + 64 * sizeof(Reading));
+
+	Buffer buf(1000);
+	for (int i = 0; i < 200; i++) buf.push(reading(i, i));
+	Buffer::budget(0);
+
+	// initial 32 slots, grown once to 64, not allowed to grow to 128
+	EXPECT_EQ(64u, buf.size());
+	EXPECT_EQ(136u, buf.dropped());
+	EXPECT_EQ(136, buf.begin()->value());
+	EXPECT_EQ(reserved + 64 * sizeof(Reading), Buffer::reserved());
+}
@@ -0,0 +1,111 @@
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "gtest/gtest.h"
+#include "api/CurlShare.hpp"
+
+#include "../src/api/CurlShare.cpp"
+
+using vz::api::CurlShare;
+
+TEST(CurlShare, one_per_host) {
+	CurlShare::Ptr a = CurlShare::get("http://localhost/middleware.php");
+	CurlShare::Ptr b = CurlShare::get("http://localhost/other/middleware.php");
+	CurlShare::Ptr c = CurlShare::get("http://localhost:8080/middleware.php");
+
+	EXPECT_EQ(a.get(), b.get());
+	EXPECT_NE(a.get(), c.get());
+	EXPECT_EQ("http://localhost:8080", c->host());
+	EXPECT_EQ(2u, CurlShare::hosts());
+
+	a.reset();
+	EXPECT_EQ(2u, CurlShare::hosts()); /* still used by b */
+	b.reset();
+	c.reset();
+	EXPECT_EQ(0u, CurlShare::hosts());
+}
+
+/* answers requests on keep-alive connections, one connection at a time */
+struct server {
+	int fd;
+	int port;
+	volatile int accepted;
+	volatile int requests;
+};
+
+static void *serve(void *arg) {
+	server *srv = static_cast<server *>(arg);
+	int conn;
+
+	while ((conn = accept(srv->fd, NULL, NULL)) >= 0) {
+		__sync_add_and_fetch(&srv->accepted, 1);
+
+		std::string buf;
+		char data[1024];
+		ssize_t n;
+		while ((n = read(conn, data, sizeof(data))) > 0) {
+			buf.append(data, n);
+			size_t end;
+			while ((end = buf.find("\r\n\r\n")) != std::string::npos) {
+				buf.erase(0, end + 4);
+				__sync_add_and_fetch(&srv->requests, 1);
+				const char *answer = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok";
+				if (write(conn, answer, strlen(answer)) < 0) break;
+			}
+		}
+		close(conn);
+	}
+	return NULL;
+}
+
+static size_t discard(void *ptr, size_t size, size_t nmemb, void *data) {
+	return size * nmemb;
+}
+
+TEST(CurlShare, handles_reuse_connection) {
+	server srv = { socket(AF_INET, SOCK_STREAM, 0), 0, 0, 0 };
+	struct sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	ASSERT_EQ(0, bind(srv.fd, (struct sockaddr *) &addr, sizeof(addr)));
+	ASSERT_EQ(0, listen(srv.fd, 4));
+	getsockname(srv.fd, (struct sockaddr *) &addr, &len);
+	srv.port = ntohs(addr.sin_port);
+
+	pthread_t thread;
+	pthread_create(&thread, NULL, &serve, &srv);
+
+	char url[64];
+	snprintf(url, sizeof(url), "http://127.0.0.1:%d/data/uuid.json", srv.port);
+	CurlShare::Ptr share = CurlShare::get(url);
+
+	/* two channels of the same middleware, one after the other */
+	CURL *handles[2];
+	for (int i = 0; i < 2; i++) {
+		handles[i] = curl_easy_init();
+		share->attach(handles[i]);
+		curl_easy_setopt(handles[i], CURLOPT_URL, url);
+		curl_easy_setopt(handles[i], CURLOPT_WRITEFUNCTION, &discard);
+		curl_easy_setopt(handles[i], CURLOPT_NOSIGNAL, 1L);
+		curl_easy_setopt(handles[i], CURLOPT_TIMEOUT, 2L);
+	}
+	for (int round = 0; round < 2; round++) {
+		for (int i = 0; i < 2; i++) {
+			EXPECT_EQ(CURLE_OK, curl_easy_perform(handles[i]));
+		}
+	}
+	EXPECT_EQ(4, srv.requests);
+	EXPECT_EQ(1, srv.accepted);
+
+	for (int i = 0; i < 2; i++) {
+		curl_easy_cleanup(handles[i]);
+	}
+	share.reset(); /* closes the connection */
+
+	shutdown(srv.fd, SHUT_RDWR);
+	close(srv.fd);
+	pthread_join(thread, NULL);
+}
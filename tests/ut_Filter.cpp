@@ -0,0 +1,123 @@
+#include "gtest/gtest.h"
+#include "Filter.hpp"
+
+#include "../src/Filter.cpp"
+
+static Reading reading(double value, time_t sec) {
+	struct timeval tv;
+	tv.tv_sec = sec;
+	tv.tv_usec = 0;
+	return Reading(value, tv, ReadingIdentifier::Ptr());
+}
+
+TEST(Filter, disabled_passes_everything) {
+	Filter f;
+	Reading out[2];
+	EXPECT_FALSE(f.enabled());
+	EXPECT_EQ(1u, f.apply(reading(1, 1), out));
+	EXPECT_EQ(1u, f.apply(reading(1, 2), out));
+}
+
+TEST(Filter, heartbeat_only_passes_everything) {
+	Filter f;
+	Reading out[2];
+	f.heartbeat(60);
+
+	EXPECT_FALSE(f.enabled());
+	EXPECT_EQ(1u, f.apply(reading(1, 1), out));
+	EXPECT_EQ(1u, f.apply(reading(1, 2), out));
+	EXPECT_EQ(0u, f.suppressed());
+}
+
+TEST(Filter, absolute_deadband_keeps_step) {
+	Filter f;
+	Reading out[2];
+	f.deadband(0.5, 0);
+
+	EXPECT_EQ(1u, f.apply(reading(10, 1), out)); // first one always passes
+	EXPECT_EQ(0u, f.apply(reading(10.2, 2), out));
+	EXPECT_EQ(0u, f.apply(reading(10.4, 3), out));
+	EXPECT_EQ(2u, f.suppressed());
+
+	// change: last suppressed reading goes first
+	ASSERT_EQ(2u, f.apply(reading(12, 4), out));
+	EXPECT_EQ(10.4, out[0].value());
+	EXPECT_EQ(3, out[0].tvtod());
+	EXPECT_EQ(12, out[1].value());
+
+	// band is relative to the last forwarded value
+	EXPECT_EQ(0u, f.apply(reading(11.6, 5), out));
+	ASSERT_EQ(2u, f.apply(reading(11.4, 6), out));
+}
+
+TEST(Filter, relative_deadband_and_heartbeat) {
+	Filter f;
+	Reading out[2];
+	f.deadband(0, 0.01);
+	f.heartbeat(60);
+
+	EXPECT_EQ(1u, f.apply(reading(1000, 0), out));
+	EXPECT_EQ(0u, f.apply(reading(1009, 30), out));
+	EXPECT_EQ(0u, f.apply(reading(1005, 59), out));
+
+	// nothing forwarded for 60s
+	ASSERT_EQ(1u, f.apply(reading(1005, 60), out));
+	EXPECT_EQ(1005, out[0].value());
+	EXPECT_EQ(0u, f.apply(reading(1006, 61), out));
+}
+
+TEST(Filter, change_only) {
+	Filter f;
+	Reading out[2];
+	f.deadband(0, 0);
+
+	EXPECT_EQ(1u, f.apply(reading(5, 1), out));
+	EXPECT_EQ(0u, f.apply(reading(5, 2), out));
+	EXPECT_EQ(2u, f.apply(reading(6, 3), out));
+	EXPECT_EQ(1u, f.apply(reading(7, 4), out));
+}
+
+TEST(Filter, swinging_door_linear_ramp) {
+	Filter f;
+	Reading out[2];
+	f.compression(0.1);
+
+	EXPECT_EQ(1u, f.apply(reading(0, 0), out));
+	for (int i = 1; i <= 100; i++) {
+		ASSERT_EQ(0u, f.apply(reading(i * 2, i), out)) << i; // on a straight line
+	}
+	EXPECT_EQ(99u, f.suppressed());
+
+	// bend: end of the ramp is forwarded
+	ASSERT_EQ(1u, f.apply(reading(200, 101), out));
+	EXPECT_EQ(200, out[0].value());
+	EXPECT_EQ(100, out[0].tvtod());
+}
+
+TEST(Filter, swinging_door_error_bound) {
+	Filter f;
+	Reading out[2];
+	f.compression(1);
+
+	// noise within the deviation around a constant
+	double values[] = { 10, 10.5, 9.6, 10.4, 9.7, 10.2, 9.5, 10.1 };
+	size_t forwarded = 0;
+	for (int i = 0; i < 8; i++) forwarded += f.apply(reading(values[i], i), out);
+	EXPECT_EQ(1u, forwarded);
+
+	// step is outside
+	EXPECT_EQ(1u, f.apply(reading(20, 8), out));
+	EXPECT_EQ(7, out[0].tvtod());
+}
+
+TEST(Filter, swinging_door_heartbeat) {
+	Filter f;
+	Reading out[2];
+	f.compression(1);
+	f.heartbeat(10);
+
+	EXPECT_EQ(1u, f.apply(reading(5, 0), out));
+	size_t forwarded = 0;
+	for (int i = 1; i <= 30; i++) forwarded += f.apply(reading(5, i), out);
+	EXPECT_EQ(3u, forwarded); // at 9, 19 and 29
+}
@@ -0,0 +1,60 @@
+#include "gtest/gtest.h"
+#include "Health.hpp"
+
+#include "../src/Health.cpp"
+
+TEST(Health, host_of) {
+	EXPECT_EQ("http://localhost", Health::host_of("http://localhost/middleware.php"));
+	EXPECT_EQ("https://demo.volkszaehler.org:8443", Health::host_of("https://demo.volkszaehler.org:8443/middleware/"));
+	EXPECT_EQ("http://localhost", Health::host_of("http://localhost"));
+	EXPECT_EQ("", Health::host_of(""));
+}
+
+TEST(Health, single_probe) {
+	Health h("http://localhost", 1);
+	EXPECT_TRUE(h.admit(0));
+	EXPECT_FALSE(h.success());
+
+	EXPECT_TRUE(h.failure(0, 10, 600));
+	EXPECT_EQ(Health::OPEN, h.state());
+	EXPECT_FALSE(h.failure(0, 10, 600)); /* sent before the breaker opened */
+	EXPECT_EQ(1u, h.failures());
+
+	/* jitter keeps the backoff between half and full length */
+	EXPECT_GE(h.retry_at(), 5000000);
+	EXPECT_LE(h.retry_at(), 10000000);
+
+	EXPECT_FALSE(h.admit(h.retry_at() - 1));
+	EXPECT_TRUE(h.admit(h.retry_at()));
+	EXPECT_EQ(Health::PROBING, h.state());
+	EXPECT_FALSE(h.admit(h.retry_at())); /* only one probe */
+
+	EXPECT_TRUE(h.success());
+	EXPECT_EQ(Health::CLOSED, h.state());
+	EXPECT_EQ(0u, h.failures());
+}
+
+TEST(Health, backoff_grows_to_limit) {
+	Health h("http://localhost", 2);
+	int64_t now = 0;
+
+	for (int i = 0; i < 10; i++) {
+		EXPECT_TRUE(h.failure(now, 10, 60));
+		int64_t delay = h.retry_at() - now;
+		int64_t full = (i < 3) ? (10000000LL << i) : 60000000LL;
+		EXPECT_GE(delay, full / 2);
+		EXPECT_LE(delay, full);
+
+		now = h.retry_at();
+		EXPECT_TRUE(h.admit(now));
+	}
+	EXPECT_EQ(10u, h.failures());
+
+	/* cancelled probe: the next request probes right away */
+	h.failure(now, 10, 60);
+	now = h.retry_at();
+	EXPECT_TRUE(h.admit(now));
+	h.cancel();
+	EXPECT_EQ(Health::OPEN, h.state());
+	EXPECT_TRUE(h.admit(now));
+}
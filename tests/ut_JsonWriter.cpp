@@ -0,0 +1,97 @@
+#include <math.h>
+#include <string>
+#include "gtest/gtest.h"
+#include "api/JsonWriter.hpp"
+
+#include "../src/api/JsonWriter.cpp"
+
+using vz::api::JsonWriter;
+
+static std::string format(double value) {
+	char out[JSON_NUMBER_LEN];
+	return std::string(out, JsonWriter::format(out, value));
+}
+
+TEST(JsonWriter, structure) {
+	JsonWriter json;
+	EXPECT_TRUE(json.empty());
+	EXPECT_STREQ("", json.c_str());
+
+	json.open_array();
+	json.open_object();
+	json.key("uuid");
+	json.string("a\"b\\c\n");
+	json.key("tuples");
+	json.open_array();
+	json.tuple(1400000000000LL, 230.45);
+	json.tuple(1400000001000LL, -1);
+	json.close_array();
+	json.close_object();
+	json.integer(-9223372036854775807LL - 1);
+	json.open_array();
+	json.close_array();
+	json.close_array();
+
+	EXPECT_STREQ("[{\"uuid\":\"a\\\"b\\\\c\\u000a\",\"tuples\":[[1400000000000,230.45],[1400000001000,-1]]},"
+				"-9223372036854775808,[]]", json.c_str());
+	EXPECT_EQ(strlen(json.c_str()), json.size());
+}
+
+TEST(JsonWriter, numbers) {
+	EXPECT_EQ("0", format(0.0));
+	EXPECT_EQ("-0", format(-0.0));
+	EXPECT_EQ("1", format(1.0));
+	EXPECT_EQ("0.1", format(0.1));
+	EXPECT_EQ("0.05", format(0.05));
+	EXPECT_EQ("-12.5", format(-12.5));
+	EXPECT_EQ("230.45", format(230.45));
+	EXPECT_EQ("123456.789", format(123456.789));
+	EXPECT_EQ("9007199254740991", format(9007199254740991.0));
+	EXPECT_EQ("0.30000000000000004", format(0.1 + 0.2));
+	EXPECT_EQ("1e-20", format(1e-20));
+	EXPECT_EQ("1e+300", format(1e300));
+	EXPECT_EQ("null", format(NAN));
+	EXPECT_EQ("null", format(INFINITY));
+}
+
+TEST(JsonWriter, round_trip) {
+	unsigned int seed = 42;
+
+	for (int i = 0; i < 100000; i++) {
+		double value;
+		if (i % 2) {
+			/* arbitrary bit patterns */
+			uint64_t bits = ((uint64_t)rand_r(&seed) << 33) ^ ((uint64_t)rand_r(&seed) << 11) ^ rand_r(&seed);
+			memcpy(&value, &bits, sizeof(value));
+			if (!isfinite(value)) continue;
+		} else {
+			/* readings of meters */
+			value = (rand_r(&seed) % 2000000 - 1000000) / pow(10, rand_r(&seed) % 6);
+		}
+
+		std::string text = format(value);
+		ASSERT_EQ(value, strtod(text.c_str(), NULL)) << text;
+		ASSERT_LE(text.size(), (size_t)24) << text;
+	}
+}
+
+TEST(JsonWriter, buffer_is_reused) {
+	JsonWriter json(8);
+
+	json.open_array();
+	for (int i = 0; i < 1000; i++) {
+		json.tuple(i, i / 4.0);
+	}
+	json.close_array();
+	EXPECT_EQ(std::string("[[0,0],[1,0.25],[2,0.5],"), std::string(json.c_str(), 24));
+
+	const char *data = json.c_str();
+	json.clear();
+	EXPECT_TRUE(json.empty());
+
+	json.open_array();
+	json.tuple(1, 2);
+	json.close_array();
+	EXPECT_EQ(data, json.c_str());
+	EXPECT_STREQ("[[1,2]]", json.c_str());
+}
@@ -0,0 +1,136 @@
+#include <stdarg.h>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "Logger.hpp"
+
+#include "../src/Logger.cpp"
+
+static void log(Logger &logger, log_level_t level, const char *id, const char *format, ...) {
+	va_list args;
+	va_start(args, format);
+	logger.log(level, id, format, args);
+	va_end(args);
+}
+
+static std::vector<std::string> lines(FILE *file) {
+	std::vector<std::string> result;
+	char line[4096];
+
+	rewind(file);
+	while (fgets(line, sizeof(line), file) != NULL) {
+		result.push_back(std::string(line, strlen(line) - 1));
+	}
+	return result;
+}
+
+TEST(Logger, synchronous_before_start) {
+	Logger logger;
+	FILE *file = tmpfile();
+	logger.console(false);
+	logger.logfile(file);
+
+	log(logger, log_info, "chn0", "value=%.2f", 1.5);
+	log(logger, log_info, NULL, "general");
+	log(logger, log_info, "scheduler", "truncated section");
+	log(logger, log_info, "chn10", "full section");
+
+	std::vector<std::string> out = lines(file);
+	ASSERT_EQ(4u, out.size());
+	EXPECT_EQ('[', out[0][0]);
+	EXPECT_EQ("][chn0] value=1.50", out[0].substr(16));
+	EXPECT_EQ("]       general", out[1].substr(16));
+	EXPECT_EQ("][schedutruncated section", out[2].substr(16));
+	EXPECT_EQ("][chn10]full section", out[3].substr(16));
+	fclose(file);
+}
+
+struct writer_arg {
+	Logger *logger;
+	int id;
+};
+
+static void *writer(void *arg) {
+	writer_arg *w = static_cast<writer_arg *>(arg);
+	char id[8];
+	snprintf(id, sizeof(id), "t%d", w->id);
+
+	for (int i = 0; i < 100; i++) {
+		log(*w->logger, log_debug, id, "%d", i);
+		if (i % 20 == 0) usleep(1000);
+	}
+	return NULL;
+}
+
+TEST(Logger, threads_in_order) {
+	Logger logger(128);
+	FILE *file = tmpfile();
+	logger.console(false);
+	logger.logfile(file);
+	logger.start();
+
+	pthread_t threads[4];
+	writer_arg args[4];
+	for (int t = 0; t < 4; t++) {
+		args[t].logger = &logger;
+		args[t].id = t;
+		pthread_create(&threads[t], NULL, &writer, &args[t]);
+	}
+	for (int t = 0; t < 4; t++) {
+		pthread_join(threads[t], NULL);
+	}
+	logger.stop();
+
+	std::vector<std::string> out = lines(file);
+	EXPECT_EQ(400u, out.size());
+	EXPECT_EQ(0u, logger.dropped());
+
+	int next[4] = { 0, 0, 0, 0 };
+	for (size_t i = 0; i < out.size(); i++) {
+		int t, n;
+		ASSERT_EQ(2, sscanf(out[i].c_str() + 17, "[t%d] %d", &t, &n));
+		EXPECT_EQ(next[t], n);
+		next[t] = n + 1;
+	}
+	fclose(file);
+}
+
+TEST(Logger, long_and_dropped_messages) {
+	Logger logger(4);
+	FILE *file = tmpfile();
+	logger.console(false);
+	logger.logfile(file);
+	logger.start();
+
+	std::string body(1000, 'x');
+	log(logger, log_debug, "chn0", "JSON request body: %s", body.c_str());
+	for (int i = 0; i < 20; i++) {
+		log(logger, log_debug, "chn0", "%d", i);
+	}
+	logger.stop();
+	EXPECT_LT(0u, logger.dropped());
+
+	std::vector<std::string> out = lines(file);
+	ASSERT_LT(1u, out.size());
+	EXPECT_EQ("JSON request body: " + body, out[0].substr(24));
+	EXPECT_NE(std::string::npos, out.back().find("Dropped"));
+	fclose(file);
+}
+
+static int evaluated = 0;
+
+static const char *expensive() {
+	evaluated++;
+	return "1-0:1.8.0";
+}
+
+TEST(Logger, lazy_arguments) {
+	/* the print() stub of the tests drops log_debug */
+	evaluated = 0;
+	PRINT(log_debug, "Reading: id=%s", "test", expensive());
+	EXPECT_EQ(0, evaluated);
+	EXPECT_FALSE(LOG_ENABLED(log_debug));
+
+	PRINT(log_info, "Reading: id=%s", "test", expensive());
+	EXPECT_EQ(1, evaluated);
+}
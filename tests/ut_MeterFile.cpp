@@ -16,6 +16,14 @@
 
 int writes(int fd, const char *str);
 
+/* the parser passes readings of configured channels only */
+static void configure(const char *id1, const char *id2 = NULL)
+{
+	IdentifierTable::intern(StringIdentifier(id1));
+	if (id2 != NULL) IdentifierTable::intern(StringIdentifier(id2));
+	IdentifierTable::freeze();
+}
+
 TEST(MeterFile, basic) {
 	char tempfilename[L_tmpnam+1];
 	ASSERT_NE(tmpnam_r(tempfilename), (char*)0);
@@ -63,6 +71,7 @@ TEST(MeterFile, basic) {
 }
 
 TEST(MeterFile, format1) {
+	configure("<null>");
 	char tempfilename[L_tmpnam+1];
 	ASSERT_NE(tmpnam_r(tempfilename), (char*)0);
 	std::list<Option> options;
@@ -108,6 +117,7 @@ TEST(MeterFile, format1) {
 }
 
 TEST(MeterFile, format2) {
+	configure("id1", "id2");
 	char tempfilename[L_tmpnam+1];
 	ASSERT_NE(tmpnam_r(tempfilename), (char*)0);
 	std::list<Option> options;
@@ -166,6 +176,7 @@ TEST(MeterFile, reading_times)
 }
 
 TEST(MeterFile, format3) {
+	configure("id1", "id2");
 	char tempfilename[L_tmpnam+1];
 	ASSERT_NE(tmpnam_r(tempfilename), (char*)0);
 	std::list<Option> options;
@@ -213,3 +224,24 @@ TEST(MeterFile, format3) {
 	EXPECT_EQ(0, unlink(tempfilename));
 }
 
+
+TEST(MeterFile, feed) {
+	std::list<Option> options;
+	options.push_back(Option("path", (char*)"/dev/null"));
+	MeterFile m(options);
+
+	std::vector<Reading> rds;
+	rds.resize(2);
+	vz::protocol::VectorSink sink(rds, rds.size());
+
+	// a line split over two chunks is only parsed once it is complete
+	const char *chunk1 = "32552\r\n3255";
+	const char *chunk2 = "2.5\n";
+	EXPECT_EQ(1u, m.feed((const uint8_t *)chunk1, strlen(chunk1), sink));
+	EXPECT_EQ(1u, sink.size());
+	EXPECT_EQ(1u, m.feed((const uint8_t *)chunk2, strlen(chunk2), sink));
+	ASSERT_EQ(2u, sink.size());
+
+	EXPECT_EQ(32552, rds[0].value());
+	EXPECT_EQ(32552.5, rds[1].value());
+}
@@ -0,0 +1,118 @@
+#include <unistd.h>
+#include "gtest/gtest.h"
+#include "Reactor.hpp"
+
+#include "../src/Reactor.cpp"
+
+/* reads from a pipe, unregisters on end of file */
+class PipeHandler : public Reactor::Handler {
+	public:
+	PipeHandler() : bytes(0), calls(0), concurrent(0), overlap(false) {
+		if (pipe(fds) != 0) throw vz::VZException("pipe");
+	}
+	~PipeHandler() { close(fds[0]); if (fds[1] >= 0) close(fds[1]); }
+
+	int fd() const { return fds[0]; }
+
+	bool ready() {
+		if (__sync_add_and_fetch(&concurrent, 1) > 1) overlap = true;
+
+		char buf[16];
+		ssize_t n = read(fds[0], buf, sizeof(buf));
+		if (n > 0) __sync_add_and_fetch(&bytes, n);
+		__sync_add_and_fetch(&calls, 1);
+
+		usleep(1000);
+		__sync_sub_and_fetch(&concurrent, 1);
+		return n > 0;
+	}
+
+	void send(const char *data) { ASSERT_GT(write(fds[1], data, strlen(data)), 0); }
+	void hangup() { close(fds[1]); fds[1] = -1; }
+
+	int fds[2];
+	volatile size_t bytes;
+	volatile size_t calls;
+	volatile int concurrent;
+	volatile bool overlap;
+};
+
+static bool wait_for(volatile size_t &value, size_t expected) {
+	for (int i = 0; i < 500 && value < expected; i++) usleep(2000);
+	return value >= expected;
+}
+
+TEST(Reactor, dispatches_readable_handlers) {
+	Reactor reactor;
+	PipeHandler a, b;
+	reactor.add(&a);
+	reactor.add(&b);
+	EXPECT_EQ(2u, reactor.size());
+
+	reactor.start(4);
+	EXPECT_EQ(2u, reactor.threads()); /* not more threads than handlers */
+
+	b.send("hello");
+	EXPECT_TRUE(wait_for(b.bytes, 5));
+	EXPECT_EQ(0u, a.calls);
+
+	/* one shot: a busy handler is not run twice at once */
+	for (int i = 0; i < 20; i++) a.send("x");
+	EXPECT_TRUE(wait_for(a.bytes, 20));
+	EXPECT_FALSE(a.overlap);
+
+	reactor.stop();
+	EXPECT_EQ(0u, reactor.threads());
+}
+
+TEST(Reactor, removes_finished_handlers) {
+	Reactor reactor;
+	PipeHandler a, b;
+	reactor.add(&a);
+	reactor.add(&b);
+	reactor.start(2);
+
+	a.hangup();
+	for (int i = 0; i < 500 && reactor.size() > 1; i++) usleep(2000);
+	EXPECT_EQ(1u, reactor.size());
+
+	b.hangup();
+	reactor.wait(); /* returns when the last handler is gone */
+	EXPECT_EQ(0u, reactor.size());
+	reactor.stop();
+}
+
+TEST(Reactor, shutdown_wakes_up_waiters) {
+	Reactor reactor;
+	PipeHandler a;
+	reactor.add(&a);
+	reactor.start(1);
+
+	reactor.shutdown();
+	reactor.wait();
+	reactor.wait(); /* returns again for other meters */
+	reactor.stop();
+	EXPECT_EQ(1u, reactor.size());
+}
+
+TEST(Reactor, remove_and_restart) {
+	Reactor reactor;
+	PipeHandler a, b;
+	reactor.add(&a);
+	reactor.add(&b);
+	reactor.start(2);
+
+	reactor.stop();
+	reactor.remove(&a);
+	reactor.remove(&a); /* unknown handlers are ignored */
+	EXPECT_EQ(1u, reactor.size());
+	EXPECT_FALSE(reactor.finished());
+
+	reactor.start(2);
+	EXPECT_EQ(1u, reactor.threads());
+	a.send("lost");
+	b.send("hello");
+	EXPECT_TRUE(wait_for(b.bytes, 5));
+	EXPECT_EQ(0u, a.calls);
+	reactor.stop();
+}
@@ -0,0 +1,82 @@
+#include "gtest/gtest.h"
+#include "Reading.hpp"
+
+// Reading.cpp is already included by MeterD0.cpp
+
+TEST(Reading, trivially_copyable) {
+	EXPECT_TRUE(__has_trivial_copy(Reading));
+	EXPECT_TRUE(__has_trivial_assign(Reading));
+	EXPECT_TRUE(__has_trivial_destructor(Reading));
+}
+
+TEST(Reading, time_conversion) {
+	struct timeval tv;
+	tv.tv_sec = 1400000000;
+	tv.tv_usec = 123456;
+
+	Reading r(1.5, tv, ReadingIdentifier::Ptr());
+	EXPECT_DOUBLE_EQ(1400000000.123456, r.tvtod());
+	EXPECT_EQ(0u, r.id()); // NilIdentifier
+}
+
+TEST(Reading, integer_timestamps) {
+	struct timeval tv;
+	tv.tv_sec = 1400000000;
+	tv.tv_usec = 123500;
+
+	Reading r(1.5, tv, ReadingIdentifier::Ptr());
+	EXPECT_EQ(1400000000123500LL, r.time_us());
+	EXPECT_EQ(1400000000124LL, r.time_ms()); // rounded like the former round(tvtod() * 1000)
+	EXPECT_EQ(1400000000, r.time_s());
+
+	r.time_us(1400000000123499LL);
+	EXPECT_EQ(1400000000123LL, r.time_ms());
+}
+
+TEST(IdentifierTable, intern_equal_identifiers) {
+	reading_id_t a = IdentifierTable::intern(ObisIdentifier(Obis("1-0:1.8.0")));
+	reading_id_t b = IdentifierTable::intern(ReadingIdentifier::Ptr(new ObisIdentifier(Obis("1-0:1.8.0"))));
+	reading_id_t c = IdentifierTable::intern(ObisIdentifier(Obis("1-0:2.8.0")));
+
+	EXPECT_EQ(a, b);
+	EXPECT_NE(a, c);
+	EXPECT_EQ(0u, IdentifierTable::intern(NilIdentifier()));
+
+	ObisIdentifier *o = dynamic_cast<ObisIdentifier*>(IdentifierTable::get(c).get());
+	ASSERT_NE((ObisIdentifier*)0, o);
+	EXPECT_TRUE(Obis("1-0:2.8.0") == o->obis());
+}
+
+TEST(IdentifierTable, intern_distinguishes_types) {
+	reading_id_t s = IdentifierTable::intern(StringIdentifier("power"));
+	reading_id_t c = IdentifierTable::intern(ChannelIdentifier(1));
+	reading_id_t c2 = IdentifierTable::intern(ChannelIdentifier(-1));
+
+	EXPECT_NE(s, c);
+	EXPECT_NE(c, c2);
+	EXPECT_EQ(s, IdentifierTable::intern(StringIdentifier("power")));
+
+	Reading r;
+	r.identifier(StringIdentifier("power"));
+	EXPECT_EQ(s, r.id());
+
+	size_t n = IdentifierTable::size();
+	r.identifier(StringIdentifier("power"));
+	EXPECT_EQ(n, IdentifierTable::size()); // no new entry
+}
+
+TEST(IdentifierTable, lookup_after_freeze) {
+	StringIdentifier voltage("voltage");
+	EXPECT_EQ(0u, IdentifierTable::lookup(voltage));
+
+	reading_id_t v = IdentifierTable::intern(voltage);
+	EXPECT_NE(0u, v);
+	EXPECT_EQ(0u, IdentifierTable::lookup(voltage)); // not published yet
+	EXPECT_TRUE(*IdentifierTable::get(v) == voltage);
+
+	IdentifierTable::freeze();
+	EXPECT_EQ(v, IdentifierTable::lookup(voltage));
+	EXPECT_EQ(0u, IdentifierTable::lookup(StringIdentifier("current")));
+	EXPECT_EQ(0u, IdentifierTable::lookup(NilIdentifier()));
+	EXPECT_TRUE(*IdentifierTable::get(v) == voltage);
+}
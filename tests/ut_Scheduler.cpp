@@ -0,0 +1,102 @@
+#include <unistd.h>
+#include <sys/time.h>
+#include "gtest/gtest.h"
+#include "Scheduler.hpp"
+
+#include "../src/Scheduler.cpp"
+
+static int64_t wall_now() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+TEST(Scheduler, aligned_deadlines) {
+	Scheduler scheduler(10000);
+	size_t fast = scheduler.add("fast", 50000);
+	size_t slow = scheduler.add("slow", 100000);
+	scheduler.start();
+
+	int64_t a = scheduler.wait(fast);
+	EXPECT_EQ(0, a % 50000);
+	EXPECT_LT(llabs(wall_now() - a), 20000);
+
+	int64_t b = scheduler.wait(fast);
+	EXPECT_EQ(50000, b - a);
+	EXPECT_EQ(0u, scheduler.overruns(fast));
+	EXPECT_EQ(0u, scheduler.skipped(fast));
+
+	int64_t c = scheduler.wait(slow);
+	EXPECT_EQ(0, c % 100000);
+	scheduler.stop();
+}
+
+TEST(Scheduler, overrun_skips_ticks) {
+	Scheduler scheduler(10000);
+	size_t timer = scheduler.add("busy", 50000);
+	scheduler.start();
+
+	int64_t a = scheduler.wait(timer);
+	usleep(120000); /* reading takes longer than two intervals */
+	int64_t b = scheduler.wait(timer);
+
+	EXPECT_EQ(150000, b - a); /* phase is kept */
+	EXPECT_EQ(1u, scheduler.overruns(timer));
+	EXPECT_EQ(2u, scheduler.skipped(timer));
+	scheduler.stop();
+}
+
+TEST(Scheduler, interval_rounded_to_ticks) {
+	Scheduler scheduler(10000);
+	size_t timer = scheduler.add("tiny", 1000);
+	scheduler.start();
+
+	int64_t a = scheduler.wait(timer);
+	int64_t b = scheduler.wait(timer);
+	EXPECT_EQ(10000, b - a);
+	scheduler.stop();
+}
+
+TEST(Scheduler, remove) {
+	Scheduler scheduler(10000);
+	size_t gone = scheduler.add("gone", 20000);
+	size_t timer = scheduler.add("kept", 50000);
+	scheduler.start();
+
+	scheduler.remove(gone);
+	scheduler.remove(gone);
+	scheduler.wait(timer);
+	usleep(60000);
+
+	/* a removed timer is not fired, so it never overruns */
+	EXPECT_EQ(0u, scheduler.skipped(gone));
+	EXPECT_EQ(1u, scheduler.skipped(timer));
+	scheduler.stop();
+}
+
+TEST(Scheduler, removed_timers_reused) {
+	Scheduler scheduler(10000);
+	size_t a = scheduler.add("a", 50000);
+	size_t b = scheduler.add("b", 50000);
+
+	scheduler.remove(a);
+	EXPECT_EQ(a, scheduler.add("c", 50000));
+	EXPECT_EQ(2u, scheduler.size());
+
+	scheduler.remove(b);
+	EXPECT_EQ(b, scheduler.add("d", 50000));
+	EXPECT_EQ(2u, scheduler.size());
+}
+
+TEST(Scheduler, added_timer_wakes_up) {
+	Scheduler scheduler(10000);
+	scheduler.add("slow", 2000000);
+	scheduler.start();
+	usleep(20000); /* scheduler sleeps until the deadline of slow */
+
+	size_t fast = scheduler.add("fast", 50000);
+	int64_t a = scheduler.wait(fast);
+	EXPECT_LT(llabs(wall_now() - a), 20000);
+	EXPECT_EQ(0u, scheduler.skipped(fast));
+	scheduler.stop();
+}
@@ -0,0 +1,149 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/resource.h>
+#include "gtest/gtest.h"
+#include "Spool.hpp"
+
+#include "../src/Spool.cpp"
+
+static Reading reading(double value, time_t sec) {
+	struct timeval tv;
+	tv.tv_sec = sec;
+	tv.tv_usec = 0;
+	return Reading(value, tv, ReadingIdentifier::Ptr());
+}
+
+static std::string spool_dir() {
+	char tmpl[] = "/tmp/ut_spool.XXXXXX";
+	return mkdtemp(tmpl);
+}
+
+static size_t count_files(const std::string &dir) {
+	size_t n = 0;
+	DIR *d = opendir(dir.c_str());
+	struct dirent *ent;
+	while ((ent = readdir(d)) != NULL) {
+		if (ent->d_name[0] != '.') n++;
+	}
+	closedir(d);
+	return n;
+}
+
+static void remove_dir(const std::string &dir) {
+	DIR *d = opendir(dir.c_str());
+	struct dirent *ent;
+	while ((ent = readdir(d)) != NULL) {
+		if (ent->d_name[0] != '.') unlink((dir + "/" + ent->d_name).c_str());
+	}
+	closedir(d);
+	rmdir(dir.c_str());
+}
+
+TEST(Spool, peek_acknowledge_within_segment) {
+	std::string dir = spool_dir();
+	{
+		Spool spool(dir, "chn", 16);
+		EXPECT_TRUE(spool.empty());
+		EXPECT_EQ((Reading*)NULL, spool.peek(0));
+
+		for (int i = 0; i < 10; i++) spool.append(reading(i, 100 + i));
+		spool.commit();
+		EXPECT_EQ(10u, spool.size());
+
+		ASSERT_NE((Reading*)NULL, spool.peek(9));
+		EXPECT_EQ(9, spool.peek(9)->value());
+		EXPECT_EQ(109, spool.peek(9)->tvtod());
+		EXPECT_EQ((Reading*)NULL, spool.peek(10));
+
+		spool.acknowledge(4);
+		EXPECT_EQ(6u, spool.size());
+		EXPECT_EQ(4, spool.peek(0)->value());
+	}
+	remove_dir(dir);
+}
+
+TEST(Spool, segments_are_reclaimed) {
+	std::string dir = spool_dir();
+	{
+		Spool spool(dir, "chn", 8);
+		for (int i = 0; i < 20; i++) spool.append(reading(i, i));
+		spool.commit();
+		EXPECT_EQ(3u, spool.segments());
+		EXPECT_EQ(3u, count_files(dir));
+
+		// peek stops at the end of the head segment
+		EXPECT_EQ((Reading*)NULL, spool.peek(8));
+
+		spool.acknowledge(8);
+		EXPECT_EQ(2u, spool.segments());
+		EXPECT_EQ(2u, count_files(dir));
+		EXPECT_EQ(8, spool.peek(0)->value());
+
+		spool.acknowledge(100);
+		EXPECT_TRUE(spool.empty());
+		EXPECT_EQ(1u, count_files(dir)); // tail is kept for appending
+	}
+	remove_dir(dir);
+}
+
+TEST(Spool, recover_after_restart) {
+	std::string dir = spool_dir();
+	{
+		Spool spool(dir, "chn", 8);
+		for (int i = 0; i < 12; i++) spool.append(reading(i, i));
+		spool.acknowledge(3);
+		spool.commit();
+
+		Spool other(dir, "other", 8); // different channel, same directory
+		other.append(reading(42, 42));
+		other.commit();
+	}
+	{
+		Spool spool(dir, "chn", 8);
+		EXPECT_EQ(9u, spool.size());
+		EXPECT_EQ(3, spool.peek(0)->value());
+
+		spool.append(reading(12, 12));
+		spool.commit();
+		spool.acknowledge(5);
+		ASSERT_NE((Reading*)NULL, spool.peek(0));
+		EXPECT_EQ(8, spool.peek(0)->value());
+		EXPECT_EQ(5u, spool.size());
+	}
+	remove_dir(dir);
+}
+
+TEST(Spool, recover_maps_head_and_tail) {
+	std::string dir = spool_dir();
+	{
+		Spool spool(dir, "chn", 4);
+		for (int i = 0; i < 20; i++) spool.append(reading(i, i));
+		spool.commit();
+		EXPECT_EQ(5u, spool.segments());
+	}
+	{
+		/* leave three descriptors: head, tail and the segment being scanned */
+		int free_fds[3];
+		for (int i = 0; i < 3; i++) free_fds[i] = dup(0);
+		for (int i = 0; i < 3; i++) close(free_fds[i]);
+
+		struct rlimit saved, limit;
+		getrlimit(RLIMIT_NOFILE, &saved);
+		limit = saved;
+		limit.rlim_cur = free_fds[2] + 1;
+		setrlimit(RLIMIT_NOFILE, &limit);
+
+		Spool spool(dir, "chn", 4);
+		setrlimit(RLIMIT_NOFILE, &saved);
+		EXPECT_EQ(5u, spool.segments());
+		EXPECT_EQ(20u, spool.size());
+
+		/* inner segments are mapped again once they become the head */
+		spool.acknowledge(6);
+		ASSERT_NE((Reading*)NULL, spool.peek(0));
+		EXPECT_EQ(6, spool.peek(0)->value());
+		EXPECT_EQ(14u, spool.size());
+	}
+	remove_dir(dir);
+}
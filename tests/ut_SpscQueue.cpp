@@ -0,0 +1,94 @@
+#include <pthread.h>
+#include "gtest/gtest.h"
+#include "SpscQueue.hpp"
+#include "EventNotifier.hpp"
+
+TEST(SpscQueue, capacity_power_of_two) {
+	SpscQueue<int> q(100);
+	EXPECT_EQ(128u, q.capacity());
+	EXPECT_TRUE(q.empty());
+}
+
+TEST(SpscQueue, push_pop_full) {
+	SpscQueue<int> q(4);
+	for (int i = 0; i < 4; i++) ASSERT_TRUE(q.push(i));
+	EXPECT_FALSE(q.push(4));
+	EXPECT_EQ(4u, q.size());
+
+	int v;
+	for (int round = 0; round < 10; round++) { // wrap around several times
+		ASSERT_TRUE(q.pop(v));
+		EXPECT_EQ(round, v);
+		ASSERT_TRUE(q.push(round + 4));
+	}
+	EXPECT_EQ(4u, q.size());
+	ASSERT_NE((int*)NULL, q.front());
+	EXPECT_EQ(10, *q.front());
+}
+
+TEST(SpscQueue, peek_acknowledge) {
+	SpscQueue<int> q(8);
+	for (int i = 0; i < 5; i++) q.push(i);
+
+	// reading does not consume
+	for (size_t i = 0; i < 5; i++) {
+		ASSERT_NE((int*)NULL, q.peek(i));
+		EXPECT_EQ((int)i, *q.peek(i));
+	}
+	EXPECT_EQ((int*)NULL, q.peek(5));
+	EXPECT_EQ(5u, q.size());
+
+	q.acknowledge(3);
+	EXPECT_EQ(2u, q.size());
+	EXPECT_EQ(3, *q.peek(0));
+
+	q.acknowledge(10); // clamped
+	EXPECT_TRUE(q.empty());
+}
+
+struct spsc_args {
+	SpscQueue<long> *q;
+	EventNotifier *ev;
+	long n;
+};
+
+static void *spsc_producer(void *arg) {
+	spsc_args *a = static_cast<spsc_args *>(arg);
+	for (long i = 0; i < a->n; i++) {
+		while (!a->q->push(i)) {}
+		if (i % 64 == 0) a->ev->notify();
+	}
+	a->ev->notify();
+	return NULL;
+}
+
+TEST(SpscQueue, two_threads_in_order) {
+	SpscQueue<long> q(256);
+	EventNotifier ev;
+	spsc_args args = { &q, &ev, 200000 };
+	pthread_t thread;
+
+	pthread_create(&thread, NULL, &spsc_producer, &args);
+
+	long expect = 0;
+	while (expect < args.n) {
+		long *p;
+		while ((p = q.front()) != NULL) {
+			ASSERT_EQ(expect, *p);
+			q.pop();
+			expect++;
+		}
+		if (expect < args.n) ev.wait(10);
+	}
+	pthread_join(thread, NULL);
+	EXPECT_TRUE(q.empty());
+}
+
+TEST(EventNotifier, wait_timeout) {
+	EventNotifier ev;
+	EXPECT_FALSE(ev.wait(0));
+	ev.notify();
+	ev.notify();
+	EXPECT_TRUE(ev.wait(0));	// signals are coalesced
+	EXPECT_FALSE(ev.wait(0));
+}
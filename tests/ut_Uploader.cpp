@@ -0,0 +1,414 @@
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "gtest/gtest.h"
+#include "Uploader.hpp"
+
+#include "../src/Uploader.cpp"
+
+/* acknowledges everything it is asked to send */
+class FakeApi : public vz::ApiIF {
+	public:
+	FakeApi(Channel::Ptr ch) : vz::ApiIF(ch), sent(0), calls(0) {}
+
+	bool send() {
+		size_t n = channel()->pending();
+		channel()->acknowledge(n);
+		__sync_add_and_fetch(&sent, n);
+		__sync_add_and_fetch(&calls, 1);
+		return true;
+	}
+	void register_device() {}
+
+	volatile size_t sent;
+	volatile size_t calls;
+};
+
+static Channel::Ptr channel() {
+	std::list<Option> options;
+	return Channel::Ptr(new Channel(options, "null", "uuid", ReadingIdentifier::Ptr()));
+}
+
+TEST(Channel, memory_budget) {
+	/* a quarter of 256 readings fills the queue, but not a quarter of the rest */
+	std::list<Option> options;
+	options.push_back(Option("memory", (int)(256 * sizeof(Reading))));
+	Channel ch(options, "null", "uuid", ReadingIdentifier::Ptr());
+
+	EXPECT_EQ(64u, ch.queue().capacity());
+	EXPECT_EQ(192u, ch.buffer()->capacity());
+}
+
+static void publish(Channel::Ptr ch, int readings) {
+	for (int i = 0; i < readings; i++) {
+		struct timeval tv = { i + 1, 0 };
+		ch->push(Reading(i, tv, ReadingIdentifier::Ptr()));
+	}
+	ch->publish();
+}
+
+TEST(Uploader, run_queue) {
+	Uploader up;
+	Channel::Ptr a = channel(), b = channel();
+	up.add(a, vz::ApiIF::Ptr(new FakeApi(a)));
+	up.add(b, vz::ApiIF::Ptr(new FakeApi(b)));
+
+	up.ready(1);
+	up.ready(0);
+	up.ready(1); /* already queued */
+	EXPECT_EQ(2u, up.queued());
+
+	EXPECT_EQ(1, up.next());
+	up.ready(1); /* while running */
+	EXPECT_EQ(1u, up.queued());
+	up.done(1, false);
+	EXPECT_EQ(2u, up.queued());
+
+	EXPECT_EQ(0, up.next());
+	up.done(0, false);
+	EXPECT_EQ(1, up.next());
+	up.done(1, false);
+	EXPECT_EQ(0u, up.queued());
+
+	/* backlog left, queued again behind the others */
+	up.ready(0);
+	EXPECT_EQ(0, up.next());
+	up.ready(1);
+	up.done(0, true);
+	EXPECT_EQ(1, up.next());
+	up.done(1, false);
+	EXPECT_EQ(0, up.next());
+	up.done(0, false);
+	EXPECT_EQ(0u, up.queued());
+}
+
+TEST(Uploader, publish_schedules_channel) {
+	Uploader up;
+	Channel::Ptr ch = channel();
+	FakeApi *api = new FakeApi(ch);
+	up.add(ch, vz::ApiIF::Ptr(api));
+
+	publish(ch, 3);
+	EXPECT_EQ(1u, up.queued());
+	EXPECT_EQ(3u, ch->pending());
+
+	long job = up.next();
+	ASSERT_EQ(0, job);
+	EXPECT_FALSE(up.process(job));
+	up.done(job, false);
+
+	EXPECT_EQ(3u, api->sent);
+	EXPECT_EQ(0u, ch->pending());
+	EXPECT_EQ(0u, up.queued());
+}
+
+TEST(Uploader, workers) {
+	Uploader up;
+	std::vector<Channel::Ptr> chs;
+	std::vector<FakeApi *> apis;
+	for (int i = 0; i < 5; i++) {
+		chs.push_back(channel());
+		apis.push_back(new FakeApi(chs.back()));
+		up.add(chs.back(), vz::ApiIF::Ptr(apis.back()));
+	}
+
+	up.start(2);
+	EXPECT_EQ(2u, up.workers());
+
+	for (int i = 0; i < 5; i++) publish(chs[i], i + 1);
+
+	size_t sent = 0;
+	for (int wait = 0; wait < 500 && sent < 15; wait++) {
+		usleep(10000);
+		sent = 0;
+		for (int i = 0; i < 5; i++) sent += apis[i]->sent;
+	}
+	up.stop();
+
+	EXPECT_EQ(15u, sent);
+	EXPECT_EQ(0u, up.workers());
+	for (int i = 0; i < 5; i++) {
+		EXPECT_EQ(0u, chs[i]->pending());
+	}
+}
+
+/* takes a while to answer */
+class SlowApi : public FakeApi {
+	public:
+	SlowApi(Channel::Ptr ch) : FakeApi(ch), busy(false) {}
+
+	bool send() {
+		busy = true;
+		usleep(200000);
+		return FakeApi::send();
+	}
+
+	volatile bool busy;
+};
+
+TEST(Uploader, stop_finishes_request) {
+	Uploader up;
+	Channel::Ptr ch = channel();
+	SlowApi *api = new SlowApi(ch);
+	up.add(ch, vz::ApiIF::Ptr(api));
+
+	up.start(1);
+	publish(ch, 2);
+	for (int wait = 0; wait < 100 && !api->busy; wait++) {
+		usleep(1000);
+	}
+	ASSERT_TRUE(api->busy);
+
+	up.stop();
+	EXPECT_EQ(0u, up.workers());
+	EXPECT_EQ(2u, api->sent);
+	EXPECT_EQ(0u, ch->pending());
+}
+
+TEST(Uploader, remove) {
+	Uploader up;
+	Channel::Ptr a = channel(), b = channel();
+	up.add(a, vz::ApiIF::Ptr(new FakeApi(a)));
+	up.add(b, vz::ApiIF::Ptr(new FakeApi(b)));
+
+	up.ready(0);
+	up.ready(1);
+	up.remove(0);
+	EXPECT_EQ(1u, up.queued());
+	EXPECT_EQ((Uploader*)NULL, a->uploader());
+
+	/* removed channels are not queued any more */
+	publish(a, 2);
+	EXPECT_EQ(1u, up.queued());
+	up.ready(0);
+	EXPECT_EQ(1u, up.queued());
+
+	/* channels added later reuse the job */
+	Channel::Ptr c = channel();
+	EXPECT_EQ(0u, up.add(c, vz::ApiIF::Ptr(new FakeApi(c))));
+	EXPECT_EQ(&up, c->uploader());
+	EXPECT_EQ(2u, up.size());
+
+	EXPECT_EQ(1, up.next());
+	up.done(1, false);
+	EXPECT_EQ(0u, up.queued());
+
+	/* jobs at the end are released */
+	up.remove(1);
+	EXPECT_EQ(1u, up.size());
+	up.remove(0);
+	EXPECT_EQ(0u, up.size());
+}
+
+/* fails with a connection error as long as down is set */
+class FlakyApi : public FakeApi {
+	public:
+	FlakyApi(Channel::Ptr ch, const std::string &url) : FakeApi(ch), down(true), skip(false), _url(url) {}
+
+	bool send() {
+		if (skip) {
+			return false; /* e.g. the request of its batch is in flight */
+		}
+		if (down) {
+			__sync_add_and_fetch(&calls, 1);
+			throw vz::ConnectionException("Middleware not reachable");
+		}
+		return FakeApi::send();
+	}
+	const std::string middleware() const { return _url; }
+
+	volatile bool down;
+	volatile bool skip;
+
+	private:
+	std::string _url;
+};
+
+TEST(Uploader, backoff_with_single_probe) {
+	Uploader up;
+	up.backoff(1, 1);
+
+	std::vector<Channel::Ptr> chs;
+	std::vector<FlakyApi *> apis;
+	for (int i = 0; i < 3; i++) {
+		chs.push_back(channel());
+		apis.push_back(new FlakyApi(chs.back(), "http://localhost/middleware.php"));
+		up.add(chs.back(), vz::ApiIF::Ptr(apis.back()));
+	}
+	Channel::Ptr other = channel();
+	FlakyApi *other_api = new FlakyApi(other, "http://otherhost/middleware.php");
+	other_api->down = false;
+	up.add(other, vz::ApiIF::Ptr(other_api));
+
+	/* first failure opens the breaker, the others are parked without a request */
+	for (int i = 0; i < 3; i++) publish(chs[i], 2);
+	EXPECT_EQ(3u, up.queued());
+	long job = up.next();
+	EXPECT_FALSE(up.process(job));
+	up.done(job, false);
+	EXPECT_EQ(Health::OPEN, up.health(0));
+	EXPECT_EQ(0u, up.queued());
+	EXPECT_EQ(3u, up.parked());
+	EXPECT_EQ(1u, apis[0]->calls + apis[1]->calls + apis[2]->calls);
+
+	/* other hosts are not affected */
+	publish(other, 1);
+	EXPECT_EQ(3, up.next());
+	up.process(3);
+	up.done(3, false);
+	EXPECT_EQ(1u, other_api->sent);
+	EXPECT_EQ(Health::CLOSED, up.health(3));
+
+	/* after the backoff one probe fails, the next one resumes all channels */
+	job = up.next();
+	EXPECT_EQ(Health::PROBING, up.health(0));
+	EXPECT_EQ(2u, up.parked());
+	up.process(job);
+	up.done(job, false);
+	EXPECT_EQ(Health::OPEN, up.health(0));
+	EXPECT_EQ(3u, up.parked());
+
+	for (int i = 0; i < 3; i++) apis[i]->down = false;
+	job = up.next();
+	up.process(job);
+	up.done(job, false);
+	EXPECT_EQ(Health::CLOSED, up.health(0));
+	EXPECT_EQ(0u, up.parked());
+	EXPECT_EQ(2u, up.queued());
+
+	for (int i = 0; i < 2; i++) {
+		job = up.next();
+		up.process(job);
+		up.done(job, false);
+	}
+	for (int i = 0; i < 3; i++) {
+		EXPECT_EQ(0u, chs[i]->pending());
+	}
+}
+
+TEST(Uploader, probe_without_request) {
+	Uploader up;
+	up.backoff(1, 1);
+
+	Channel::Ptr ch = channel();
+	FlakyApi *api = new FlakyApi(ch, "http://localhost/middleware.php");
+	up.add(ch, vz::ApiIF::Ptr(api));
+
+	publish(ch, 2);
+	long job = up.next();
+	up.process(job);
+	up.done(job, false);
+	EXPECT_EQ(Health::OPEN, up.health(0));
+
+	/* the host has not been asked, the breaker stays open */
+	api->down = false;
+	api->skip = true;
+	job = up.next();
+	EXPECT_EQ(Health::PROBING, up.health(0));
+	up.process(job);
+	up.done(job, false);
+	EXPECT_EQ(Health::OPEN, up.health(0));
+	EXPECT_EQ(1u, up.parked());
+
+	api->skip = false;
+	job = up.next();
+	up.process(job);
+	up.done(job, false);
+	EXPECT_EQ(Health::CLOSED, up.health(0));
+	EXPECT_EQ(0u, ch->pending());
+}
+
+/* sends its readings as curl request of the event loop */
+class AsyncApi : public FakeApi {
+	public:
+	AsyncApi(Channel::Ptr ch, const std::string &url) : FakeApi(ch), failed(0), _url(url) {
+		_curl = curl_easy_init();
+	}
+	~AsyncApi() { curl_easy_cleanup(_curl); }
+
+	bool asynchronous() const { return true; }
+	CURL *prepare() {
+		_pending = channel()->pending();
+		curl_easy_setopt(_curl, CURLOPT_URL, _url.c_str());
+		curl_easy_setopt(_curl, CURLOPT_TIMEOUT_MS, 1000L);
+		return _curl;
+	}
+	void complete(CURLcode code) {
+		__sync_add_and_fetch(&calls, 1);
+		if (code != CURLE_OK) {
+			__sync_add_and_fetch(&failed, 1);
+			throw vz::ConnectionException(curl_easy_strerror(code));
+		}
+		channel()->acknowledge(_pending);
+		__sync_add_and_fetch(&sent, _pending);
+	}
+
+	volatile size_t failed;
+
+	private:
+	std::string _url;
+	CURL *_curl;
+	size_t _pending;
+};
+
+TEST(Uploader, parallel_requests) {
+	/* accepted by the kernel, but never answered */
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	ASSERT_EQ(0, bind(fd, (struct sockaddr *)&addr, sizeof(addr)));
+	ASSERT_EQ(0, listen(fd, 4));
+	getsockname(fd, (struct sockaddr *)&addr, &len);
+
+	char url[64];
+	snprintf(url, sizeof(url), "http://127.0.0.1:%d/middleware.php", ntohs(addr.sin_port));
+
+	Uploader up;
+	Channel::Ptr slow = channel();
+	AsyncApi *slow_api = new AsyncApi(slow, url);
+	up.add(slow, vz::ApiIF::Ptr(slow_api));
+
+	std::vector<Channel::Ptr> chs;
+	std::vector<AsyncApi *> apis;
+	for (int i = 0; i < 3; i++) {
+		chs.push_back(channel());
+		apis.push_back(new AsyncApi(chs.back(), "file:///dev/null"));
+		up.add(chs.back(), vz::ApiIF::Ptr(apis.back()));
+	}
+	Channel::Ptr sync = channel();
+	FakeApi *sync_api = new FakeApi(sync);
+	up.add(sync, vz::ApiIF::Ptr(sync_api));
+
+	up.start(UPLOADER_DEFAULT_WORKERS, 8);
+	EXPECT_EQ(1u, up.workers());
+
+	/* the hanging request does not hold up the other channels */
+	publish(slow, 2);
+	for (int i = 0; i < 3; i++) publish(chs[i], i + 1);
+	publish(sync, 1);
+
+	size_t sent = 0;
+	for (int wait = 0; wait < 50 && sent < 7; wait++) {
+		usleep(10000);
+		sent = sync_api->sent;
+		for (int i = 0; i < 3; i++) sent += apis[i]->sent;
+	}
+	EXPECT_EQ(7u, sent);
+	EXPECT_EQ(0u, slow_api->calls);
+	EXPECT_EQ(2u, slow->pending());
+
+	/* until it times out, its readings stay queued */
+	for (int wait = 0; wait < 300 && slow_api->failed == 0; wait++) {
+		usleep(10000);
+	}
+	EXPECT_EQ(1u, slow_api->failed);
+	EXPECT_EQ(2u, slow->pending());
+
+	up.stop();
+	EXPECT_EQ(0u, up.workers());
+	close(fd);
+}
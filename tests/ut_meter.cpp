@@ -6,6 +6,7 @@
 #include "gtest/gtest.h"
 
 #include "Meter.hpp"
+#include "Scheduler.hpp"
 
 // this is a dirty hack. we should think about better ways/rules to link against the
 // test objects.
@@ -49,3 +50,106 @@ TEST(meter, meter_lookup_protocol)
 	ASSERT_TRUE(NULL!=d->name);
 	ASSERT_STREQ(d->name, "d0");
 }
+
+TEST(MeterFluksoV2, feed)
+{
+	/* consumption and power of both channels are configured */
+	for (int channel = 1; channel <= 2; channel++) {
+		IdentifierTable::intern(ChannelIdentifier(-channel));
+		IdentifierTable::intern(ChannelIdentifier(channel));
+	}
+	IdentifierTable::freeze();
+
+	std::list<Option> options;
+	MeterFluksoV2 m(options);
+
+	std::vector<Reading> rds;
+	rds.resize(4);
+	vz::protocol::VectorSink sink(rds, rds.size());
+
+	const char *chunk1 = "1234567890 0 100 2";
+	const char *chunk2 = "00 1 300 400\n";
+	EXPECT_EQ(0u, m.feed((const uint8_t *)chunk1, strlen(chunk1), sink));
+	EXPECT_EQ(0u, sink.size());
+	EXPECT_EQ(1u, m.feed((const uint8_t *)chunk2, strlen(chunk2), sink));
+	ASSERT_EQ(4u, sink.size());
+
+	EXPECT_EQ(100, rds[0].value());
+	EXPECT_EQ(200, rds[1].value());
+	EXPECT_EQ(300, rds[2].value());
+	EXPECT_EQ(400, rds[3].value());
+	EXPECT_EQ(1234567890, rds[3].tvtod());
+
+	ChannelIdentifier *c = dynamic_cast<ChannelIdentifier*>(rds[0].identifier().get());
+	ASSERT_NE((ChannelIdentifier*)0, c);
+	EXPECT_TRUE(ChannelIdentifier(-1) == *c);
+	c = dynamic_cast<ChannelIdentifier*>(rds[3].identifier().get());
+	ASSERT_NE((ChannelIdentifier*)0, c);
+	EXPECT_TRUE(ChannelIdentifier(2) == *c);
+}
+
+TEST(meter, sync_replaces_interval)
+{
+	std::list<Option> options;
+	options.push_back(Option("protocol", (char*)"random"));
+	options.push_back(Option("min", 0.0));
+	options.push_back(Option("max", 10.0));
+	options.push_back(Option("interval", 5));
+	options.push_back(Option("sync", 10));
+
+	Meter m(options);
+	EXPECT_EQ(10, m.sync());
+	EXPECT_EQ(10, m.interval());
+}
+
+/* reading thread of a synchronized meter, two ticks */
+struct synced {
+	Meter *meter;
+	Scheduler *scheduler;
+	size_t timer;
+	int64_t ticks[2];
+	int64_t stamps[2];
+};
+
+static void *read_synced(void *arg) {
+	synced *s = static_cast<synced *>(arg);
+	std::vector<Reading> rds(1);
+
+	for (int i = 0; i < 2; i++) {
+		s->ticks[i] = s->scheduler->wait(s->timer);
+		EXPECT_EQ(1u, s->meter->read(rds, rds.size(), s->ticks[i]));
+		s->stamps[i] = rds[0].time_us();
+	}
+	return NULL;
+}
+
+TEST(meter, sync_shares_ticks)
+{
+	std::list<Option> options;
+	options.push_back(Option("protocol", (char*)"random"));
+	options.push_back(Option("min", 0.0));
+	options.push_back(Option("max", 10.0));
+	options.push_back(Option("sync", 1));
+	Meter a(options), b(options);
+
+	Scheduler scheduler;
+	synced sa = { &a, &scheduler, scheduler.add(a.name(), a.sync() * 1000000LL), {0, 0}, {0, 0} };
+	synced sb = { &b, &scheduler, scheduler.add(b.name(), b.sync() * 1000000LL), {0, 0}, {0, 0} };
+	scheduler.start();
+
+	pthread_t ta, tb;
+	pthread_create(&ta, NULL, &read_synced, &sa);
+	pthread_create(&tb, NULL, &read_synced, &sb);
+	pthread_join(ta, NULL);
+	pthread_join(tb, NULL);
+	scheduler.stop();
+
+	/* both meters on the same aligned tick, one timestamp per tick */
+	for (int i = 0; i < 2; i++) {
+		EXPECT_EQ(0, sa.ticks[i] % 1000000);
+		EXPECT_EQ(sa.ticks[i], sb.ticks[i]);
+		EXPECT_EQ(sa.ticks[i], sa.stamps[i]);
+		EXPECT_EQ(sb.ticks[i], sb.stamps[i]);
+	}
+	EXPECT_EQ(1000000, sa.ticks[1] - sa.ticks[0]);
+}